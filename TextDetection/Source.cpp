@@ -9,13 +9,36 @@
 #include <set>
 #include <fstream>
 #include <stdio.h>
+#include <map>
+#include <sstream>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/date_time.hpp>
 #include "boost/date_time/posix_time/posix_time.hpp"
 
+#include "box_store.h"
+#include "detection_params.h"
+#include "detection_service.h"
+#include "detection_trace.h"
+#include "folder_watcher.h"
+#include "image_loader.h"
+#include "image_source.h"
+#include "language_routing.h"
+#include "memory_stats.h"
+#include "metrics.h"
+#include "result_index.h"
+#include "results_writer.h"
+#include "image_files.h"
+#include "shard.h"
 #include "textDetector.h"
+#include "thread_budget.h"
+#include "triage.h"
 
 
 using namespace cv;
@@ -25,6 +48,17 @@ using namespace std;
 string INPUT_FOLDER_PATH;
 string OUTPUT_FOLDER_PATH;
 string LANGUAGE;
+protech::ShardSpec SHARD = { 0, 1 };//!< This process handles images of shard SHARD.index of SHARD.count.
+protech::DetectionParams PRESET;//!< Detection thresholds and OCR settings (--preset=fast|balanced|accurate).
+bool WRITE_IMAGES = true;//!< Write _masked and _rects images; if false, images are decoded straight to grayscale.
+int DEADLINE_MS = 0;//!< Time budget per image (--deadline-ms), 0 means no budget.
+double TRIAGE_THRESHOLD = 0;//!< Images with lower triage score are skipped (--triage), 0 means no triage.
+int STRIPES = 0;//!< Horizontal stripes of image stages (--stripes), 0 means one per OpenCV thread, 1 means no striping.
+bool FRAME_OCR = false;//!< One Tesseract image per frame, regions recognized by rectangle (--frame-ocr).
+protech::ResultsWriter RESULTS;//!< JSON Lines results with RLE masks (--output=jsonl|both).
+protech::LanguageRouter LANGUAGE_ROUTER;//!< OCR languages per image (--language-manifest, --language-from-name).
+protech::ResultIndex INDEX;//!< Content and configuration of finished images (--incremental).
+std::mutex LOG_LOCK;//!< Serializes writes to ExecutionTime log from driver threads.
 
 /**
 * \brief ModulePathA - This method finds directory where app executable is located.
@@ -45,89 +79,22 @@ std::string ModulePathA()
 	return std::string(tmp_char).substr(0, pos);
 }
 
-/**
-* \brief compareNat - Method which compares two file path and sort them in "natural ordering".
-* \param [in] boost::filesystem::path& a1 - First input file path.
-* \param [in] boost::filesystem::path& b1 - Second input file path.
-* \return Returns true, if a1 is before b1, otherwise false.
-*/
-bool compareNat(const boost::filesystem::path& a1, const boost::filesystem::path& b1)
-{
-	std::string a = a1.string();
-	std::string b = b1.string();
-	if (a.empty())
-		return true;
-	if (b.empty())
-		return false;
-	if (std::isdigit(a[0]) && !std::isdigit(b[0]))
-		return true;
-	if (!std::isdigit(a[0]) && std::isdigit(b[0]))
-		return false;
-	if (!std::isdigit(a[0]) && !std::isdigit(b[0]))
-	{
-		if (a[0] == b[0])
-			return compareNat(a.substr(1), b.substr(1));
-		return (std::toupper(a[0]) < std::toupper(b[0]));
-	}
-
-	// Both strings begin with digit --> parse both numbers
-	std::istringstream issa(a);
-	std::istringstream issb(b);
-	int ia, ib;
-	issa >> ia;
-	issb >> ib;
-	if (ia != ib)
-		return ia < ib;
-
-	// Numbers are the same --> remove numbers and recurse
-	std::string anew, bnew;
-	std::getline(issa, anew);
-	std::getline(issb, bnew);
-	return (compareNat(anew, bnew));
-}
-
-
 /**
 * \brief listFiles - Method which lists files from folder.
 * \param [in] std::string dirPath - Path to the folder with images.
-* \return std::vector<boost::filesystem::path> - Vector of all image's paths in folder (with .jpg, .png and .bmp extensions).
+* \return std::vector<boost::filesystem::path> - Vector of all image's paths in folder (with .jpg, .png and .bmp extensions) in natural order.
 */
 std::vector<boost::filesystem::path> listFiles(std::string dirPath)
 {
-	namespace fs = boost::filesystem;
-	fs::path someDir(dirPath);
-	fs::directory_iterator end_iter;
+	protech::DirectoryImageStream images(dirPath, protech::DirectoryImageStream::ORDER_FULL);
 
-	std::vector<std::string> targetExtensions;
-	targetExtensions.push_back(".JPG");
-	targetExtensions.push_back(".JPEG");
-	targetExtensions.push_back(".PNG");
-	targetExtensions.push_back(".BMP");
-
-	std::vector<fs::path> result_set;
-
-	if (fs::exists(someDir) && fs::is_directory(someDir))
+	std::vector<boost::filesystem::path> result_set;
+	boost::filesystem::path imagePath;
+	while (images.next(imagePath))
 	{
-		for (fs::directory_iterator dir_iter(someDir); dir_iter != end_iter; ++dir_iter)
-		{
-			if (fs::is_regular_file(dir_iter->status()))
-			{
-				std::string extension = dir_iter->path().extension().string();
-				std::transform(extension.begin(), extension.end(), extension.begin(), ::toupper);
-				std::vector<std::string>::iterator it;
-				for (it = targetExtensions.begin(); it != targetExtensions.end(); ++it)
-				{
-					if (extension.compare(*it) == 0)
-					{
-						result_set.push_back(dir_iter->path());
-					}
-				}
-			}
-		}
+		result_set.push_back(imagePath);
 	}
 
-	std::sort(result_set.begin(), result_set.end(), compareNat);
-
 	return result_set;
 }
 
@@ -142,85 +109,1120 @@ std::vector<boost::filesystem::path> listFiles(std::string dirPath)
 void  log_execution_time(boost::posix_time::ptime start, boost::posix_time::ptime end, std::string sExecutionLocation, std::string description)
 {
 	boost::posix_time::time_duration duration = end - start;
+	std::lock_guard<std::mutex> lock(LOG_LOCK);
 	std::ofstream logExecution;
-	logExecution.open(OUTPUT_FOLDER_PATH + "//ExecutionTime.csv", std::ios::app);
+	logExecution.open(OUTPUT_FOLDER_PATH + "//ExecutionTime" + protech::shardSuffix(SHARD) + ".csv", std::ios::app);
 	logExecution << to_iso_string(boost::posix_time::microsec_clock::local_time()) << ";" << sExecutionLocation << ";" << duration.total_milliseconds() << ";ms;" << description << std::endl;
 	logExecution.close();
 }
 
 
 
-int main(int argc, char *argv[])
+/**
+* \brief parseArguments - Method which splits command line to positional arguments and --name[=value] options.
+* \param [in] int argc - arguments count.
+* \param [in] char *argv[] - arguments.
+* \param [out] std::vector<std::string> & args - positional arguments.
+* \param [out] std::map<std::string, std::string> & options - options (value is empty for flags).
+*/
+void parseArguments(int argc, char *argv[], std::vector<std::string> & args, std::map<std::string, std::string> & options)
 {
-	if (argc == 3)
+	for (int i = 1; i < argc; i++)
 	{
-		INPUT_FOLDER_PATH = argv[1];
-		OUTPUT_FOLDER_PATH = argv[2];
-		LANGUAGE = "eng";
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") == 0)
+		{
+			std::string::size_type pos = arg.find('=');
+			if (pos == std::string::npos)
+				options[arg.substr(2)] = "";
+			else
+				options[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+		}
+		else
+		{
+			args.push_back(arg);
+		}
 	}
-	else if (argc == 4)
+}
+
+
+/**
+* \brief optionValue - Method which returns option value or default value.
+* \param [in] const std::map<std::string, std::string> & options - parsed options.
+* \param [in] std::string name - option name.
+* \param [in] std::string defaultValue - value used if option is not given.
+* \return std::string - option value.
+*/
+std::string optionValue(const std::map<std::string, std::string> & options, std::string name, std::string defaultValue)
+{
+	std::map<std::string, std::string>::const_iterator it = options.find(name);
+	if (it == options.end() || it->second.empty())
+		return defaultValue;
+	return it->second;
+}
+
+
+/**
+* \brief imageOrder - Method which maps ordering options to DirectoryImageStream order.
+*--order=none processes images in directory order (first image starts immediately),
+*--order-window=N keeps at most N names for ordering, default is exact natural order.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return size_t - DirectoryImageStream order window.
+*/
+size_t imageOrder(const std::map<std::string, std::string> & options)
+{
+	if (optionValue(options, "order", "natural") == "none")
+		return protech::DirectoryImageStream::ORDER_NONE;
+	if (options.count("order-window"))
+		return boost::lexical_cast<size_t>(optionValue(options, "order-window", "1"));
+	return protech::DirectoryImageStream::ORDER_FULL;
+}
+
+
+/**
+* \brief outputName - Method which returns name of output images of an image, used by every processing mode.
+* \param [in] const std::string & fileName - image file name.
+* \return std::string - file name without its (three letter) extension.
+*/
+std::string outputName(const std::string & fileName)
+{
+	return fileName.substr(0, fileName.size() - 4);
+}
+
+
+/**
+* \brief outputName - Method which returns name of output images of an image file or archive entry.
+* \param [in] const protech::SourceImage & image - image file or archive entry.
+* \return std::string - file name without its (three letter) extension.
+*/
+std::string outputName(const protech::SourceImage & image)
+{
+	return outputName(image.fileName());
+}
+
+
+/**
+* \brief indexOutputs - Method which returns output files recorded in index for an image.
+* \param [in] const std::string & name - name of output images.
+* \return std::vector<std::string> - output files relative to OUTPUT_FOLDER_PATH.
+*/
+std::vector<std::string> indexOutputs(const std::string & name)
+{
+	std::vector<std::string> outputs;
+	if (WRITE_IMAGES)
 	{
-		INPUT_FOLDER_PATH = argv[1];
-		OUTPUT_FOLDER_PATH = argv[2];
-		std::string tmpLang = argv[3];
+		outputs.push_back(name + "_masked.jpg");
+		outputs.push_back(name + "_rects.jpg");
+	}
+	if (RESULTS.isOpen())
+	{
+		// records are appended (completed runs keep the last one per image), the file must at least still exist
+		outputs.push_back("results" + protech::shardSuffix(SHARD) + ".jsonl");
+	}
+	return outputs;
+}
+
 
-		if (tmpLang == "English")
+/**
+* \brief indexConfigHash - Method which hashes configuration which determines outputs of an image.
+*Workers, stripes and scheduling do not change outputs and are not part of it. Frame OCR is, as it is applied
+*in every mode (pooled frame OCR images are verified whole by one worker).
+* \param [in] const std::string & fileName - image file name (selects its languages).
+* \return boost::uint64_t - configuration hash.
+*/
+boost::uint64_t indexConfigHash(const std::string & fileName)
+{
+	std::ostringstream config;
+	config << PRESET.signature() << "|images=" << WRITE_IMAGES << "|jsonl=" << RESULTS.isOpen() << "|text=" << RESULTS.isOpen() << "|frameOcr=" << FRAME_OCR
+		<< "|deadline=" << DEADLINE_MS << "|triage=" << TRIAGE_THRESHOLD << "|languages=";
+	std::vector<std::string> languages = LANGUAGE_ROUTER.languagesFor(fileName);
+	for (size_t i = 0; i < languages.size(); i++)
+	{
+		config << (i > 0 ? "+" : "") << languages[i];
+	}
+	std::string text = config.str();
+	return protech::fnv1aHash(text.data(), text.size());
+}
+
+
+/**
+* \brief processImage - Method which reads one image, runs text detection on it and logs execution times.
+* \param [in] protech::TextDetector & textDetextor - initialized detector.
+* \param [in] const protech::SourceImage & image - image file or archive entry.
+* \param [out] long & imreadMs - image read time.
+* \param [out] long & detectMs - text detection time.
+* \param [out] bool * partial - set if image deadline ran out or detection failed (may be NULL).
+* \return bool - false if image can not be read, otherwise true.
+*/
+bool processImage(protech::TextDetector & textDetextor, const protech::SourceImage & image, long & imreadMs, long & detectMs, bool * partial = NULL)
+{
+	boost::posix_time::ptime start;
+	boost::posix_time::ptime end;
+
+	try
+	{
+		Mat large;
+		int reduction = 1;
+		start = boost::posix_time::microsec_clock::local_time();
+		large = protech::decodeSourceImage(image, PRESET.workingWidth, !WRITE_IMAGES, &reduction);
+		end = boost::posix_time::microsec_clock::local_time();
+		log_execution_time(start, end, "imread", "1/" + boost::lexical_cast<std::string>(reduction));
+		protech::metrics().recordStage(protech::Metrics::STAGE_DECODE, (end - start).total_microseconds());
+		imreadMs = (long)(end - start).total_milliseconds();
+
+		if (large.data == NULL)
 		{
-			LANGUAGE = "eng";
+			return false;
+		}
+
+		std::string img_name = outputName(image);
+
+		start = boost::posix_time::microsec_clock::local_time();
+		protech::TextDetectionResult result;
+		textDetextor.setImageLanguages(LANGUAGE_ROUTER.languagesFor(image.fileName()));
+		textDetextor.textDetectionFunction(large, img_name, result);
+		end = boost::posix_time::microsec_clock::local_time();
+		log_execution_time(start, end, "contoursFunction", result.triaged ? "triaged" : (result.partial ? "partial" : ""));
+		detectMs = (long)(end - start).total_milliseconds();
+		if (RESULTS.isOpen())
+			RESULTS.write(image.name, result, imreadMs);
+		if (partial != NULL)
+			*partial = result.partial;
+
+		large.release();
+	}
+	catch (std::exception & ex)
+	{
+		cout << "Exception: " << ex.what() << endl;
+		if (partial != NULL)
+			*partial = true;
+	}
+	catch (char * ex)
+	{
+		cout << "Exception: " << ex << endl;
+		if (partial != NULL)
+			*partial = true;
+	}
+	catch (...)
+	{
+		if (partial != NULL)
+			*partial = true;
+	}
+
+	return true;
+}
+
+
+/**
+* \brief runWatch - Watch mode: images are processed as soon as they are fully written to INPUT_FOLDER_PATH.
+*Usage: TextDetection.exe INPUT_FOLDER OUTPUT_FOLDER [LANGUAGE] --watch [--settle-ms=500] [--poll-ms=1000] [--max-pending=64] [--skip-existing]
+*Latency from file arrival to result is logged as "watchLatency".
+* \param [in] protech::TextDetector & textDetextor - initialized detector.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code.
+*/
+int runWatch(protech::TextDetector & textDetextor, const std::map<std::string, std::string> & options)
+{
+	int settleMs = boost::lexical_cast<int>(optionValue(options, "settle-ms", "500"));
+	int pollMs = boost::lexical_cast<int>(optionValue(options, "poll-ms", "1000"));
+	size_t maxPending = boost::lexical_cast<size_t>(optionValue(options, "max-pending", "64"));
+
+	protech::FolderWatcher watcher(INPUT_FOLDER_PATH, maxPending, settleMs, pollMs, options.count("skip-existing") == 0);
+	watcher.start();
+
+	protech::WatchedFile file;
+	while (watcher.next(file))
+	{
+		long imreadMs = 0;
+		long detectMs = 0;
+		if (!protech::inShard(file.path.filename().string(), SHARD))
+		{
+			continue;
 		}
-		else if (tmpLang == "english")
+		if (!processImage(textDetextor, protech::fileImage(file.path), imreadMs, detectMs))
 		{
-			LANGUAGE = "eng";
+			cout << "Cannot read " << file.path.string() << ", skipping..." << endl;
+			continue;
+		}
+		log_execution_time(file.arrival, boost::posix_time::microsec_clock::local_time(), "watchLatency", file.path.filename().string());
+	}
+
+	return 0;
+}
+
+
+/**
+* \brief PendingImage - Image submitted to worker pool whose result is not collected yet.
+*/
+struct PendingImage
+{
+	std::string relativePath;//!< Image name relative to input folder.
+	long imreadMs;//!< Image read time.
+	std::shared_future<protech::TextDetectionResult> result;//!< Detection result.
+	protech::IndexEntry indexEntry;//!< Recorded in INDEX when image is finished (--incremental).
+};
+
+
+/**
+* \brief finishPending - Method which waits for the oldest submitted image, logs its times and records it in index.
+* \param [in] std::deque<PendingImage> & pending - submitted images, oldest first.
+* \param [in] protech::ShardManifest & manifest - shard manifest.
+*/
+void finishPending(std::deque<PendingImage> & pending, protech::ShardManifest & manifest)
+{
+	PendingImage & image = pending.front();
+	long detectMs = 0;
+	std::string status = "ok";
+	try
+	{
+		const protech::TextDetectionResult & result = image.result.get();
+		detectMs = result.detectMs;
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+		log_execution_time(now - boost::posix_time::milliseconds(detectMs), now, "contoursFunction", result.partial ? image.relativePath + " partial" : image.relativePath);
+		if (RESULTS.isOpen())
+			RESULTS.write(image.relativePath, result, image.imreadMs);
+		if (INDEX.isOpen() && !result.partial)
+			INDEX.record(image.relativePath, image.indexEntry);
+	}
+	catch (std::exception & ex)
+	{
+		cout << "Exception: " << ex.what() << endl;
+		status = "failed";
+	}
+	manifest.write(image.relativePath, image.imreadMs, detectMs, status);
+	pending.pop_front();
+}
+
+
+/**
+* \brief runUrgent - Urgent images thread: images written to urgent folder are detected with high priority.
+*All images the watcher has ready are submitted before their results are collected, so a burst of urgent
+*images uses every free worker. Time from file arrival to result is logged as "urgentLatency".
+* \param [in] protech::TextDetector & textDetextor - detector which owns worker pool.
+* \param [in] protech::FolderWatcher & watcher - started watcher of urgent folder.
+*/
+void runUrgent(protech::TextDetector & textDetextor, protech::FolderWatcher & watcher)
+{
+	protech::WatchedFile file;
+	while (watcher.next(file))
+	{
+		std::vector<protech::WatchedFile> files(1, file);
+		while (watcher.tryNext(file))
+		{
+			files.push_back(file);
 		}
-		else if (tmpLang == "Chinese")
+
+		std::vector<std::future<protech::TextDetectionResult> > results(files.size());
+		for (size_t i = 0; i < files.size(); i++)
 		{
-			LANGUAGE = "chi_sim";
+			try
+			{
+				Mat image = protech::loadImage(files[i].path.string(), PRESET.workingWidth, !WRITE_IMAGES);
+				if (image.data == NULL)
+				{
+					cout << "Cannot read " << files[i].path.string() << ", skipping..." << endl;
+					continue;
+				}
+
+				protech::DetectionOptions detectionOptions;
+				detectionOptions.name = outputName(files[i].path.filename().string());
+				detectionOptions.writeImages = WRITE_IMAGES;
+				detectionOptions.deadlineMs = DEADLINE_MS;
+				detectionOptions.priority = protech::DetectionOptions::PRIORITY_HIGH;
+				detectionOptions.resultMask = RESULTS.isOpen();
+				detectionOptions.textRequested = RESULTS.isOpen();
+				detectionOptions.frameOcr = FRAME_OCR;
+				detectionOptions.triageThreshold = TRIAGE_THRESHOLD;
+				detectionOptions.stripes = STRIPES;
+				detectionOptions.languages = LANGUAGE_ROUTER.languagesFor(files[i].path.filename().string());
+
+				results[i] = textDetextor.submit(image, detectionOptions);
+			}
+			catch (std::exception & ex)
+			{
+				cout << "Exception: " << ex.what() << endl;
+			}
 		}
-		else if (tmpLang == "chinese")
+
+		for (size_t i = 0; i < files.size(); i++)
 		{
-			LANGUAGE = "chi_sim";
+			if (!results[i].valid())
+			{
+				continue;
+			}
+			try
+			{
+				protech::TextDetectionResult result = results[i].get();
+				std::string name = files[i].path.filename().string();
+				if (RESULTS.isOpen())
+					RESULTS.write(name, result, 0);
+				log_execution_time(files[i].arrival, boost::posix_time::microsec_clock::local_time(), "urgentLatency", result.partial ? name + " partial" : name);
+			}
+			catch (std::exception & ex)
+			{
+				cout << "Exception: " << ex.what() << endl;
+			}
 		}
-		else if (tmpLang == "Indonesian")
+	}
+}
+
+
+/**
+* \brief printQueueDelays - Method which prints queueing delay of every priority class which had images.
+*/
+void printQueueDelays()
+{
+	for (int p = 0; p < protech::Metrics::PRIORITY_CLASSES; p++)
+	{
+		const protech::LatencyHistogram & delay = protech::metrics().queueDelay(p);
+		if (delay.count() == 0)
 		{
-			LANGUAGE = "ind";
+			continue;
 		}
-		else if (tmpLang == "indonesian")
+		cout << "queue delay " << protech::Metrics::priorityName(p) << ": images=" << delay.count()
+			<< " p50=" << delay.percentileUs(50) / 1000.0 << " ms p99=" << delay.percentileUs(99) / 1000.0
+			<< " ms max=" << delay.maxUs() / 1000.0 << " ms" << endl;
+	}
+}
+
+
+/**
+* \brief runWorkers - Batch mode with several detection workers (--workers=N).
+*Images are read on this thread and detected on N workers with own Tesseract engines;
+*at most 2*N images are in flight and results are logged in input order.
+*With --urgent-folder=PATH images written there during the run are detected with high priority:
+*they take the next free worker ahead of the folder images (bulk class). --bulk-cap=M keeps at most
+*M workers on bulk images and their regions, so the other workers stay free for urgent ones.
+*--schedule=regions (default) spreads OCR of candidate regions of all images over all workers (work stealing),
+*--schedule=images keeps every image on one worker; makespan and image latency are printed for comparison.
+* \param [in] protech::TextDetector & textDetextor - initialized detector (owns worker pool).
+* \param [in] protech::ImageSource & images - input images (folder, archive or stream).
+* \param [in] protech::ShardManifest & manifest - shard manifest.
+* \param [in] size_t workersCount - number of workers.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code.
+*/
+int runWorkers(protech::TextDetector & textDetextor, protech::ImageSource & images, protech::ShardManifest & manifest, size_t workersCount, const std::map<std::string, std::string> & options)
+{
+	boost::posix_time::ptime runStart = boost::posix_time::microsec_clock::local_time();
+	textDetextor.setConcurrency(workersCount);
+	textDetextor.setRegionTasks(optionValue(options, "schedule", "regions") != "images");
+
+	int folderPriority = protech::DetectionOptions::PRIORITY_NORMAL;
+	std::unique_ptr<protech::FolderWatcher> urgentWatcher;
+	std::thread urgentThread;
+	if (options.count("urgent-folder"))
+	{
+		folderPriority = protech::DetectionOptions::PRIORITY_BULK;
+		textDetextor.setPriorityCap(folderPriority, boost::lexical_cast<size_t>(optionValue(options, "bulk-cap", "0")));
+
+		urgentWatcher.reset(new protech::FolderWatcher(optionValue(options, "urgent-folder", ""), 64, 500, 1000, true));
+		urgentWatcher->start();
+		urgentThread = std::thread(runUrgent, std::ref(textDetextor), std::ref(*urgentWatcher));
+	}
+
+	int exitCode = 0;
+	std::deque<PendingImage> pending;
+	protech::SourceImage sourceImage;
+	while (images.next(sourceImage))
+	{
+		std::string relativePath = sourceImage.name;
+		if (!protech::inShard(relativePath, SHARD))
 		{
-			LANGUAGE = "ind";
+			continue;
 		}
-		else if (tmpLang == "Hindi")
+
+		protech::IndexEntry indexEntry;
+		if (INDEX.isOpen() && INDEX.upToDate(sourceImage, indexConfigHash(sourceImage.fileName()), indexOutputs(outputName(sourceImage)), indexEntry))
 		{
-			LANGUAGE = "hin";
+			manifest.write(relativePath, 0, 0, "unchanged");
+			continue;
 		}
-		else if (tmpLang == "hindi")
+
+		int reduction = 1;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		Mat large = protech::decodeSourceImage(sourceImage, PRESET.workingWidth, !WRITE_IMAGES, &reduction);
+		boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+		log_execution_time(start, end, "imread", "1/" + boost::lexical_cast<std::string>(reduction));
+		protech::metrics().recordStage(protech::Metrics::STAGE_DECODE, (end - start).total_microseconds());
+
+		if (large.data == NULL)
 		{
-			LANGUAGE = "hin";
+			while (!pending.empty())
+			{
+				finishPending(pending, manifest);
+			}
+			manifest.write(relativePath, (long)(end - start).total_milliseconds(), 0, "unreadable");
+			exitCode = 1;
+			break;
 		}
-		else if (tmpLang == "Japanese")
+
+		protech::DetectionOptions detectionOptions;
+		detectionOptions.name = outputName(sourceImage);
+		detectionOptions.writeImages = WRITE_IMAGES;
+		detectionOptions.deadlineMs = DEADLINE_MS;
+		detectionOptions.priority = folderPriority;
+		detectionOptions.resultMask = RESULTS.isOpen();
+		detectionOptions.textRequested = RESULTS.isOpen();
+		detectionOptions.frameOcr = FRAME_OCR;
+		detectionOptions.triageThreshold = TRIAGE_THRESHOLD;
+		detectionOptions.stripes = STRIPES;
+		detectionOptions.languages = LANGUAGE_ROUTER.languagesFor(sourceImage.fileName());
+
+		PendingImage image;
+		image.relativePath = relativePath;
+		image.imreadMs = (long)(end - start).total_milliseconds();
+		image.result = textDetextor.submit(large, detectionOptions).share();
+		image.indexEntry = indexEntry;
+		pending.push_back(image);
+
+		if (pending.size() >= 2 * workersCount)
 		{
-			LANGUAGE = "jpn";
+			finishPending(pending, manifest);
 		}
-		else if (tmpLang == "japanese")
+	}
+
+	while (!pending.empty())
+	{
+		finishPending(pending, manifest);
+	}
+
+	if (urgentWatcher)
+	{
+		urgentWatcher->stop();
+		urgentThread.join();
+	}
+	printQueueDelays();
+
+	const protech::LatencyHistogram & imageUs = protech::metrics().stage(protech::Metrics::STAGE_TOTAL);
+	cout << "makespan " << (boost::posix_time::microsec_clock::local_time() - runStart).total_milliseconds() << " ms, image detection p50="
+		<< imageUs.percentileUs(50) / 1000.0 << " ms p99=" << imageUs.percentileUs(99) / 1000.0 << " ms max=" << imageUs.maxUs() / 1000.0
+		<< " ms, region tasks " << protech::metrics().counter(protech::Metrics::COUNT_REGION_TASKS)
+		<< " (stolen " << protech::metrics().counter(protech::Metrics::COUNT_REGIONS_STOLEN) << ")" << endl;
+	return exitCode;
+}
+
+
+/**
+* \brief runSoak - Soak mode: images of INPUT_FOLDER_PATH are processed in a cycle and memory is sampled.
+*Usage: TextDetection.exe INPUT_FOLDER OUTPUT_FOLDER [LANGUAGE] --soak[=10000] [--soak-sample=100] [--soak-warmup=500] [--soak-tolerance-mb=16]
+*Every sample (image index, RSS, heap bytes, heap peak) is written to OUTPUT_FOLDER/soak.csv. Growth is measured
+*from the first sample after warm-up to the last one; the run fails if it exceeds the tolerance.
+*Heap columns are counted only in builds with TEXTDETECTION_ALLOCATION_TRACKING.
+* \param [in] protech::TextDetector & textDetextor - initialized detector.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code (1 if memory grows more than tolerance, -1 if there are no images).
+*/
+int runSoak(protech::TextDetector & textDetextor, const std::map<std::string, std::string> & options)
+{
+	size_t imagesCount = boost::lexical_cast<size_t>(optionValue(options, "soak", "10000"));
+	size_t sampleEvery = boost::lexical_cast<size_t>(optionValue(options, "soak-sample", "100"));
+	size_t warmupCount = boost::lexical_cast<size_t>(optionValue(options, "soak-warmup", "500"));
+	double toleranceMb = boost::lexical_cast<double>(optionValue(options, "soak-tolerance-mb", "16"));
+	if (sampleEvery == 0)
+		sampleEvery = 1;
+
+	std::vector<boost::filesystem::path> imagePaths = listFiles(INPUT_FOLDER_PATH);
+	if (imagePaths.empty())
+	{
+		cout << "No images in " << INPUT_FOLDER_PATH << "..." << endl;
+		return -1;
+	}
+	if (!protech::allocationTrackingEnabled())
+	{
+		cout << "Allocation tracking is not built in (define TEXTDETECTION_ALLOCATION_TRACKING), only RSS is sampled..." << endl;
+	}
+
+	std::ofstream samples((OUTPUT_FOLDER_PATH + "//soak.csv").c_str());
+	samples << "images,rss_bytes,heap_bytes,heap_peak_bytes" << endl;
+
+	bool baselineTaken = false;
+	size_t baselineImage = 0;
+	unsigned long long baselineRss = 0;
+	long long baselineHeap = 0;
+	unsigned long long lastRss = 0;
+	long long lastHeap = 0;
+	for (size_t i = 1; i <= imagesCount; i++)
+	{
+		long imreadMs = 0;
+		long detectMs = 0;
+		if (!processImage(textDetextor, protech::fileImage(imagePaths[(i - 1) % imagePaths.size()]), imreadMs, detectMs))
+		{
+			cout << "Cannot read " << imagePaths[(i - 1) % imagePaths.size()].string() << "..." << endl;
+			return 1;
+		}
+
+		if (i % sampleEvery != 0 && i != imagesCount)
+		{
+			continue;
+		}
+		protech::MemoryCounters heap = protech::processMemory();
+		lastRss = protech::processRssBytes();
+		lastHeap = heap.currentBytes;
+		samples << i << "," << lastRss << "," << lastHeap << "," << heap.peakBytes << endl;
+		cout << "soak " << i << ": rss " << lastRss / (1024 * 1024) << " MB, heap " << lastHeap / (1024 * 1024) << " MB, heap peak " << heap.peakBytes / (1024 * 1024) << " MB" << endl;
+
+		if (!baselineTaken && i >= warmupCount)
 		{
-			LANGUAGE = "jpn";
+			baselineTaken = true;
+			baselineImage = i;
+			baselineRss = lastRss;
+			baselineHeap = lastHeap;
 		}
-		else if (tmpLang == "Korean")
+	}
+
+	if (!baselineTaken || imagesCount <= baselineImage)
+	{
+		cout << "Soak run too short for warm-up of " << warmupCount << " images, growth is not checked" << endl;
+		return 0;
+	}
+
+	double rssGrowthMb = ((double)lastRss - (double)baselineRss) / (1024.0 * 1024.0);
+	double heapGrowthMb = ((double)lastHeap - (double)baselineHeap) / (1024.0 * 1024.0);
+	double perThousand = 1000.0 / (double)(imagesCount - baselineImage);
+	cout << "Growth after warm-up (" << imagesCount - baselineImage << " images): rss " << rssGrowthMb << " MB (" << rssGrowthMb * perThousand
+		<< " MB/1000 images), heap " << heapGrowthMb << " MB (" << heapGrowthMb * perThousand << " MB/1000 images)" << endl;
+	cout << "Process peak rss " << protech::processPeakRssBytes() / (1024 * 1024) << " MB" << endl;
+
+	if (rssGrowthMb > toleranceMb || heapGrowthMb > toleranceMb)
+	{
+		cout << "Memory grows more than " << toleranceMb << " MB" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+
+/**
+* \brief runTriageEval - Triage evaluation mode: every image of INPUT_FOLDER_PATH is scored by triage and fully detected.
+*Usage: TextDetection.exe INPUT_FOLDER OUTPUT_FOLDER [LANGUAGE] --triage-eval[=LABELS_FILE] [--triage=THRESHOLD]
+*An image has text when the full pipeline accepts a region or, if LABELS_FILE is given, when its label
+*("<file name> text|notext|1|0" per line) says so. Features, score and times are written to OUTPUT_FOLDER/triage.csv;
+*for the configured threshold and a sweep of thresholds the skip rate, false negative rates and time saved are printed.
+* \param [in] protech::TextDetector & textDetextor - initialized detector.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code (-1 if there are no images or labels can not be read).
+*/
+int runTriageEval(protech::TextDetector & textDetextor, const std::map<std::string, std::string> & options)
+{
+	double configured = boost::lexical_cast<double>(optionValue(options, "triage", boost::lexical_cast<std::string>(protech::TRIAGE_DEFAULT_THRESHOLD)));
+	std::map<std::string, int> labels;
+	std::string labelsPath = optionValue(options, "triage-eval", "");
+	if (!labelsPath.empty())
+	{
+		std::ifstream labelsFile(labelsPath.c_str());
+		if (!labelsFile)
 		{
-			LANGUAGE = "kor";
+			cout << "Cannot open triage labels " << labelsPath << "..." << endl;
+			return -1;
 		}
-		else if (tmpLang == "korean")
+		std::string fileName;
+		std::string label;
+		while (labelsFile >> fileName >> label)
 		{
-			LANGUAGE = "kor";
+			labels[fileName] = (label == "text" || label == "1") ? 1 : 0;
 		}
-		else if (tmpLang == "Thai")
+	}
+
+	std::vector<boost::filesystem::path> imagePaths = listFiles(INPUT_FOLDER_PATH);
+	if (imagePaths.empty())
+	{
+		cout << "No images in " << INPUT_FOLDER_PATH << "..." << endl;
+		return -1;
+	}
+
+	struct TriageSample
+	{
+		double score;
+		double triageMs;
+		double detectMs;
+		bool accepted;
+		int label;//!< 1 text, 0 no text, -1 not labelled.
+	};
+	std::vector<TriageSample> samples;
+	std::ofstream csv((OUTPUT_FOLDER_PATH + "//triage.csv").c_str());
+	csv << "file,gradient_energy,separability,stroke_rows,score,triage_ms,detect_ms,accepted,label" << endl;
+
+	// reference run: every image is fully detected
+	textDetextor.setTriageThreshold(0);
+	for (size_t i = 0; i < imagePaths.size(); i++)
+	{
+		Mat large = protech::loadImage(imagePaths[i].string(), PRESET.workingWidth, !WRITE_IMAGES, NULL);
+		if (large.data == NULL)
 		{
-			LANGUAGE = "tha";
+			cout << "Cannot read " << imagePaths[i].string() << "..." << endl;
+			continue;
 		}
-		else if (tmpLang == "thai")
+
+		TriageSample sample;
+		protech::TriageFeatures features;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		protech::computeTriage(large, features);
+		boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+		sample.score = features.score;
+		sample.triageMs = (end - start).total_microseconds() / 1000.0;
+
+		std::string fileName = imagePaths[i].filename().string();
+		protech::TextDetectionResult result;
+		start = boost::posix_time::microsec_clock::local_time();
+		textDetextor.setImageLanguages(LANGUAGE_ROUTER.languagesFor(fileName));
+		textDetextor.textDetectionFunction(large, outputName(fileName), result);
+		end = boost::posix_time::microsec_clock::local_time();
+		sample.detectMs = (end - start).total_microseconds() / 1000.0;
+
+		sample.accepted = false;
+		for (size_t r = 0; r < result.regions.size(); r++)
 		{
-			LANGUAGE = "tha";
+			if (result.regions[r].accepted)
+				sample.accepted = true;
 		}
-		else
+		std::map<std::string, int>::const_iterator label = labels.find(fileName);
+		sample.label = (label != labels.end()) ? label->second : -1;
+		samples.push_back(sample);
+
+		csv << fileName << "," << features.gradientEnergy << "," << features.separability << "," << features.strokeRows << "," << features.score
+			<< "," << sample.triageMs << "," << sample.detectMs << "," << (sample.accepted ? 1 : 0) << "," << sample.label << endl;
+	}
+	if (samples.empty())
+	{
+		return -1;
+	}
+
+	std::vector<double> thresholds;
+	thresholds.push_back(configured);
+	double sweep[] = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2 };
+	thresholds.insert(thresholds.end(), sweep, sweep + sizeof(sweep) / sizeof(sweep[0]));
+
+	cout << "threshold, skipped %, missed vs pipeline %, missed vs labels %, saved ms/image" << endl;
+	for (size_t t = 0; t < thresholds.size(); t++)
+	{
+		size_t skipped = 0;
+		size_t withText = 0;
+		size_t missed = 0;
+		size_t labelledText = 0;
+		size_t labelMissed = 0;
+		double savedMs = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			bool skip = samples[i].score < thresholds[t];
+			// triage runs on every image, detection is saved on skipped ones
+			savedMs -= samples[i].triageMs;
+			if (skip)
+			{
+				skipped++;
+				savedMs += samples[i].detectMs;
+			}
+			if (samples[i].accepted)
+			{
+				withText++;
+				if (skip)
+					missed++;
+			}
+			if (samples[i].label == 1)
+			{
+				labelledText++;
+				if (skip)
+					labelMissed++;
+			}
+		}
+
+		cout << thresholds[t] << (t == 0 ? " (configured)" : "") << ", " << 100.0 * skipped / samples.size()
+			<< ", " << (withText ? 100.0 * missed / withText : 0.0)
+			<< ", " << (labelledText ? boost::lexical_cast<std::string>(100.0 * labelMissed / labelledText) : std::string("-"))
+			<< ", " << savedMs / samples.size() << endl;
+	}
+	return 0;
+}
+
+
+/**
+* \brief applyThreadOptions - Method which applies thread budget of the process and logs it.
+*--threads=N is the budget (all cores by default), --pin=cores|numa pins workers (see thread_budget.h).
+*Must be called before engines are initialized, OpenMP runtimes read their limits when they start.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \param [in] size_t workersCount - outer worker threads.
+* \return bool - false if an option is bad.
+*/
+bool applyThreadOptions(const std::map<std::string, std::string> & options, size_t workersCount)
+{
+	int pinMode = protech::ThreadBudget::PIN_NONE;
+	if (!protech::parsePinMode(optionValue(options, "pin", "none"), pinMode))
+	{
+		cout << "Bad Pin Argument, expected none, cores or numa..." << endl;
+		return false;
+	}
+	int cores = boost::lexical_cast<int>(optionValue(options, "threads", "0"));
+	protech::ThreadBudget budget = protech::planThreadBudget(cores, (int)workersCount, pinMode);
+	protech::applyThreadBudget(budget);
+
+	// effective values, OpenCV may round the requested threads
+	std::string description = budget.describe() + " opencv_threads=" + boost::lexical_cast<std::string>(cv::getNumThreads());
+	cout << "Thread budget: " << description << endl;
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+	log_execution_time(now, now, "threadBudget", description);
+	return true;
+}
+
+
+/**
+* \brief runService - Service mode: engines are initialized once and jobs are read from stdin or a loopback TCP port.
+*Usage: TextDetection.exe --serve [--port=N] OUTPUT_FOLDER [LANGUAGE[,LANGUAGE...]]
+* \param [in] const std::vector<std::string> & args - positional arguments.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code.
+*/
+int runService(const std::vector<std::string> & args, const std::map<std::string, std::string> & options)
+{
+	if (args.empty())
+	{
+		cout << "Not Enough Args..." << endl;
+		return -1;
+	}
+	OUTPUT_FOLDER_PATH = args[0];
+	if (!applyThreadOptions(options, boost::lexical_cast<size_t>(optionValue(options, "workers", "1"))))
+	{
+		return -1;
+	}
+
+	std::vector<std::string> languages;
+	std::istringstream languagesStream(args.size() > 1 ? args[1] : "eng");
+	std::string tmpLang;
+	while (std::getline(languagesStream, tmpLang, ','))
+	{
+		std::string code = protech::languageCode(tmpLang);
+		if (code.empty())
+		{
+			cout << "Bad Language Argument " << tmpLang << ", skipping..." << endl;
+			continue;
+		}
+		languages.push_back(code);
+	}
+
+	protech::DetectionService service;
+	if (!service.initialize(OUTPUT_FOLDER_PATH, languages))
+	{
+		cout << "No language loaded..." << endl;
+		return -1;
+	}
+
+	int port = boost::lexical_cast<int>(optionValue(options, "port", "0"));
+	if (port > 65535)
+	{
+		cout << "Bad Port " << port << "..." << endl;
+		return -1;
+	}
+	if (port > 0)
+	{
+		return service.serveLoopback((unsigned short)port);
+	}
+	return service.serveStdio();
+}
+
+
+/**
+* \brief runLoadGenerator - Load generator client for service mode, reports request latency percentiles.
+*Usage: TextDetection.exe --loadgen --port=N INPUT_FOLDER [--language=eng] [--requests=1000] [--connections=4] [--inline]
+* \param [in] const std::vector<std::string> & args - positional arguments.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code.
+*/
+int runLoadGenerator(const std::vector<std::string> & args, const std::map<std::string, std::string> & options)
+{
+	int port = boost::lexical_cast<int>(optionValue(options, "port", "0"));
+	if (args.empty() || port <= 0 || port > 65535)
+	{
+		cout << "Not Enough Args..." << endl;
+		return -1;
+	}
+
+	std::vector<boost::filesystem::path> images = listFiles(args[0]);
+	std::vector<std::string> imagePaths;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		imagePaths.push_back(boost::filesystem::absolute(images[i]).string());
+	}
+
+	int requestsCount = boost::lexical_cast<int>(optionValue(options, "requests", "1000"));
+	int connectionsCount = boost::lexical_cast<int>(optionValue(options, "connections", "4"));
+
+	return protech::runLoadGenerator((unsigned short)port, imagePaths, optionValue(options, "language", "-"), requestsCount, connectionsCount, options.count("inline") > 0);
+}
+
+
+/**
+* \brief runGolden - Golden-output harness: records or verifies stage by stage outputs on a fixed corpus.
+*Usage: TextDetection.exe --golden=record|verify CORPUS_FOLDER GOLDEN_FOLDER [LANGUAGE] [--replay] [--iou=0.9]
+*record runs Tesseract and writes <image>.golden.txt per image. verify compares against them and prints
+*every difference; --replay takes OCR responses from golden files (Tesseract is not loaded),
+*--iou=T tolerates rects which moved with IoU >= T.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - 0 if outputs are recorded or equal, 1 if there are differences, -1 on error.
+*/
+int runGolden(const std::map<std::string, std::string> & options)
+{
+	std::string mode = optionValue(options, "golden", "verify");
+	bool record = (mode == "record");
+	bool replay = !record && options.count("replay") > 0;
+	double iouThreshold = boost::lexical_cast<double>(optionValue(options, "iou", "0"));
+
+	if (!record && mode != "verify")
+	{
+		cout << "Bad Golden Argument, expected --golden=record or --golden=verify..." << endl;
+		return -1;
+	}
+
+	protech::TextDetector textDetextor;
+	textDetextor.setParams(PRESET);
+	textDetextor.initialize(OUTPUT_FOLDER_PATH, LANGUAGE, !replay);
+	textDetextor.setWriteImages(false);
+
+	protech::DetectionTrace trace;
+	protech::DetectionTrace golden;
+	textDetextor.setTrace(&trace);
+
+	std::vector<boost::filesystem::path> images = listFiles(INPUT_FOLDER_PATH);
+	int imagesCount = 0;
+	int differentCount = 0;
+	int missingCount = 0;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		std::string name = images[i].filename().string();
+		std::string goldenPath = OUTPUT_FOLDER_PATH + "//" + name + ".golden.txt";
+
+		if (!record && !protech::readTrace(goldenPath, golden))
+		{
+			cout << name << " golden file is missing or malformed" << endl;
+			missingCount++;
+			continue;
+		}
+		textDetextor.setOcrReplay(replay ? &golden : NULL);
+
+		Mat image = protech::loadImage(images[i].string(), PRESET.workingWidth, true);
+		if (image.data == NULL)
+		{
+			cout << name << " cannot be read" << endl;
+			missingCount++;
+			continue;
+		}
+
+		protech::TextDetectionResult result;
+		textDetextor.textDetectionFunction(image, outputName(name), result);
+		imagesCount++;
+
+		if (record)
+		{
+			if (!protech::writeTrace(goldenPath, trace))
+			{
+				cout << name << " golden file cannot be written" << endl;
+				missingCount++;
+			}
+			continue;
+		}
+
+		if (protech::compareTraces(golden, trace, iouThreshold, name, cout) > 0)
+		{
+			differentCount++;
+		}
+	}
+
+	if (record)
+	{
+		cout << "GOLDEN recorded " << imagesCount << " images, " << missingCount << " failed" << endl;
+		return (missingCount > 0) ? -1 : 0;
+	}
+
+	cout << "GOLDEN verified " << imagesCount << " images: " << imagesCount - differentCount << " equal, " << differentCount << " different, " << missingCount << " missing" << (replay ? " (OCR replayed)" : "") << endl;
+	return (differentCount > 0 || missingCount > 0) ? 1 : 0;
+}
+
+
+/**
+* \brief runBenchPresets - Preset benchmark: INPUT_FOLDER_PATH is detected with every preset.
+*Usage: TextDetection.exe INPUT_FOLDER OUTPUT_FOLDER [LANGUAGE] --bench-presets
+*Per preset throughput (decode and detection) is printed with agreement with accurate preset: text mask IoU over
+*all images (masks compared at accurate working resolution) and share of images on which both presets find text or both do not.
+* \param [in] const std::map<std::string, std::string> & options - options.
+* \return int - exit code (-1 if there are no images).
+*/
+int runBenchPresets(const std::map<std::string, std::string> & options)
+{
+	std::vector<boost::filesystem::path> imagePaths = listFiles(INPUT_FOLDER_PATH);
+	if (imagePaths.empty())
+	{
+		cout << "No images in " << INPUT_FOLDER_PATH << "..." << endl;
+		return -1;
+	}
+
+	// accurate runs first, it is the reference of the others
+	std::vector<std::string> presets = protech::presetNames();
+	std::vector<std::string>::iterator accurate = std::find(presets.begin(), presets.end(), std::string("accurate"));
+	std::rotate(presets.begin(), accurate, accurate + 1);
+
+	std::vector<cv::Mat> referenceMasks(imagePaths.size());
+	std::vector<bool> referenceText(imagePaths.size(), false);
+	std::map<std::string, std::string> rows;
+	for (size_t p = 0; p < presets.size(); p++)
+	{
+		protech::DetectionParams params;
+		protech::presetParams(presets[p], params);
+		protech::TextDetector textDetextor;
+		textDetextor.setParams(params);
+		textDetextor.initialize(OUTPUT_FOLDER_PATH, LANGUAGE);
+		textDetextor.setWriteImages(false);
+		textDetextor.setResultMask(true);
+
+		bool reference = (p == 0);
+		size_t imagesCount = 0;
+		size_t textAgreement = 0;
+		double intersectionPixels = 0;
+		double unionPixels = 0;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		for (size_t i = 0; i < imagePaths.size(); i++)
+		{
+			Mat image = protech::loadImage(imagePaths[i].string(), params.workingWidth, true);
+			if (image.data == NULL)
+			{
+				continue;
+			}
+			protech::TextDetectionResult result;
+			textDetextor.textDetectionFunction(image, outputName(imagePaths[i].filename().string()), result);
+			imagesCount++;
+
+			bool hasText = false;
+			for (size_t r = 0; r < result.regions.size(); r++)
+			{
+				if (result.regions[r].accepted)
+					hasText = true;
+			}
+			if (reference)
+			{
+				referenceMasks[i] = result.mask;
+				referenceText[i] = hasText;
+			}
+			if (hasText == referenceText[i])
+				textAgreement++;
+
+			if (referenceMasks[i].data != NULL && result.mask.data != NULL)
+			{
+				cv::Mat mask;
+				cv::Mat overlap;
+				cv::resize(result.mask, mask, referenceMasks[i].size(), 0, 0, CV_INTER_NN);
+				cv::bitwise_and(mask, referenceMasks[i], overlap);
+				intersectionPixels += cv::countNonZero(overlap);
+				cv::bitwise_or(mask, referenceMasks[i], overlap);
+				unionPixels += cv::countNonZero(overlap);
+			}
+		}
+		boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+		double seconds = (end - start).total_microseconds() / 1000000.0;
+
+		std::ostringstream row;
+		row << presets[p] << " (" << params.workingWidth << " px): " << imagesCount << " images, "
+			<< (seconds > 0 ? imagesCount / seconds : 0.0) << " images/s, mask IoU " << (unionPixels > 0 ? intersectionPixels / unionPixels : 1.0)
+			<< ", text/no-text agreement " << (imagesCount ? 100.0 * textAgreement / imagesCount : 0.0) << " %";
+		rows[presets[p]] = row.str();
+	}
+
+	std::vector<std::string> names = protech::presetNames();
+	for (size_t p = 0; p < names.size(); p++)
+	{
+		cout << rows[names[p]] << endl;
+	}
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> args;
+	std::map<std::string, std::string> options;
+	parseArguments(argc, argv, args, options);
+
+	// --metrics=FILE [--metrics-period=10]: stage latencies and candidate funnel, Prometheus text (or JSON for *.json)
+	std::unique_ptr<protech::MetricsExporter> metricsExporter;
+	if (options.count("metrics"))
+	{
+		int periodS = boost::lexical_cast<int>(optionValue(options, "metrics-period", "10"));
+		metricsExporter.reset(new protech::MetricsExporter(optionValue(options, "metrics", "metrics.prom"), periodS * 1000));
+		metricsExporter->start();
+	}
+
+	if (options.count("serve"))
+	{
+		return runService(args, options);
+	}
+	if (options.count("loadgen"))
+	{
+		return runLoadGenerator(args, options);
+	}
+	if (options.count("merge-shards"))
+	{
+		// TextDetection.exe --merge-shards OUTPUT_FOLDER [SHARD_OUTPUT_FOLDER...]
+		if (args.empty())
+		{
+			cout << "Not Enough Args..." << endl;
+			return -1;
+		}
+		std::vector<std::string> shardFolders(args.begin() + (args.size() > 1 ? 1 : 0), args.end());
+		return protech::mergeShards(args[0], shardFolders);
+	}
+	if (options.count("shard") && !protech::parseShardSpec(optionValue(options, "shard", ""), SHARD))
+	{
+		cout << "Bad Shard Argument, expected --shard=i/N with 0 <= i < N..." << endl;
+		return -1;
+	}
+	if (options.count("bench-natsort"))
+	{
+		size_t namesCount = boost::lexical_cast<size_t>(optionValue(options, "bench-natsort", "1000000"));
+		size_t legacyCount = boost::lexical_cast<size_t>(optionValue(options, "legacy", "20000"));
+		return protech::benchmarkNaturalOrder(namesCount, legacyCount);
+	}
+	if (options.count("bench-rules"))
+	{
+		// TextDetection.exe --bench-rules[=PAGES] [--boxes=N]: layout rule kernels against previous rules
+		size_t pagesCount = boost::lexical_cast<size_t>(optionValue(options, "bench-rules", "2000"));
+		size_t boxesCount = boost::lexical_cast<size_t>(optionValue(options, "boxes", "300"));
+		return protech::benchmarkBoxRules(pagesCount, boxesCount);
+	}
+	if (options.count("bench-merge"))
+	{
+		// TextDetection.exe --bench-merge[=FRAMES]: geometric super box merge against raster flood fill path
+		size_t framesCount = boost::lexical_cast<size_t>(optionValue(options, "bench-merge", "500"));
+		protech::TextDetector textDetector;
+		return textDetector.benchmarkSuperBoxMerge(framesCount);
+	}
+	if (options.count("bench-decode"))
+	{
+		// TextDetection.exe --bench-decode[=ROUNDS] INPUT_FOLDER: reduced JPEG decoding against full size decode and resize
+		if (args.empty())
+		{
+			cout << "Not Enough Args..." << endl;
+			return -1;
+		}
+		std::vector<boost::filesystem::path> images = listFiles(args[0]);
+		std::vector<std::string> imagePaths;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			imagePaths.push_back(images[i].string());
+		}
+		size_t rounds = boost::lexical_cast<size_t>(optionValue(options, "bench-decode", "5"));
+		return protech::benchmarkReducedDecode(imagePaths, PRESET.workingWidth, rounds);
+	}
+
+	if (args.size() == 2)
+	{
+		INPUT_FOLDER_PATH = args[0];
+		OUTPUT_FOLDER_PATH = args[1];
+		LANGUAGE = "eng";
+	}
+	else if (args.size() == 3)
+	{
+		INPUT_FOLDER_PATH = args[0];
+		OUTPUT_FOLDER_PATH = args[1];
+		std::string tmpLang = args[2];
+
+		LANGUAGE = protech::languageCode(tmpLang);
+		if (LANGUAGE.empty())
 		{
 			cout << "Bad Language Argument, using English language instead..." << endl;
 			LANGUAGE = "eng";
@@ -233,57 +1235,186 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	boost::posix_time::ptime start;
-	boost::posix_time::ptime end;
+	// --preset=fast|balanced|accurate: working resolution, thresholds, OCR engine mode, verification and timeouts
+	if (options.count("preset") && !protech::presetParams(optionValue(options, "preset", "balanced"), PRESET))
+	{
+		cout << "Bad Preset Argument, expected fast, balanced or accurate..." << endl;
+		return -1;
+	}
+	if (options.count("bench-presets"))
+	{
+		return runBenchPresets(options);
+	}
+	if (options.count("golden"))
+	{
+		return runGolden(options);
+	}
+	if (options.count("render-jsonl"))
+	{
+		// TextDetection.exe --render-jsonl=RESULTS_FILE INPUT_FOLDER OUTPUT_FOLDER
+		return protech::renderResults(optionValue(options, "render-jsonl", ""), INPUT_FOLDER_PATH, OUTPUT_FOLDER_PATH);
+	}
+
+	// --no-images: detection only, images are decoded in grayscale and no result images are written
+	WRITE_IMAGES = (options.count("no-images") == 0);
+	if (!protech::reducedDecodeAvailable())
+		cout << "Reduced JPEG decoding is not built in (needs OpenCV 3.2+ or TEXTDETECTION_USE_LIBJPEG), images are decoded at full size..." << endl;
+	// --deadline-ms=N: OCR stops after N ms per image, remaining regions are skipped and image is logged as partial
+	DEADLINE_MS = boost::lexical_cast<int>(optionValue(options, "deadline-ms", "0"));
+	// --frame-ocr: masked frame is set to Tesseract once, regions are recognized with SetRectangle
+	FRAME_OCR = (options.count("frame-ocr") > 0);
+	// --triage[=THRESHOLD]: images whose thumbnail does not look like text are skipped (see triage.h)
+	if (options.count("triage"))
+		TRIAGE_THRESHOLD = boost::lexical_cast<double>(optionValue(options, "triage", boost::lexical_cast<std::string>(protech::TRIAGE_DEFAULT_THRESHOLD)));
+	// --stripes=N: image stages of one image run on N horizontal stripes in parallel (see striped_stages.h), 1 disables it
+	STRIPES = boost::lexical_cast<int>(optionValue(options, "stripes", "0"));
+	// --output=images|jsonl|both: _masked/_rects images and/or one JSON record per image (rects, text, timings, RLE mask)
+	std::string outputMode = optionValue(options, "output", "images");
+	if (outputMode == "jsonl")
+	{
+		WRITE_IMAGES = false;
+	}
+	if (outputMode == "jsonl" || outputMode == "both")
+	{
+		std::string resultsPath = OUTPUT_FOLDER_PATH + "//results" + protech::shardSuffix(SHARD) + ".jsonl";
+		if (!RESULTS.open(resultsPath))
+		{
+			cout << "Cannot open results file " << resultsPath << "..." << endl;
+			return -1;
+		}
+	}
+
+	// --languages=L1,L2,...: engines kept warm besides LANGUAGE; --language-manifest=FILE and --language-from-name
+	// route every image to its own languages (name.tha+eng.jpg), so a mixed folder is processed once
+	LANGUAGE_ROUTER.setDefault(LANGUAGE);
+	if (options.count("languages") && !LANGUAGE_ROUTER.addConfigured(optionValue(options, "languages", "")))
+	{
+		cout << "Bad Languages Argument, expected list of supported languages separated by ','..." << endl;
+		return -1;
+	}
+	if (options.count("language-manifest") && !LANGUAGE_ROUTER.loadManifest(optionValue(options, "language-manifest", "")))
+	{
+		cout << "Cannot open language manifest " << optionValue(options, "language-manifest", "") << "..." << endl;
+		return -1;
+	}
+	LANGUAGE_ROUTER.setFilenameRule(options.count("language-from-name") > 0);
+
+	// --threads=N [--pin=cores|numa]: OpenCV's shared pool gets N threads, every worker (--workers) N / workers OpenMP threads
+	std::string budgetWorkers = optionValue(options, "workers", "1");
+	if (!applyThreadOptions(options, boost::lexical_cast<size_t>(budgetWorkers)))
+	{
+		return -1;
+	}
+
+	// batch images go to the worker pool, whose workers load own engines; watch, soak and triage evaluation
+	// detect on this detector
+	size_t workersCount = boost::lexical_cast<size_t>(optionValue(options, "workers", "1"));
+	bool pooled = (workersCount > 1 || options.count("urgent-folder")) && !options.count("watch") && !options.count("soak") && !options.count("triage-eval");
 
 	protech::TextDetector textDetextor;
-	textDetextor.initialize(OUTPUT_FOLDER_PATH, LANGUAGE);
-	
-	vector<boost::filesystem::path> m_ImagesFromFolder;
-	m_ImagesFromFolder = listFiles(INPUT_FOLDER_PATH);
+	textDetextor.setParams(PRESET);
+	textDetextor.initialize(OUTPUT_FOLDER_PATH, LANGUAGE, !pooled);
+	for (size_t i = 1; i < LANGUAGE_ROUTER.languages().size(); i++)
+	{
+		if (!textDetextor.addLanguage(LANGUAGE_ROUTER.languages()[i]))
+			cout << "Cannot load language " << LANGUAGE_ROUTER.languages()[i] << ", its images use remaining languages..." << endl;
+	}
+	textDetextor.setWriteImages(WRITE_IMAGES);
+	textDetextor.setResultMask(RESULTS.isOpen());
+	// JSONL records carry region text, layout only verdicts would leave it empty
+	textDetextor.setTextRequested(RESULTS.isOpen());
+	textDetextor.setFrameOcr(FRAME_OCR);
+	textDetextor.setDeadline(DEADLINE_MS);
+	textDetextor.setTriageThreshold(TRIAGE_THRESHOLD);
+	textDetextor.setStripes(STRIPES);
 
-	int i = 0;
-	while ((i < m_ImagesFromFolder.size()))
+	if (options.count("watch"))
 	{
-		try
-		{
-			Mat large;
-			start = boost::posix_time::microsec_clock::local_time();
-			large = imread(m_ImagesFromFolder[i].string());
-			end = boost::posix_time::microsec_clock::local_time();
-			log_execution_time(start, end, "imread", "");
+		return runWatch(textDetextor, options);
+	}
+	if (options.count("soak"))
+	{
+		return runSoak(textDetextor, options);
+	}
+	if (options.count("triage-eval"))
+	{
+		return runTriageEval(textDetextor, options);
+	}
+	
+	// images are handed over while the folder is still enumerated; INPUT_FOLDER may also be a tar or zip archive
+	// (entries are decoded from memory) or "-" for "<name> <size>\n<bytes>" records on stdin
+	std::unique_ptr<protech::ImageSource> m_ImagesFromFolder = protech::openImageSource(INPUT_FOLDER_PATH, imageOrder(options));
+	if (!m_ImagesFromFolder)
+	{
+		cout << "Cannot open input " << INPUT_FOLDER_PATH << "..." << endl;
+		system("pause");
+		return -1;
+	}
 
-			if (large.data == NULL)
-			{
-				system("pause");
-				return 1;
-			}
+	protech::ShardManifest manifest;
+	if (SHARD.count > 1)
+	{
+		manifest.open(OUTPUT_FOLDER_PATH, SHARD);
+	}
 
-			std::string img_name(m_ImagesFromFolder[i].string(), m_ImagesFromFolder[i].string().find_last_of('\\') + 1);
-			img_name = img_name.substr(0, img_name.size() - 4);
+	// --incremental[=verify]: images with unchanged content and configuration are skipped (see result_index.h),
+	// an interrupted run resumes with unfinished images; verify hashes every file instead of trusting size and time
+	if (options.count("incremental"))
+	{
+		if (!INDEX.open(OUTPUT_FOLDER_PATH, SHARD, optionValue(options, "incremental", "") == "verify"))
+		{
+			cout << "Cannot open result index in " << OUTPUT_FOLDER_PATH << "..." << endl;
+			return -1;
+		}
+		cout << INDEX.size() << " images in result index" << endl;
+	}
 
-			start = boost::posix_time::microsec_clock::local_time();
-			textDetextor.textDetectionFunction(large, img_name);
-			end = boost::posix_time::microsec_clock::local_time();
-			log_execution_time(start, end, "contoursFunction", "");
+	if (pooled)
+	{
+		int result = runWorkers(textDetextor, *m_ImagesFromFolder, manifest, workersCount, options);
+		if (result == 0)
+		{
+			INDEX.compact();
+			RESULTS.compact();
+		}
+		system("pause");
+		return result;
+	}
 
-			large.release();
+	protech::SourceImage image;
+	while (m_ImagesFromFolder->next(image))
+	{
+		std::string relativePath = image.name;
+		if (!protech::inShard(relativePath, SHARD))
+		{
+			continue;
 		}
-		catch (std::exception & ex)
+
+		protech::IndexEntry indexEntry;
+		if (INDEX.isOpen() && INDEX.upToDate(image, indexConfigHash(image.fileName()), indexOutputs(outputName(image)), indexEntry))
 		{
-			cout << "Exception: " << ex.what() << endl;
+			manifest.write(relativePath, 0, 0, "unchanged");
+			continue;
 		}
-		catch (char * ex)
+
+		long imreadMs = 0;
+		long detectMs = 0;
+		bool partial = false;
+		bool processed = processImage(textDetextor, image, imreadMs, detectMs, &partial);
+		manifest.write(relativePath, imreadMs, detectMs, processed ? "ok" : "unreadable");
+		if (!processed)
 		{
-			cout << "Exception: " << ex << endl;
+			system("pause");
+			return 1;
 		}
-		catch (...)
+		if (INDEX.isOpen() && !partial)
 		{
-			;
+			INDEX.record(relativePath, indexEntry);
 		}
-		i++;
 	}
 
+	INDEX.compact();
+	RESULTS.compact();
 	system("pause");
 	return 0;
 }
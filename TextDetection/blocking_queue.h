@@ -0,0 +1,111 @@
+/*!\file blocking_queue.h
+*
+*	Bounded blocking FIFO queue used between producer and worker threads in TextDetection project.
+*	push blocks while the queue is full, so a slow consumer applies backpressure to the producer.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef BLOCKING_QUEUE_H
+#define BLOCKING_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+namespace protech
+{
+	template <typename T>
+	class BlockingQueue
+	{
+	private:
+		std::deque<T> m_items;//!< Queued items.
+		size_t m_capacity;//!< Maximum queued items (0 means unbounded).
+		bool m_closed;//!< No more items will be pushed.
+		std::mutex m_lock;
+		std::condition_variable m_notEmpty;
+		std::condition_variable m_notFull;
+
+	public:
+		explicit BlockingQueue(size_t capacity = 0) : m_capacity(capacity), m_closed(false){};
+
+		/**
+		* \brief push - Method which adds item, waiting while queue is full.
+		* \param [in] const T & item - item.
+		* \return bool - false if queue is closed, otherwise true.
+		*/
+		bool push(const T & item)
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while (!m_closed && m_capacity > 0 && m_items.size() >= m_capacity)
+			{
+				m_notFull.wait(lock);
+			}
+			if (m_closed)
+			{
+				return false;
+			}
+			m_items.push_back(item);
+			m_notEmpty.notify_one();
+			return true;
+		}
+
+		/**
+		* \brief pop - Method which takes oldest item, waiting while queue is empty.
+		* \param [out] T & item - item.
+		* \return bool - false if queue is closed and empty, otherwise true.
+		*/
+		bool pop(T & item)
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while (!m_closed && m_items.empty())
+			{
+				m_notEmpty.wait(lock);
+			}
+			if (m_items.empty())
+			{
+				return false;
+			}
+			item = m_items.front();
+			m_items.pop_front();
+			m_notFull.notify_one();
+			return true;
+		}
+
+		/**
+		* \brief tryPop - Method which takes oldest item without waiting.
+		* \param [out] T & item - item.
+		* \return bool - false if queue is empty, otherwise true.
+		*/
+		bool tryPop(T & item)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (m_items.empty())
+			{
+				return false;
+			}
+			item = m_items.front();
+			m_items.pop_front();
+			m_notFull.notify_one();
+			return true;
+		}
+
+		/**
+		* \brief close - Method which wakes all waiting threads; remaining items can still be popped.
+		*/
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_closed = true;
+			m_notEmpty.notify_all();
+			m_notFull.notify_all();
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			return m_items.size();
+		}
+	};
+}
+#endif
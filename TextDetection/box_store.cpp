@@ -0,0 +1,424 @@
+#include "box_store.h"
+
+#include <cmath>
+
+#ifdef TEXTDETECTION_BOX_SSE2
+#include <emmintrin.h>
+#endif
+
+
+/**
+* \brief BoxStore::assign - Method which fills store with boxes.
+* \param [in] const std::vector<cv::Rect> & boxes - boxes.
+*/
+void protech::BoxStore::assign(const std::vector<cv::Rect> & boxes)
+{
+	size_t count = boxes.size();
+	m_x.resize(count);
+	m_y.resize(count);
+	m_width.resize(count);
+	m_height.resize(count);
+	m_right.resize(count);
+	m_bottom.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		set(i, boxes[i]);
+	}
+}
+
+
+/**
+* \brief BoxStore::copyTo - Method which copies boxes of store, in store order.
+* \param [out] std::vector<cv::Rect> & boxes - boxes.
+*/
+void protech::BoxStore::copyTo(std::vector<cv::Rect> & boxes) const
+{
+	boxes.resize(size());
+	for (size_t i = 0; i < size(); i++)
+	{
+		boxes[i] = rect(i);
+	}
+}
+
+
+/**
+* \brief BoxStore::set - Method which replaces one box.
+* \param [in] size_t i - box index.
+* \param [in] const cv::Rect & box - new box.
+*/
+void protech::BoxStore::set(size_t i, const cv::Rect & box)
+{
+	m_x[i] = box.x;
+	m_y[i] = box.y;
+	m_width[i] = box.width;
+	m_height[i] = box.height;
+	m_right[i] = box.x + box.width;
+	m_bottom[i] = box.y + box.height;
+}
+
+
+/**
+* \brief BoxStore::erase - Method which erases one box, following boxes keep their order.
+* \param [in] size_t i - box index.
+*/
+void protech::BoxStore::erase(size_t i)
+{
+	m_x.erase(m_x.begin() + i);
+	m_y.erase(m_y.begin() + i);
+	m_width.erase(m_width.begin() + i);
+	m_height.erase(m_height.begin() + i);
+	m_right.erase(m_right.begin() + i);
+	m_bottom.erase(m_bottom.begin() + i);
+}
+
+
+/**
+* \brief BoxStore::eraseFlagged - Method which erases flagged boxes, remaining boxes keep their order.
+* \param [in] const std::vector<uchar> & flags - non-zero for boxes to erase (one per box).
+*/
+void protech::BoxStore::eraseFlagged(const std::vector<uchar> & flags)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < size(); i++)
+	{
+		if (flags[i])
+			continue;
+		m_x[kept] = m_x[i];
+		m_y[kept] = m_y[i];
+		m_width[kept] = m_width[i];
+		m_height[kept] = m_height[i];
+		m_right[kept] = m_right[i];
+		m_bottom[kept] = m_bottom[i];
+		kept++;
+	}
+	m_x.resize(kept);
+	m_y.resize(kept);
+	m_width.resize(kept);
+	m_height.resize(kept);
+	m_right.resize(kept);
+	m_bottom.resize(kept);
+}
+
+
+namespace
+{
+	/**
+	* \brief BoxValues - One box converted to doubles (ints convert exactly, so every rule expression keeps its value).
+	*/
+	struct BoxValues
+	{
+		double x, y, width, height, right, bottom;
+
+		BoxValues(const protech::BoxStore & boxes, size_t i)
+			: x(boxes.x()[i]), y(boxes.y()[i]), width(boxes.width()[i]), height(boxes.height()[i]), right(boxes.right()[i]), bottom(boxes.bottom()[i]){};
+	};
+
+	inline double min2(double a, double b) { return a < b ? a : b; }
+	inline double max2(double a, double b) { return a > b ? a : b; }
+
+	/**
+	* \brief sideNeighbours - Method which tests whether box n is left or right neighbour of box c (connectLeftAndRight rule).
+	*Fields of n are read only when earlier conditions pass.
+	* \return bool - true if boxes are neighbours on one line.
+	*/
+	inline bool sideNeighbours(const BoxValues & c, const protech::BoxStore & boxes, size_t n, const protech::DetectionParams & params)
+	{
+		double x = boxes.x()[n];
+		double height = boxes.height()[n];
+		// left neighbour is measured by its own width, right neighbour by width of current box
+		double reach = (c.x > x) ? (double)boxes.width()[n] : c.width;
+		double minH = min2(c.height, height);
+		double dx = std::fabs(c.x - x);
+		if (c.x == x || !(reach - params.neighbourOverlap * minH < dx && dx < reach + params.neighbourGap * minH))
+		{
+			return false;
+		}
+		double maxH = max2(c.height, height);
+		double span = std::fabs(min2(c.y, boxes.y()[n]) - max2(c.bottom, boxes.bottom()[n]));
+		return span < maxH + params.neighbourOverlap * minH &&
+			minH / maxH > params.neighbourHeightRatio;
+	}
+
+	/**
+	* \brief stackNeighbours - Method which tests whether box n is above or below box c (checkAboveAndBelowAndWidth rule).
+	* \return bool - true if boxes are stacked lines.
+	*/
+	inline bool stackNeighbours(const BoxValues & c, const protech::BoxStore & boxes, size_t n, const protech::DetectionParams & params)
+	{
+		double y = boxes.y()[n];
+		double height = boxes.height()[n];
+		// line below is measured by height of current box, line above by its own height
+		double reach = (c.y < y) ? c.height : height;
+		double minH = min2(c.height, height);
+		double dy = std::fabs(c.y - y);
+		if (c.y == y || !(reach - params.stackOverlap * minH <= dy && dy < reach + params.stackGap * minH))
+		{
+			return false;
+		}
+		double width = boxes.width()[n];
+		double maxH = max2(c.height, height);
+		double minW = min2(c.width, width);
+		double maxW = max2(c.width, width);
+		double span = std::fabs(min2(c.x, boxes.x()[n]) - max2(c.right, boxes.right()[n]));
+		return span < maxW + params.stackWidthSlack * minW &&
+			minH / maxH > params.stackHeightRatio &&
+			minW / maxW > params.stackWidthRatio;
+	}
+
+	/**
+	* \brief impossibleBox - Method which tests whether box is higher than wide or too high for its width (eraseImposible rule).
+	* \return bool - true if box should be erased.
+	*/
+	inline bool impossibleBox(const protech::BoxStore & boxes, size_t i, const protech::DetectionParams & params)
+	{
+		int w = boxes.width()[i];
+		int h = boxes.height()[i];
+		return h > w || (double)h / (double)w > params.maxHeightToWidth;
+	}
+
+#ifdef TEXTDETECTION_BOX_SSE2
+	/**
+	* \brief load2 - Method which loads two ints as two doubles.
+	*/
+	inline __m128d load2(const int * values)
+	{
+		return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)));
+	}
+
+	/**
+	* \brief abs2 - Method which returns absolute values of two doubles.
+	*/
+	inline __m128d abs2(__m128d values)
+	{
+		return _mm_andnot_pd(_mm_set1_pd(-0.0), values);
+	}
+
+	/**
+	* \brief select2 - Method which returns a where mask is set, b elsewhere.
+	*/
+	inline __m128d select2(__m128d mask, __m128d a, __m128d b)
+	{
+		return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+	}
+
+	/**
+	* \brief firstBit - Method which returns index of first candidate of pair j, j+1 with set bit, except c.
+	*/
+	inline int firstBit(int bits, size_t j, size_t c)
+	{
+		if (j == c)
+			bits &= ~1;
+		if (j + 1 == c)
+			bits &= ~2;
+		if (bits == 0)
+			return -1;
+		return (int)j + ((bits & 1) ? 0 : 1);
+	}
+#endif
+}
+
+
+/**
+* \brief ScalarBoxKernels::firstSideNeighbour - Method which returns first left or right neighbour of box i.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] size_t i - current box.
+* \param [in] const DetectionParams & params - neighbour thresholds.
+* \return int - neighbour index, -1 if box has none.
+*/
+int protech::ScalarBoxKernels::firstSideNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params)
+{
+	BoxValues current(boxes, i);
+	for (size_t j = 0; j < boxes.size(); j++)
+	{
+		if (j != i && sideNeighbours(current, boxes, j, params))
+			return (int)j;
+	}
+	return -1;
+}
+
+
+/**
+* \brief ScalarBoxKernels::firstStackNeighbour - Method which returns first line above or below box i.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] size_t i - current box.
+* \param [in] const DetectionParams & params - stack thresholds.
+* \return int - neighbour index, -1 if box has none.
+*/
+int protech::ScalarBoxKernels::firstStackNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params)
+{
+	BoxValues current(boxes, i);
+	for (size_t j = 0; j < boxes.size(); j++)
+	{
+		if (j != i && stackNeighbours(current, boxes, j, params))
+			return (int)j;
+	}
+	return -1;
+}
+
+
+/**
+* \brief ScalarBoxKernels::impossibleBoxes - Method which flags boxes higher than wide or too high for their width.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] const DetectionParams & params - maxHeightToWidth.
+* \param [out] std::vector<uchar> & flags - 1 for boxes to erase.
+*/
+void protech::ScalarBoxKernels::impossibleBoxes(const BoxStore & boxes, const DetectionParams & params, std::vector<uchar> & flags)
+{
+	flags.assign(boxes.size(), 0);
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		flags[i] = impossibleBox(boxes, i, params) ? 1 : 0;
+	}
+}
+
+
+#ifdef TEXTDETECTION_BOX_SSE2
+/**
+* \brief Sse2BoxKernels::firstSideNeighbour - Method which returns first left or right neighbour of box i, two candidates at a time.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] size_t i - current box.
+* \param [in] const DetectionParams & params - neighbour thresholds.
+* \return int - neighbour index, -1 if box has none.
+*/
+int protech::Sse2BoxKernels::firstSideNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params)
+{
+	const __m128d xc = _mm_set1_pd(boxes.x()[i]);
+	const __m128d yc = _mm_set1_pd(boxes.y()[i]);
+	const __m128d wc = _mm_set1_pd(boxes.width()[i]);
+	const __m128d hc = _mm_set1_pd(boxes.height()[i]);
+	const __m128d bc = _mm_set1_pd(boxes.bottom()[i]);
+	const __m128d overlap = _mm_set1_pd(params.neighbourOverlap);
+	const __m128d gap = _mm_set1_pd(params.neighbourGap);
+	const __m128d heightRatio = _mm_set1_pd(params.neighbourHeightRatio);
+
+	size_t count = boxes.size();
+	size_t j = 0;
+	for (; j + 1 < count; j += 2)
+	{
+		__m128d xn = load2(boxes.x() + j);
+		__m128d yn = load2(boxes.y() + j);
+		__m128d wn = load2(boxes.width() + j);
+		__m128d hn = load2(boxes.height() + j);
+		__m128d bn = load2(boxes.bottom() + j);
+
+		__m128d reach = select2(_mm_cmpgt_pd(xc, xn), wn, wc);
+		__m128d minH = _mm_min_pd(hc, hn);
+		__m128d maxH = _mm_max_pd(hc, hn);
+		__m128d dx = abs2(_mm_sub_pd(xc, xn));
+		__m128d span = abs2(_mm_sub_pd(_mm_min_pd(yc, yn), _mm_max_pd(bc, bn)));
+		__m128d overlapH = _mm_mul_pd(overlap, minH);
+
+		__m128d mask = _mm_cmpneq_pd(xc, xn);
+		mask = _mm_and_pd(mask, _mm_cmplt_pd(_mm_sub_pd(reach, overlapH), dx));
+		mask = _mm_and_pd(mask, _mm_cmplt_pd(dx, _mm_add_pd(reach, _mm_mul_pd(gap, minH))));
+		mask = _mm_and_pd(mask, _mm_cmplt_pd(span, _mm_add_pd(maxH, overlapH)));
+		mask = _mm_and_pd(mask, _mm_cmpgt_pd(_mm_div_pd(minH, maxH), heightRatio));
+
+		int bits = _mm_movemask_pd(mask);
+		if (bits != 0)
+		{
+			int found = firstBit(bits, j, i);
+			if (found >= 0)
+				return found;
+		}
+	}
+	BoxValues current(boxes, i);
+	for (; j < count; j++)
+	{
+		if (j != i && sideNeighbours(current, boxes, j, params))
+			return (int)j;
+	}
+	return -1;
+}
+
+
+/**
+* \brief Sse2BoxKernels::firstStackNeighbour - Method which returns first line above or below box i, two candidates at a time.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] size_t i - current box.
+* \param [in] const DetectionParams & params - stack thresholds.
+* \return int - neighbour index, -1 if box has none.
+*/
+int protech::Sse2BoxKernels::firstStackNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params)
+{
+	const __m128d xc = _mm_set1_pd(boxes.x()[i]);
+	const __m128d yc = _mm_set1_pd(boxes.y()[i]);
+	const __m128d wc = _mm_set1_pd(boxes.width()[i]);
+	const __m128d hc = _mm_set1_pd(boxes.height()[i]);
+	const __m128d rc = _mm_set1_pd(boxes.right()[i]);
+	const __m128d overlap = _mm_set1_pd(params.stackOverlap);
+	const __m128d gap = _mm_set1_pd(params.stackGap);
+	const __m128d widthSlack = _mm_set1_pd(params.stackWidthSlack);
+	const __m128d heightRatio = _mm_set1_pd(params.stackHeightRatio);
+	const __m128d widthRatio = _mm_set1_pd(params.stackWidthRatio);
+
+	size_t count = boxes.size();
+	size_t j = 0;
+	for (; j + 1 < count; j += 2)
+	{
+		__m128d xn = load2(boxes.x() + j);
+		__m128d yn = load2(boxes.y() + j);
+		__m128d wn = load2(boxes.width() + j);
+		__m128d hn = load2(boxes.height() + j);
+		__m128d rn = load2(boxes.right() + j);
+
+		__m128d reach = select2(_mm_cmplt_pd(yc, yn), hc, hn);
+		__m128d minH = _mm_min_pd(hc, hn);
+		__m128d maxH = _mm_max_pd(hc, hn);
+		__m128d minW = _mm_min_pd(wc, wn);
+		__m128d maxW = _mm_max_pd(wc, wn);
+		__m128d dy = abs2(_mm_sub_pd(yc, yn));
+		__m128d span = abs2(_mm_sub_pd(_mm_min_pd(xc, xn), _mm_max_pd(rc, rn)));
+
+		__m128d mask = _mm_cmpneq_pd(yc, yn);
+		mask = _mm_and_pd(mask, _mm_cmple_pd(_mm_sub_pd(reach, _mm_mul_pd(overlap, minH)), dy));
+		mask = _mm_and_pd(mask, _mm_cmplt_pd(dy, _mm_add_pd(reach, _mm_mul_pd(gap, minH))));
+		mask = _mm_and_pd(mask, _mm_cmplt_pd(span, _mm_add_pd(maxW, _mm_mul_pd(widthSlack, minW))));
+		mask = _mm_and_pd(mask, _mm_cmpgt_pd(_mm_div_pd(minH, maxH), heightRatio));
+		mask = _mm_and_pd(mask, _mm_cmpgt_pd(_mm_div_pd(minW, maxW), widthRatio));
+
+		int bits = _mm_movemask_pd(mask);
+		if (bits != 0)
+		{
+			int found = firstBit(bits, j, i);
+			if (found >= 0)
+				return found;
+		}
+	}
+	BoxValues current(boxes, i);
+	for (; j < count; j++)
+	{
+		if (j != i && stackNeighbours(current, boxes, j, params))
+			return (int)j;
+	}
+	return -1;
+}
+
+
+/**
+* \brief Sse2BoxKernels::impossibleBoxes - Method which flags boxes higher than wide or too high for their width, two boxes at a time.
+* \param [in] const BoxStore & boxes - boxes.
+* \param [in] const DetectionParams & params - maxHeightToWidth.
+* \param [out] std::vector<uchar> & flags - 1 for boxes to erase.
+*/
+void protech::Sse2BoxKernels::impossibleBoxes(const BoxStore & boxes, const DetectionParams & params, std::vector<uchar> & flags)
+{
+	const __m128d maxHeightToWidth = _mm_set1_pd(params.maxHeightToWidth);
+	size_t count = boxes.size();
+	flags.assign(count, 0);
+	size_t i = 0;
+	for (; i + 1 < count; i += 2)
+	{
+		__m128d w = load2(boxes.width() + i);
+		__m128d h = load2(boxes.height() + i);
+		__m128d mask = _mm_or_pd(_mm_cmpgt_pd(h, w), _mm_cmpgt_pd(_mm_div_pd(h, w), maxHeightToWidth));
+		int bits = _mm_movemask_pd(mask);
+		flags[i] = (uchar)(bits & 1);
+		flags[i + 1] = (uchar)((bits >> 1) & 1);
+	}
+	for (; i < count; i++)
+	{
+		flags[i] = impossibleBox(boxes, i, params) ? 1 : 0;
+	}
+}
+#endif
@@ -0,0 +1,192 @@
+/*!\file box_store.h
+*
+*	Structure-of-arrays box storage and rule kernels used in TextDetection project.
+*	BoxStore keeps x, y, width, height, right and bottom edges of boxes in separate arrays, so predicates of
+*	connectLeftAndRight / eraseImposible / checkAboveAndBelowAndWidth rules test one box against many candidates
+*	without branches. Kernels are chosen at compile time:
+*	  - Sse2BoxKernels: two candidates per instruction in double lanes (x86/x64 with SSE2),
+*	  - ScalarBoxKernels: one candidate at a time (other targets, or TEXTDETECTION_SCALAR_BOXES defined).
+*	Both evaluate the previous double expressions in the same order, so rules give exactly the previous boxes
+*	(float lanes would be wider but could flip a comparison). benchmarkBoxRules (box_store_bench.cpp) cross-checks
+*	them against a copy of the previous std::vector<cv::Rect> rules kept there.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef BOX_STORE_H
+#define BOX_STORE_H
+
+#include <cstdlib>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "detection_params.h"
+
+#if !defined(TEXTDETECTION_SCALAR_BOXES) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TEXTDETECTION_BOX_SSE2
+#endif
+
+
+namespace protech
+{
+	class BoxStore
+	{
+	private:
+		std::vector<int> m_x;
+		std::vector<int> m_y;
+		std::vector<int> m_width;
+		std::vector<int> m_height;
+		std::vector<int> m_right;//!< x + width.
+		std::vector<int> m_bottom;//!< y + height.
+
+	public:
+		void assign(const std::vector<cv::Rect> & boxes);
+		void copyTo(std::vector<cv::Rect> & boxes) const;
+
+		size_t size() const { return m_x.size(); };
+		cv::Rect rect(size_t i) const { return cv::Rect(m_x[i], m_y[i], m_width[i], m_height[i]); };
+		void set(size_t i, const cv::Rect & box);
+		void erase(size_t i);
+		void eraseFlagged(const std::vector<uchar> & flags);
+
+		const int * x() const { return m_x.data(); };
+		const int * y() const { return m_y.data(); };
+		const int * width() const { return m_width.data(); };
+		const int * height() const { return m_height.data(); };
+		const int * right() const { return m_right.data(); };
+		const int * bottom() const { return m_bottom.data(); };
+	};
+
+	/**
+	* \brief ScalarBoxKernels - Rule predicates evaluated one candidate at a time.
+	*/
+	struct ScalarBoxKernels
+	{
+		static int firstSideNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params);
+		static int firstStackNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params);
+		static void impossibleBoxes(const BoxStore & boxes, const DetectionParams & params, std::vector<uchar> & flags);
+	};
+
+#ifdef TEXTDETECTION_BOX_SSE2
+	/**
+	* \brief Sse2BoxKernels - Rule predicates evaluated on two candidates at a time (SSE2 double lanes).
+	*/
+	struct Sse2BoxKernels
+	{
+		static int firstSideNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params);
+		static int firstStackNeighbour(const BoxStore & boxes, size_t i, const DetectionParams & params);
+		static void impossibleBoxes(const BoxStore & boxes, const DetectionParams & params, std::vector<uchar> & flags);
+	};
+
+	typedef Sse2BoxKernels BoxKernels;//!< Kernels used by TextDetector.
+#else
+	typedef ScalarBoxKernels BoxKernels;//!< Kernels used by TextDetector.
+#endif
+
+	/**
+	* \brief unionBox - Method which returns box covering both boxes.
+	* \param [in] const cv::Rect & a - first box.
+	* \param [in] const cv::Rect & b - second box.
+	* \return cv::Rect - union box.
+	*/
+	inline cv::Rect unionBox(const cv::Rect & a, const cv::Rect & b)
+	{
+		cv::Rect box;
+		box.x = a.x < b.x ? a.x : b.x;
+		box.y = a.y < b.y ? a.y : b.y;
+		int bottom = (a.y + a.height > b.y + b.height) ? a.y + a.height : b.y + b.height;
+		int right = (a.x + a.width > b.x + b.width) ? a.x + a.width : b.x + b.width;
+		box.height = std::abs(box.y - bottom);
+		box.width = std::abs(box.x - right);
+		return box;
+	}
+
+	/**
+	* \brief connectSideNeighbours - Method which connects every box with its first left or right neighbour, repeatedly.
+	* \param [in, out] BoxStore & boxes - boxes (connected neighbour is erased).
+	* \param [in] const DetectionParams & params - neighbour thresholds.
+	*/
+	template <class Kernels>
+	void connectSideNeighbours(BoxStore & boxes, const DetectionParams & params)
+	{
+		size_t i = 0;
+		while (i < boxes.size())
+		{
+			int j = Kernels::firstSideNeighbour(boxes, i, params);
+			if (j < 0)
+			{
+				i++;
+				continue;
+			}
+			// box i is tested again, unless an earlier box was erased and a later one moved to i
+			boxes.set(i, unionBox(boxes.rect(i), boxes.rect(j)));
+			boxes.erase(j);
+		}
+	}
+
+	/**
+	* \brief eraseImpossibleBoxes - Method which erases boxes higher than wide or with too high height / width.
+	* \param [in, out] BoxStore & boxes - boxes.
+	* \param [in] const DetectionParams & params - maxHeightToWidth.
+	*/
+	template <class Kernels>
+	void eraseImpossibleBoxes(BoxStore & boxes, const DetectionParams & params)
+	{
+		std::vector<uchar> flags;
+		Kernels::impossibleBoxes(boxes, params, flags);
+		boxes.eraseFlagged(flags);
+	}
+
+	/**
+	* \brief keepStackedBoxes - Method which keeps boxes with a line above or below (union goes to super boxes)
+	*and low long single lines, other boxes are erased.
+	* \param [in, out] BoxStore & boxes - boxes.
+	* \param [in] const DetectionParams & params - stack and long line thresholds.
+	* \param [out] std::vector<cv::Rect> & superBoxes - unions with first stacked neighbour and kept single lines.
+	*/
+	template <class Kernels>
+	void keepStackedBoxes(BoxStore & boxes, const DetectionParams & params, std::vector<cv::Rect> & superBoxes)
+	{
+		size_t i = 0;
+		while (i < boxes.size())
+		{
+			int j = Kernels::firstStackNeighbour(boxes, i, params);
+			cv::Rect current = boxes.rect(i);
+			if (j >= 0)
+			{
+				superBoxes.push_back(unionBox(current, boxes.rect(j)));
+				i++;
+			}
+			else if (current.height < params.longLineMaxHeight && (double)current.height / (double)current.width < params.longLineMaxAspect)
+			{
+				// small letters, more than seven words
+				superBoxes.push_back(current);
+				i++;
+			}
+			else
+			{
+				boxes.erase(i);
+			}
+		}
+	}
+
+	/**
+	* \brief applyBoxRules - Method which applies layout rules in order to reject wrong bounding boxes.
+	* \param [in] const DetectionParams & params - rule thresholds.
+	* \param [in, out] std::vector<cv::Rect> & boxes - line boxes.
+	* \param [out] std::vector<cv::Rect> & superBoxes - super boxes.
+	*/
+	template <class Kernels>
+	void applyBoxRules(const DetectionParams & params, std::vector<cv::Rect> & boxes, std::vector<cv::Rect> & superBoxes)
+	{
+		BoxStore store;
+		store.assign(boxes);
+		connectSideNeighbours<Kernels>(store, params);
+		eraseImpossibleBoxes<Kernels>(store, params);
+		keepStackedBoxes<Kernels>(store, params, superBoxes);
+		store.copyTo(boxes);
+	}
+
+	int benchmarkBoxRules(size_t setsCount, size_t boxesCount);
+}
+#endif
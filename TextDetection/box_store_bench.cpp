@@ -0,0 +1,306 @@
+#include "box_store.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+
+namespace
+{
+	/**
+	* \brief applyReferenceRules - Previous rules on std::vector<cv::Rect>, kept as reference for benchmarkBoxRules (not used by detection).
+	* \param [in] const DetectionParams & params - rule thresholds.
+	* \param [in, out] std::vector<cv::Rect> & boundingBoxes - line boxes.
+	* \param [out] std::vector<cv::Rect> & superBoundingBoxes - super boxes.
+	*/
+	void applyReferenceRules(const protech::DetectionParams & params, std::vector<cv::Rect> & boundingBoxes, std::vector<cv::Rect> & superBoundingBoxes)
+	{
+		using std::min;
+		using std::max;
+
+		// connectLeftAndRight
+		{
+			int i = 0;
+			while (i < boundingBoxes.size())
+			{
+				cv::Rect boundingBoxCurrent = boundingBoxes[i];
+				int connect = 0;
+				int j = 0;
+				while (connect == 0 && j < boundingBoxes.size())
+				{
+					if (i != j)
+					{
+						cv::Rect boundingBoxNext = boundingBoxes[j];
+
+						//Check left/right
+						if (boundingBoxCurrent.x > boundingBoxNext.x)
+						{
+							// Check left
+							if ((double)boundingBoxNext.width - params.neighbourOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) < (double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) &&
+								(double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) < (double)boundingBoxNext.width + params.neighbourGap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)std::abs(min(boundingBoxCurrent.y, boundingBoxNext.y) - (double)max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height)) < (double)max(boundingBoxCurrent.height, boundingBoxNext.height) + params.neighbourOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > params.neighbourHeightRatio)
+							{
+								connect = 1;
+								boundingBoxes[i].x = min(boundingBoxCurrent.x, boundingBoxNext.x);
+								boundingBoxes[i].y = min(boundingBoxCurrent.y, boundingBoxNext.y);
+								boundingBoxes[i].height = std::abs(boundingBoxes[i].y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
+								boundingBoxes[i].width = std::abs(boundingBoxes[i].x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
+								boundingBoxes.erase(boundingBoxes.begin() + j);
+							}
+
+						}
+						else if (boundingBoxCurrent.x < boundingBoxNext.x)
+						{
+							// Check right
+							if ((double)boundingBoxCurrent.width - params.neighbourOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) < (double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) &&
+								(double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) < (double)boundingBoxCurrent.width + params.neighbourGap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)std::abs(min(boundingBoxCurrent.y, boundingBoxNext.y) - (double)max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height)) < (double)max(boundingBoxCurrent.height, boundingBoxNext.height) + params.neighbourOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > params.neighbourHeightRatio)
+							{
+								connect = 1;
+								boundingBoxes[i].x = min(boundingBoxCurrent.x, boundingBoxNext.x);
+								boundingBoxes[i].y = min(boundingBoxCurrent.y, boundingBoxNext.y);
+								boundingBoxes[i].height = std::abs(boundingBoxes[i].y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
+								boundingBoxes[i].width = std::abs(boundingBoxes[i].x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
+								boundingBoxes.erase(boundingBoxes.begin() + j);
+							}
+						}
+					}
+					j++;
+				}
+
+				if (connect == 0)
+				{
+					i++;
+				}
+			}
+		}
+
+		// eraseImposible
+		{
+			int i = 0;
+			while (i < boundingBoxes.size())
+			{
+				cv::Rect boundingBoxCurrent = boundingBoxes[i];
+
+				if (boundingBoxCurrent.height > boundingBoxCurrent.width || (double)boundingBoxCurrent.height / (double)boundingBoxCurrent.width > params.maxHeightToWidth)
+				{
+					boundingBoxes.erase(boundingBoxes.begin() + i);
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+
+		// checkAboveAndBelowAndWidth
+		{
+			int i = 0;
+			while (i < boundingBoxes.size())
+			{
+				cv::Rect boundingBoxCurrent = boundingBoxes[i];
+				int erase = 1;
+
+				// Check below/above
+				int j = 0;
+				while (erase == 1 && j < boundingBoxes.size())
+				{
+					if (i != j)
+					{
+						cv::Rect boundingBoxNext = boundingBoxes[j];
+
+						if (boundingBoxCurrent.y < boundingBoxNext.y)
+						{
+							// Check below
+							if ((double)boundingBoxCurrent.height - params.stackOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) <= (double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) &&
+								(double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) < (double)boundingBoxCurrent.height + params.stackGap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)std::abs(min(boundingBoxCurrent.x, boundingBoxNext.x) - (double)max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width)) < (double)max(boundingBoxCurrent.width, boundingBoxNext.width) + params.stackWidthSlack * (double)min(boundingBoxCurrent.width, boundingBoxNext.width) &&
+								(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > params.stackHeightRatio &&
+								(double)min(boundingBoxCurrent.width, boundingBoxNext.width) / (double)max(boundingBoxCurrent.width, boundingBoxNext.width) > params.stackWidthRatio)
+							{
+								erase = 0;
+								cv::Rect superBoundingBox;
+								superBoundingBox.x = min(boundingBoxCurrent.x, boundingBoxNext.x);
+								superBoundingBox.y = min(boundingBoxCurrent.y, boundingBoxNext.y);
+								superBoundingBox.height = std::abs(superBoundingBox.y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
+								superBoundingBox.width = std::abs(superBoundingBox.x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
+								superBoundingBoxes.push_back(superBoundingBox);
+							}
+						}
+						else if (boundingBoxCurrent.y > boundingBoxNext.y)
+						{
+							// Check above
+							if ((double)boundingBoxNext.height - params.stackOverlap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) <= (double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) &&
+								(double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) < (double)boundingBoxNext.height + params.stackGap * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
+								(double)std::abs(min(boundingBoxCurrent.x, boundingBoxNext.x) - (double)max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width)) < (double)max(boundingBoxCurrent.width, boundingBoxNext.width) + params.stackWidthSlack * (double)min(boundingBoxCurrent.width, boundingBoxNext.width) &&
+								(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > params.stackHeightRatio &&
+								(double)min(boundingBoxCurrent.width, boundingBoxNext.width) / (double)max(boundingBoxCurrent.width, boundingBoxNext.width) > params.stackWidthRatio)
+							{
+								erase = 0;
+								cv::Rect superBoundingBox;
+								superBoundingBox.x = min(boundingBoxCurrent.x, boundingBoxNext.x);
+								superBoundingBox.y = min(boundingBoxCurrent.y, boundingBoxNext.y);
+								superBoundingBox.height = std::abs(superBoundingBox.y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
+								superBoundingBox.width = std::abs(superBoundingBox.x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
+								superBoundingBoxes.push_back(superBoundingBox);
+							}
+						}
+
+					
+					}
+					j++;
+				}
+
+				// Check height/weight ratio (small letters, more than seven words)
+				if (erase == 1)
+				{
+
+					if (boundingBoxCurrent.height < params.longLineMaxHeight && (double)boundingBoxCurrent.height / (double)boundingBoxCurrent.width < params.longLineMaxAspect)
+					{
+						erase = 0;
+						superBoundingBoxes.push_back(boundingBoxCurrent);
+					}
+				}
+
+				if (erase == 1)
+				{
+					boundingBoxes.erase(boundingBoxes.begin() + i);
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+	}
+
+
+	/**
+	* \brief sameBoxes - Method which compares two box lists.
+	*/
+	bool sameBoxes(const std::vector<cv::Rect> & a, const std::vector<cv::Rect> & b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].width != b[i].width || a[i].height != b[i].height)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	* \brief RulesRun - Output and time of one rules implementation.
+	*/
+	struct RulesRun
+	{
+		std::vector<std::vector<cv::Rect> > boxes;
+		std::vector<std::vector<cv::Rect> > superBoxes;
+		long long us;
+	};
+
+	/**
+	* \brief runRules - Method which applies rules function to every box set and measures time.
+	*/
+	template <class Rules>
+	void runRules(const protech::DetectionParams & params, const std::vector<std::vector<cv::Rect> > & sets, Rules rules, RulesRun & run)
+	{
+		run.boxes = sets;
+		run.superBoxes.assign(sets.size(), std::vector<cv::Rect>());
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		for (size_t s = 0; s < sets.size(); s++)
+		{
+			rules(params, run.boxes[s], run.superBoxes[s]);
+		}
+		run.us = (boost::posix_time::microsec_clock::local_time() - start).total_microseconds();
+	}
+}
+
+
+/**
+* \brief benchmarkBoxRules - Method which measures layout rules on synthetic pages and cross-checks implementations.
+*Pages are paragraphs of words and lines (often connected or stacked) with scattered noise boxes; reference rules,
+*scalar kernels and (if compiled) SSE2 kernels must return the same boxes and super boxes for every page.
+* \param [in] size_t setsCount - pages count (e.g. 2000).
+* \param [in] size_t boxesCount - boxes per page (e.g. 300).
+* \return int - 0 if all implementations agree, otherwise -1.
+*/
+int protech::benchmarkBoxRules(size_t setsCount, size_t boxesCount)
+{
+	DetectionParams params;
+	std::mt19937 generator(12345);
+	std::vector<std::vector<cv::Rect> > sets(setsCount);
+	for (size_t s = 0; s < setsCount; s++)
+	{
+		std::vector<cv::Rect> & boxes = sets[s];
+		while (boxes.size() < boxesCount)
+		{
+			if (generator() % 4 == 0)
+			{
+				// noise
+				boxes.push_back(cv::Rect(generator() % 1400, generator() % 2000, 11 + generator() % 200, 11 + generator() % 80));
+				continue;
+			}
+			// paragraph: lines of words, gaps around the neighbour and stack limits
+			int x = generator() % 1000;
+			int y = generator() % 1800;
+			int height = 12 + generator() % 30;
+			int lines = 1 + generator() % 5;
+			for (int l = 0; l < lines && boxes.size() < boxesCount; l++)
+			{
+				int wx = x + (int)(generator() % 10);
+				int words = 1 + generator() % 6;
+				for (int w = 0; w < words && boxes.size() < boxesCount; w++)
+				{
+					int width = height + generator() % 150;
+					int h = height + (int)(generator() % 9) - 4;
+					boxes.push_back(cv::Rect(wx, y + (int)(generator() % 5), width, h));
+					wx += width + (int)(generator() % (height + 1));
+				}
+				y += height + (int)(generator() % (height + 1));
+			}
+		}
+		std::shuffle(boxes.begin(), boxes.end(), generator);
+	}
+
+	RulesRun reference, scalar;
+	runRules(params, sets, applyReferenceRules, reference);
+	runRules(params, sets, applyBoxRules<ScalarBoxKernels>, scalar);
+	std::cout << "reference rules: " << setsCount << " pages of " << boxesCount << " boxes in " << reference.us / 1000 << " ms" << std::endl;
+	std::cout << "scalar kernels: " << setsCount << " pages of " << boxesCount << " boxes in " << scalar.us / 1000 << " ms" << std::endl;
+
+	std::vector<RulesRun*> runs;
+	std::vector<std::string> names;
+	runs.push_back(&scalar);
+	names.push_back("scalar");
+#ifdef TEXTDETECTION_BOX_SSE2
+	RulesRun sse2;
+	runRules(params, sets, applyBoxRules<Sse2BoxKernels>, sse2);
+	std::cout << "sse2 kernels: " << setsCount << " pages of " << boxesCount << " boxes in " << sse2.us / 1000 << " ms" << std::endl;
+	runs.push_back(&sse2);
+	names.push_back("sse2");
+#endif
+
+	int status = 0;
+	size_t kept = 0;
+	for (size_t s = 0; s < setsCount; s++)
+	{
+		kept += reference.boxes[s].size();
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			if (!sameBoxes(reference.boxes[s], runs[r]->boxes[s]) || !sameBoxes(reference.superBoxes[s], runs[r]->superBoxes[s]))
+			{
+				std::cout << names[r] << " kernels differ from reference rules on page " << s << std::endl;
+				status = -1;
+			}
+		}
+	}
+	std::cout << kept << " boxes kept, implementations " << (status == 0 ? "agree" : "differ") << std::endl;
+	return status;
+}
@@ -0,0 +1,120 @@
+#include "detection_params.h"
+
+#include <sstream>
+
+
+/**
+* \brief DetectionParams::DetectionParams - constructor, sets balanced preset (thresholds tuned at 1400 px).
+*/
+protech::DetectionParams::DetectionParams()
+	: name("balanced"), workingWidth(1400),
+	closeKernelWidth(7), contourFillRatio(0.3), contourMinSide(10), contourMinArea(200), contourMaxArea(300000),
+	splitMinWidth(100), splitPeakRatio(5), splitMinLineHeight(8),
+	validFillRatio(0.3), validMaxArea(100000), validMaxAspectArea(5000), validMaxAspectSide(50), validMaxHeight(70),
+	neighbourOverlap(0.4), neighbourGap(1.1), neighbourHeightRatio(0.6), maxHeightToWidth(0.65),
+	stackOverlap(0.2), stackGap(0.9), stackWidthSlack(0.4), stackHeightRatio(0.5), stackWidthRatio(0.1), longLineMaxHeight(35), longLineMaxAspect(0.06),
+	componentMinArea(2000), componentMaxArea(1000000), componentElongationDown(0.01), componentElongationUp(100), componentRectangularity(0.3),
+	ocrEngineMode(0), layoutVerdict(true), ocrTimeoutMs(10000), finalDilation(23)
+{
+}
+
+
+/**
+* \brief scaleTo - Method which changes working width and scales pixel thresholds with it.
+*Lengths are scaled by the width ratio, areas by its square; ratios are not changed.
+* \param [in] int width - new working width.
+*/
+void protech::DetectionParams::scaleTo(int width)
+{
+	if (width <= 0 || width == workingWidth)
+	{
+		return;
+	}
+	double s = width / (double)workingWidth;
+	double a = s * s;
+	workingWidth = width;
+
+	closeKernelWidth = (int)(closeKernelWidth * s + 0.5);
+	if (closeKernelWidth < 1)
+		closeKernelWidth = 1;
+	contourMinSide = (int)(contourMinSide * s + 0.5);
+	contourMinArea = (int)(contourMinArea * a + 0.5);
+	contourMaxArea = (int)(contourMaxArea * a + 0.5);
+	splitMinWidth = (int)(splitMinWidth * s + 0.5);
+	splitMinLineHeight = (int)(splitMinLineHeight * s + 0.5);
+	validMaxArea = (int)(validMaxArea * a + 0.5);
+	validMaxAspectArea *= a;
+	validMaxAspectSide *= s;
+	validMaxHeight = (int)(validMaxHeight * s + 0.5);
+	longLineMaxHeight = (int)(longLineMaxHeight * s + 0.5);
+	componentMinArea = (int)(componentMinArea * a + 0.5);
+	componentMaxArea = (int)(componentMaxArea * a + 0.5);
+
+	// odd size keeps the dilation centred
+	finalDilation = (int)(finalDilation * s + 0.5) | 1;
+}
+
+
+/**
+* \brief signature - Method which returns all parameters as one line, equal lines mean equal detection.
+* \return std::string - "name;workingWidth;...;finalDilation".
+*/
+std::string protech::DetectionParams::signature() const
+{
+	std::ostringstream text;
+	text.precision(17);
+	text << name << ";" << workingWidth << ";"
+		<< closeKernelWidth << ";" << contourFillRatio << ";" << contourMinSide << ";" << contourMinArea << ";" << contourMaxArea << ";"
+		<< splitMinWidth << ";" << splitPeakRatio << ";" << splitMinLineHeight << ";"
+		<< validFillRatio << ";" << validMaxArea << ";" << validMaxAspectArea << ";" << validMaxAspectSide << ";" << validMaxHeight << ";"
+		<< neighbourOverlap << ";" << neighbourGap << ";" << neighbourHeightRatio << ";" << maxHeightToWidth << ";"
+		<< stackOverlap << ";" << stackGap << ";" << stackWidthSlack << ";" << stackHeightRatio << ";" << stackWidthRatio << ";" << longLineMaxHeight << ";" << longLineMaxAspect << ";"
+		<< componentMinArea << ";" << componentMaxArea << ";" << componentElongationDown << ";" << componentElongationUp << ";" << componentRectangularity << ";"
+		<< ocrEngineMode << ";" << layoutVerdict << ";" << ocrTimeoutMs << ";" << finalDilation;
+	return text.str();
+}
+
+/**
+* \brief presetParams - Method which returns parameters of a named preset.
+* \param [in] const std::string & name - fast, balanced or accurate.
+* \param [out] DetectionParams & params - preset parameters.
+* \return bool - false if preset is unknown (params are not changed).
+*/
+bool protech::presetParams(const std::string & name, DetectionParams & params)
+{
+	DetectionParams preset;
+	if (name == "fast")
+	{
+		preset.scaleTo(1000);
+		preset.ocrTimeoutMs = 2000;
+	}
+	else if (name == "accurate")
+	{
+		preset.scaleTo(1800);
+		preset.layoutVerdict = false;
+		preset.ocrEngineMode = 2;// OEM_TESSERACT_CUBE_COMBINED
+		preset.ocrTimeoutMs = 20000;
+	}
+	else if (name != "balanced")
+	{
+		return false;
+	}
+
+	preset.name = name;
+	params = preset;
+	return true;
+}
+
+
+/**
+* \brief presetNames - Method which returns names of all presets, fastest first.
+* \return std::vector<std::string> - preset names.
+*/
+std::vector<std::string> protech::presetNames()
+{
+	std::vector<std::string> names;
+	names.push_back("fast");
+	names.push_back("balanced");
+	names.push_back("accurate");
+	return names;
+}
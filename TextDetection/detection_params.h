@@ -0,0 +1,83 @@
+/*!\file detection_params.h
+*
+*	Detection parameters and speed/accuracy presets used in TextDetection project.
+*	All thresholds of the detection stages are tuned for the balanced working width (1400 px); presets with another
+*	working width scale lengths by the width ratio and areas by its square, so the same text is kept at every width.
+*	  - fast: 1000 px, layout verdict for clear regions, 2 s OCR timeout,
+*	  - balanced: 1400 px, layout verdict for clear regions, 10 s OCR timeout (previous hard-coded behaviour),
+*	  - accurate: 1800 px, full recognition of every region, combined Tesseract/Cube engine where its data is installed, 20 s OCR timeout.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef DETECTION_PARAMS_H
+#define DETECTION_PARAMS_H
+
+#include <string>
+#include <vector>
+
+
+namespace protech
+{
+	/**
+	* \brief DetectionParams - Thresholds of detection stages and OCR settings (defaults are the balanced preset).
+	*/
+	struct DetectionParams
+	{
+		std::string name;//!< Preset name.
+		int workingWidth;//!< Width to which every image is resized before detection.
+
+		// preprocess and contours
+		int closeKernelWidth;//!< Width of horizontal closing kernel connecting characters.
+		double contourFillRatio;//!< Minimal ratio of edge pixels in contour rect.
+		int contourMinSide;//!< Contour rect width and height must be larger.
+		int contourMinArea;//!< Contour rect area must be larger.
+		int contourMaxArea;//!< Contour rect area must be smaller.
+
+		// split of multi-line rects
+		int splitMinWidth;//!< Only wider rects are split into lines.
+		double splitPeakRatio;//!< Rect is split when row histogram peak is this many times its minimum.
+		int splitMinLineHeight;//!< Rows above histogram threshold needed for one line.
+
+		// validation
+		double validFillRatio;//!< Minimal ratio of edge pixels in line rect.
+		int validMaxArea;//!< Line rect area must be smaller.
+		double validMaxAspectArea;//!< Relative aspect ratio * area must be smaller.
+		double validMaxAspectSide;//!< Relative aspect ratio * average side must be smaller.
+		int validMaxHeight;//!< Line rect height must be smaller.
+
+		// rules
+		double neighbourOverlap;//!< Left/right neighbours may overlap by this part of lower height.
+		double neighbourGap;//!< Left/right neighbours may be apart by this part of lower height.
+		double neighbourHeightRatio;//!< Lower / higher height of connected neighbours must be larger.
+		double maxHeightToWidth;//!< Rects with higher height / width are not text lines.
+		double stackOverlap;//!< Lines above/below may overlap by this part of lower height.
+		double stackGap;//!< Lines above/below may be apart by this part of lower height.
+		double stackWidthSlack;//!< Lines above/below may extend by this part of narrower width.
+		double stackHeightRatio;//!< Lower / higher height of stacked lines must be larger.
+		double stackWidthRatio;//!< Narrower / wider width of stacked lines must be larger.
+		int longLineMaxHeight;//!< Single lines lower than this are kept when they are long.
+		double longLineMaxAspect;//!< Height / width of kept single lines must be smaller.
+
+		// components
+		int componentMinArea;//!< Component area must be larger.
+		int componentMaxArea;//!< Component area must be smaller.
+		double componentElongationDown;//!< Minimal component elongation.
+		double componentElongationUp;//!< Maximal component elongation.
+		double componentRectangularity;//!< Minimal component rectangularity.
+
+		// verification and output
+		int ocrEngineMode;//!< tesseract::OcrEngineMode of engines (falls back to Tesseract only when data is missing).
+		bool layoutVerdict;//!< Decide clear regions on layout counts, without character recognition.
+		int ocrTimeoutMs;//!< Recognition time limit per region and language.
+		int finalDilation;//!< Size of dilation kernel of output text mask.
+
+		DetectionParams();
+
+		void scaleTo(int width);
+		std::string signature() const;
+	};
+
+	bool presetParams(const std::string & name, DetectionParams & params);
+	std::vector<std::string> presetNames();
+}
+#endif
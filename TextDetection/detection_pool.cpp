@@ -0,0 +1,392 @@
+#include "detection_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "metrics.h"
+#include "thread_budget.h"
+
+
+/**
+* \brief DetectionPool::DetectionPool - constructor, starts worker threads.
+* \param [in] std::string _OUTPUT_FOLDER_PATH - output folder path.
+* \param [in] const std::vector<std::string> & languages - Tesseract language codes loaded by every worker, default first.
+* \param [in] const DetectionParams & params - detection parameters of every worker.
+* \param [in] size_t workersCount - number of worker threads (and Tesseract engines), at least one.
+* \param [in] const size_t * classCaps - maximum workers busy with images and regions of a priority class (NULL or 0 means all workers).
+* \param [in] bool regionTasks - verify regions as separate tasks shared by all workers (otherwise one worker runs whole image).
+*/
+protech::DetectionPool::DetectionPool(std::string _OUTPUT_FOLDER_PATH, const std::vector<std::string> & languages, const DetectionParams & params, size_t workersCount, const size_t * classCaps, bool regionTasks)
+	: OUTPUT_FOLDER_PATH(_OUTPUT_FOLDER_PATH), LANGUAGES(languages), PARAMS(params), m_closed(false), m_regionTasks(regionTasks)
+{
+	if (workersCount == 0)
+	{
+		workersCount = 1;
+	}
+	for (int i = 0; i < DetectionOptions::PRIORITIES_COUNT; i++)
+	{
+		m_running[i] = 0;
+		m_caps[i] = (classCaps != NULL && classCaps[i] > 0) ? classCaps[i] : workersCount;
+		m_regionQueues[i].resize(workersCount);
+		m_regionsQueued[i] = 0;
+	}
+	for (size_t i = 0; i < workersCount; i++)
+	{
+		m_workers.push_back(std::thread(&DetectionPool::workerLoop, this, i));
+	}
+}
+
+
+/**
+* \brief DetectionPool::~DetectionPool - destructor, finishes already submitted images and joins workers.
+*/
+protech::DetectionPool::~DetectionPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_closed = true;
+		m_wake.notify_all();
+	}
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		if (m_workers[i].joinable())
+		{
+			m_workers[i].join();
+		}
+	}
+}
+
+
+/**
+* \brief submit - Method which queues image for text detection on the next free worker.
+* \param [in] const cv::Mat & image - image for text detection (shared, not copied; must not be modified until result is ready).
+* \param [in] const DetectionOptions & options - per-image options (priority selects the queue).
+* \return std::future<TextDetectionResult> - result; holds exception if detection failed.
+*/
+std::future<protech::TextDetectionResult> protech::DetectionPool::submit(const cv::Mat & image, const DetectionOptions & options)
+{
+	std::shared_ptr<DetectionTask> task(new DetectionTask());
+	task->image = image;
+	task->options = options;
+	if (task->options.priority < 0 || task->options.priority >= DetectionOptions::PRIORITIES_COUNT)
+	{
+		task->options.priority = DetectionOptions::PRIORITY_NORMAL;
+	}
+	task->submitted = boost::chrono::steady_clock::now();
+	std::future<TextDetectionResult> result = task->promise.get_future();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (m_closed)
+	{
+		task->promise.set_exception(std::make_exception_ptr(std::runtime_error("detection pool is stopped")));
+		return result;
+	}
+	m_queues[task->options.priority].push_back(task);
+	m_wake.notify_all();
+	return result;
+}
+
+
+/**
+* \brief pendingCount - Method which returns number of queued (not running) images of all classes.
+*/
+size_t protech::DetectionPool::pendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	size_t count = 0;
+	for (int i = 0; i < DetectionOptions::PRIORITIES_COUNT; i++)
+	{
+		count += m_queues[i].size();
+	}
+	return count;
+}
+
+
+/**
+* \brief takeImage - Method which takes the oldest image of a class if the class is below its cap (pool lock must be held).
+* \param [in] int priority - image class.
+* \param [out] std::shared_ptr<DetectionTask> & task - taken image.
+* \return bool - true if image is taken.
+*/
+bool protech::DetectionPool::takeImage(int priority, std::shared_ptr<DetectionTask> & task)
+{
+	if (m_queues[priority].empty() || m_running[priority] >= m_caps[priority])
+	{
+		return false;
+	}
+	task = m_queues[priority].front();
+	m_queues[priority].pop_front();
+	m_running[priority]++;
+	return true;
+}
+
+
+/**
+* \brief takeRegion - Method which takes largest region of a class from own deque, or steals largest region of the fullest deque (pool lock must be held).
+* \param [in] size_t index - worker index.
+* \param [in] int priority - image class.
+* \param [out] RegionTask & region - taken region.
+* \return bool - true if region is taken (class is below its cap).
+*/
+bool protech::DetectionPool::takeRegion(size_t index, int priority, RegionTask & region)
+{
+	if (m_regionsQueued[priority] == 0 || m_running[priority] >= m_caps[priority])
+	{
+		return false;
+	}
+
+	std::vector<std::deque<RegionTask> > & queues = m_regionQueues[priority];
+	size_t victim = index;
+	if (queues[index].empty())
+	{
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			if (queues[i].size() > ((victim == index) ? 0 : queues[victim].size()))
+				victim = i;
+		}
+		if (victim == index)
+		{
+			return false;
+		}
+		metrics().add(Metrics::COUNT_REGIONS_STOLEN, 1);
+	}
+
+	region = queues[victim].front();
+	queues[victim].pop_front();
+	m_regionsQueued[priority]--;
+	m_running[priority]++;
+	return true;
+}
+
+
+/**
+* \brief takeTask - Method which waits for the next image or region task.
+*Classes are served from the highest one below its cap: urgent images before urgent regions, in lower classes
+*regions of started images before new images.
+* \param [in] size_t index - worker index.
+* \param [out] std::shared_ptr<DetectionTask> & task - taken image (empty if region is taken).
+* \param [out] RegionTask & region - taken region.
+* \return bool - false if pool is closed and there is no queued image or region, otherwise true.
+*/
+bool protech::DetectionPool::takeTask(size_t index, std::shared_ptr<DetectionTask> & task, RegionTask & region)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	while (true)
+	{
+		bool queued = false;
+		for (int i = 0; i < DetectionOptions::PRIORITIES_COUNT; i++)
+		{
+			bool imageFirst = (i == DetectionOptions::PRIORITY_HIGH);
+			if (imageFirst && takeImage(i, task))
+			{
+				return true;
+			}
+			if (takeRegion(index, i, region))
+			{
+				task.reset();
+				return true;
+			}
+			if (!imageFirst && takeImage(i, task))
+			{
+				return true;
+			}
+			queued = queued || !m_queues[i].empty() || m_regionsQueued[i] > 0;
+		}
+		if (m_closed && !queued)
+		{
+			return false;
+		}
+		m_wake.wait(lock);
+	}
+}
+
+
+/**
+* \brief taskDone - Method which frees worker slot of a class and wakes waiting workers.
+* \param [in] int priority - image class.
+*/
+void protech::DetectionPool::taskDone(int priority)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_running[priority]--;
+	m_wake.notify_all();
+}
+
+
+/**
+* \brief runImage - Method which runs detection of an image; with region tasks, its regions are queued on this worker's deque.
+*Worker slot of the image class is freed when regions are queued (they take their own slots).
+* \param [in] TextDetector & detector - detector of this worker.
+* \param [in] size_t index - worker index.
+* \param [in] const std::shared_ptr<DetectionTask> & task - taken image.
+*/
+void protech::DetectionPool::runImage(TextDetector & detector, size_t index, const std::shared_ptr<DetectionTask> & task)
+{
+	int priority = task->options.priority;
+	metrics().recordQueueDelay(priority, (unsigned long long)boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now() - task->submitted).count());
+
+	std::shared_ptr<ImageWork> image;
+	try
+	{
+		detector.setWriteImages(task->options.writeImages);
+		detector.setTextRequested(task->options.textRequested);
+		detector.setDeadline(task->options.deadlineMs);
+		detector.setTriageThreshold(task->options.triageThreshold);
+		detector.setStripes(task->options.stripes);
+		detector.setResultMask(task->options.resultMask);
+		detector.setFrameOcr(task->options.frameOcr);
+		detector.setImageLanguages(task->options.languages);
+
+		// frame OCR sets whole masked frame to one engine, so its regions stay on this worker
+		if (!m_regionTasks || task->options.frameOcr)
+		{
+			TextDetectionResult result;
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+			detector.textDetectionFunction(task->image, task->options.name, result);
+			result.detectMs = (long)(boost::posix_time::microsec_clock::local_time() - start).total_milliseconds();
+
+			task->promise.set_value(result);
+			taskDone(priority);
+			return;
+		}
+
+		image.reset(new ImageWork());
+		image->task = task;
+		image->started = boost::chrono::steady_clock::now();
+		detector.detectRegions(task->image, task->options.name, image->batch);
+		// regions of one image are verified by several detectors at once
+		image->batch.inPlace = false;
+	}
+	catch (...)
+	{
+		task->promise.set_exception(std::current_exception());
+		taskDone(priority);
+		return;
+	}
+
+	size_t regionsCount = image->batch.rects.size();
+	if (regionsCount == 0)
+	{
+		finishImage(detector, image);
+		taskDone(priority);
+		return;
+	}
+
+	// largest region first: it is the long pole of the image
+	std::vector<std::pair<int, size_t> > order;
+	for (size_t rc = 0; rc < regionsCount; rc++)
+	{
+		order.push_back(std::make_pair(-image->batch.rects[rc].area(), rc));
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	image->remaining.store(regionsCount);
+	image->batch.clock.suspend();
+	metrics().add(Metrics::COUNT_REGION_TASKS, regionsCount);
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		RegionTask region;
+		region.image = image;
+		region.index = order[k].second;
+		region.priority = priority;
+		m_regionQueues[priority][index].push_back(region);
+	}
+	m_regionsQueued[priority] += regionsCount;
+	m_running[priority]--;
+	m_wake.notify_all();
+}
+
+
+/**
+* \brief runRegion - Method which verifies one region; the last region of an image also finishes the image.
+* \param [in] TextDetector & detector - detector of this worker.
+* \param [in] RegionTask & region - taken region.
+*/
+void protech::DetectionPool::runRegion(TextDetector & detector, RegionTask & region)
+{
+	try
+	{
+		detector.verifyRegion(region.image->batch, region.index);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!region.image->error)
+			region.image->error = std::current_exception();
+	}
+
+	if (region.image->remaining.fetch_sub(1) == 1)
+	{
+		finishImage(detector, region.image);
+	}
+	region.image.reset();
+	taskDone(region.priority);
+}
+
+
+/**
+* \brief finishImage - Method which runs output stage of an image whose regions are all verified and fulfils its promise.
+* \param [in] TextDetector & detector - detector of this worker.
+* \param [in] const std::shared_ptr<ImageWork> & image - image.
+*/
+void protech::DetectionPool::finishImage(TextDetector & detector, const std::shared_ptr<ImageWork> & image)
+{
+	DetectionTask & task = *image->task;
+	try
+	{
+		if (image->error)
+			std::rethrow_exception(image->error);
+
+		image->batch.clock.resume();
+		detector.finishRegions(image->batch);
+		image->batch.result.detectMs = (long)boost::chrono::duration_cast<boost::chrono::milliseconds>(boost::chrono::steady_clock::now() - image->started).count();
+		task.promise.set_value(image->batch.result);
+	}
+	catch (...)
+	{
+		task.promise.set_exception(std::current_exception());
+	}
+}
+
+
+/**
+* \brief workerLoop - Worker thread: initializes own detector and runs images and region tasks until pool is stopped.
+* \param [in] size_t index - worker index (own region deque).
+*/
+void protech::DetectionPool::workerLoop(size_t index)
+{
+	pinWorkerThread(index);
+
+	TextDetector* detector = new TextDetector();
+	detector->setParams(PARAMS);
+	detector->initialize(OUTPUT_FOLDER_PATH, LANGUAGES.empty() ? std::string("eng") : LANGUAGES[0]);
+	for (size_t i = 1; i < LANGUAGES.size(); i++)
+	{
+		// the submitting detector may not load engines itself, so the first worker reports missing data
+		if (!detector->addLanguage(LANGUAGES[i]) && index == 0)
+			std::cout << "Cannot load language " << LANGUAGES[i] << ", its images use remaining languages..." << std::endl;
+	}
+
+	std::shared_ptr<DetectionTask> task;
+	RegionTask region;
+	while (takeTask(index, task, region))
+	{
+		if (task)
+		{
+			runImage(*detector, index, task);
+			task.reset();
+		}
+		else
+		{
+			runRegion(*detector, region);
+		}
+	}
+
+	delete detector;
+}
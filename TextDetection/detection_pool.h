@@ -0,0 +1,109 @@
+/*!\file detection_pool.h
+*
+*	Header for DetectionPool (worker threads behind TextDetector::submit) used in TextDetection project.
+*	Every worker thread creates and initializes its own TextDetector (and so its own Tesseract engine)
+*	and uses it only from that thread, which keeps Tesseract's thread-affinity constraint.
+*	Images are queued per priority class; a class cap limits workers busy with images and regions of the class.
+*	With region tasks (default), OCR of candidate regions does not stay on the worker which detected the image:
+*	the worker pushes the regions to its own deque of the image class, largest first, and takes them from there,
+*	while idle workers steal the largest region of the fullest deque. The image is finished by the worker which
+*	verifies its last region. A free worker serves the highest class below its cap: urgent images, then urgent
+*	regions; in lower classes queued regions come before new images, so started images finish first.
+*	Regions see the image masked as in sequential detection, so the result does not depend on workers count.
+*	Frame OCR images are detected and verified whole by one worker (one Tesseract image per frame).
+*	One lock guards images and deques; a region task runs for milliseconds, so it is not contended.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef DETECTION_POOL_H
+#define DETECTION_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/chrono/chrono.hpp>
+
+#include "textDetector.h"
+
+
+namespace protech
+{
+	class DetectionPool
+	{
+	private:
+		/**
+		* \brief DetectionTask - One submitted image and promise of its result.
+		*/
+		struct DetectionTask
+		{
+			cv::Mat image;//!< Image for text detection.
+			DetectionOptions options;//!< Per-image options.
+			std::promise<TextDetectionResult> promise;//!< Fulfilled by worker.
+			boost::chrono::steady_clock::time_point submitted;//!< Submit time, for queueing delay.
+		};
+
+		/**
+		* \brief ImageWork - Detected image whose regions are being verified.
+		*/
+		struct ImageWork
+		{
+			std::shared_ptr<DetectionTask> task;//!< Submitted image.
+			RegionBatch batch;//!< Candidate regions and their results.
+			std::atomic<size_t> remaining;//!< Regions which are not verified yet.
+			std::exception_ptr error;//!< First region failure (guarded by pool lock).
+			boost::chrono::steady_clock::time_point started;//!< Detection start, for detectMs.
+		};
+
+		/**
+		* \brief RegionTask - OCR of one region of an image.
+		*/
+		struct RegionTask
+		{
+			std::shared_ptr<ImageWork> image;//!< Image of the region.
+			size_t index;//!< Region index in image batch.
+			int priority;//!< Class of the image.
+
+			RegionTask() : index(0), priority(DetectionOptions::PRIORITY_NORMAL){};
+		};
+
+		std::string OUTPUT_FOLDER_PATH;//!< output folder path.
+		std::vector<std::string> LANGUAGES;//!< Languages kept warm by every worker, default first.
+		DetectionParams PARAMS;//!< Detection parameters of every worker.
+		std::deque<std::shared_ptr<DetectionTask> > m_queues[DetectionOptions::PRIORITIES_COUNT];//!< Submitted tasks per priority class (unbounded).
+		size_t m_running[DetectionOptions::PRIORITIES_COUNT];//!< Workers running an image or region of the class.
+		size_t m_caps[DetectionOptions::PRIORITIES_COUNT];//!< Maximum busy workers per class.
+		bool m_closed;//!< No more tasks are accepted; workers finish queued tasks and exit.
+		bool m_regionTasks;//!< Regions are verified as separate tasks; otherwise one worker runs whole image.
+		std::vector<std::deque<RegionTask> > m_regionQueues[DetectionOptions::PRIORITIES_COUNT];//!< Region deque per class and worker, largest region first.
+		size_t m_regionsQueued[DetectionOptions::PRIORITIES_COUNT];//!< Regions in all deques of the class.
+		std::mutex m_lock;
+		std::condition_variable m_wake;
+		std::vector<std::thread> m_workers;//!< Worker threads.
+
+		void workerLoop(size_t index);
+		bool takeTask(size_t index, std::shared_ptr<DetectionTask> & task, RegionTask & region);
+		bool takeImage(int priority, std::shared_ptr<DetectionTask> & task);
+		bool takeRegion(size_t index, int priority, RegionTask & region);
+		void runImage(TextDetector & detector, size_t index, const std::shared_ptr<DetectionTask> & task);
+		void runRegion(TextDetector & detector, RegionTask & region);
+		void finishImage(TextDetector & detector, const std::shared_ptr<ImageWork> & image);
+		void taskDone(int priority);
+
+	public:
+		DetectionPool(std::string _OUTPUT_FOLDER_PATH, const std::vector<std::string> & languages, const DetectionParams & params, size_t workersCount, const size_t * classCaps = NULL, bool regionTasks = true);
+		~DetectionPool();
+
+		std::future<TextDetectionResult> submit(const cv::Mat & image, const DetectionOptions & options);
+		size_t workersCount() const { return m_workers.size(); };
+		size_t pendingCount();
+	};
+}
+#endif
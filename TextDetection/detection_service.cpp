@@ -0,0 +1,517 @@
+// boost::asio must be included before windows.h (pulled in by Tesseract headers).
+#include <boost/asio.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "detection_service.h"
+#include "image_loader.h"
+#include "metrics.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+namespace
+{
+	const int JOB_OK = 0;//!< Job is parsed.
+	const int JOB_BAD = 1;//!< Job is rejected, stream can be read further.
+	const int JOB_STREAM_BROKEN = 2;//!< Inline data can not be read, stream is out of sync.
+
+	const size_t MAX_INLINE_BYTES = 256 * 1024 * 1024;//!< Upper limit for inline image size.
+
+	/**
+	* \brief escapeText - Method for escaping OCR text so that it fits on one response line.
+	* \param [in] const std::string & text - OCR text.
+	* \return std::string - text with \\, new lines and tabs escaped.
+	*/
+	std::string escapeText(const std::string & text)
+	{
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			switch (text[i])
+			{
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default: escaped += text[i]; break;
+			}
+		}
+		return escaped;
+	}
+
+	/**
+	* \brief elapsedMs - Method for getting milliseconds since given time.
+	* \param [in] boost::posix_time::ptime start - start time.
+	* \return double - elapsed milliseconds.
+	*/
+	double elapsedMs(boost::posix_time::ptime start)
+	{
+		boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::local_time() - start;
+		return duration.total_microseconds() / 1000.0;
+	}
+}
+
+
+/**
+* \brief DetectionService::~DetectionService - destructor.
+*/
+protech::DetectionService::~DetectionService()
+{
+	clear();
+}
+
+
+/**
+* \brief initialize - Method for initializing detectors (and Tesseract data) for all given languages.
+* \param [in] std::string _OUTPUT_FOLDER_PATH - output folder.
+* \param [in] const std::vector<std::string> & languages - Tesseract language codes, first one is default.
+* \return bool - true if at least one detector is initialized, otherwise false.
+*/
+bool protech::DetectionService::initialize(std::string _OUTPUT_FOLDER_PATH, const std::vector<std::string> & languages)
+{
+	OUTPUT_FOLDER_PATH = _OUTPUT_FOLDER_PATH;
+
+	for (size_t i = 0; i < languages.size(); i++)
+	{
+		if (m_detectors.find(languages[i]) != m_detectors.end())
+		{
+			continue;
+		}
+
+		TextDetector* detector = new TextDetector();
+		detector->initialize(OUTPUT_FOLDER_PATH, languages[i]);
+		m_detectors[languages[i]] = detector;
+		m_detectorLocks[languages[i]] = new std::mutex();
+
+		if (DEFAULT_LANGUAGE.empty())
+		{
+			DEFAULT_LANGUAGE = languages[i];
+		}
+	}
+
+	return !m_detectors.empty();
+}
+
+
+/**
+* \brief clear - Method for releasing all detectors.
+*/
+void protech::DetectionService::clear()
+{
+	std::map<std::string, TextDetector*>::iterator it;
+	for (it = m_detectors.begin(); it != m_detectors.end(); ++it)
+	{
+		delete it->second;
+	}
+	m_detectors.clear();
+
+	std::map<std::string, std::mutex*>::iterator itLock;
+	for (itLock = m_detectorLocks.begin(); itLock != m_detectorLocks.end(); ++itLock)
+	{
+		delete itLock->second;
+	}
+	m_detectorLocks.clear();
+}
+
+
+/**
+* \brief readJob - Method for parsing one DETECT request (and reading its inline image bytes).
+* \param [in] std::istream & in - request stream.
+* \param [in] const std::string & line - request line.
+* \param [out] DetectionJob & job - parsed job.
+* \param [out] std::string & error - error message.
+* \return int - JOB_OK, JOB_BAD or JOB_STREAM_BROKEN.
+*/
+int protech::DetectionService::readJob(std::istream & in, const std::string & line, DetectionJob & job, std::string & error)
+{
+	std::istringstream iss(line);
+	std::string command, language, options, source;
+	iss >> command >> job.id >> language >> options >> source;
+
+	job.writeImages = false;
+	job.textRequested = false;
+	job.deadlineMs = 0;
+
+	if (command != "DETECT" || job.id.empty() || source.empty())
+	{
+		error = "bad request";
+		return JOB_BAD;
+	}
+
+	if (source == "PATH")
+	{
+		std::getline(iss, job.path);
+		boost::trim(job.path);
+		if (job.path.empty())
+		{
+			error = "missing path";
+			return JOB_BAD;
+		}
+	}
+	else if (source == "DATA")
+	{
+		size_t bytesCount = 0;
+		if (!(iss >> bytesCount) || bytesCount == 0 || bytesCount > MAX_INLINE_BYTES)
+		{
+			error = "bad data size";
+			return JOB_STREAM_BROKEN;
+		}
+		job.data.resize(bytesCount);
+		in.read(reinterpret_cast<char*>(&job.data[0]), bytesCount);
+		if ((size_t)in.gcount() != bytesCount)
+		{
+			error = "incomplete data";
+			return JOB_STREAM_BROKEN;
+		}
+	}
+	else
+	{
+		error = "unknown source " + source;
+		return JOB_BAD;
+	}
+
+	job.language = (language == "-") ? DEFAULT_LANGUAGE : languageCode(language);
+	if (m_detectors.find(job.language) == m_detectors.end())
+	{
+		error = "language not loaded " + language;
+		return JOB_BAD;
+	}
+
+	if (options != "-")
+	{
+		std::istringstream optionsStream(options);
+		std::string option;
+		while (std::getline(optionsStream, option, ','))
+		{
+			if (option == "images=1")
+				job.writeImages = true;
+			else if (option == "text=1")
+				job.textRequested = true;
+			else if (option.compare(0, 9, "deadline=") == 0)
+				job.deadlineMs = atoi(option.c_str() + 9);
+		}
+	}
+
+	return JOB_OK;
+}
+
+
+/**
+* \brief runJob - Method for running text detection for one job and streaming its result.
+* \param [in] DetectionJob & job - job.
+* \param [in] std::ostream & out - response stream.
+*/
+void protech::DetectionService::runJob(DetectionJob & job, std::ostream & out)
+{
+	std::ostringstream response;
+	try
+	{
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		cv::Mat image;
+		if (!job.data.empty())
+		{
+			image = decodeImage(&job.data[0], job.data.size(), TextDetector::WORKING_WIDTH, !job.writeImages);
+		}
+		else
+		{
+			image = loadImage(job.path, TextDetector::WORKING_WIDTH, !job.writeImages);
+		}
+		double decodeMs = elapsedMs(start);
+		metrics().recordStage(Metrics::STAGE_DECODE, (unsigned long long)(decodeMs * 1000.0));
+
+		if (image.data == NULL)
+		{
+			response << "DONE " << job.id << " ERROR cannot decode image" << "\n";
+		}
+		else
+		{
+			std::string img_name = job.path.empty() ? job.id : boost::filesystem::path(job.path).stem().string();
+
+			TextDetectionResult result;
+			start = boost::posix_time::microsec_clock::local_time();
+			{
+				std::lock_guard<std::mutex> lock(*m_detectorLocks[job.language]);
+				TextDetector* detector = m_detectors[job.language];
+				detector->setWriteImages(job.writeImages);
+				detector->setTextRequested(job.textRequested);
+				detector->setDeadline(job.deadlineMs);
+				detector->textDetectionFunction(image, img_name, result);
+			}
+			double detectMs = elapsedMs(start);
+
+			int acceptedCount = 0;
+			for (size_t i = 0; i < result.regions.size(); i++)
+			{
+				const TextRegionResult & region = result.regions[i];
+				if (region.accepted)
+				{
+					response << "REGION " << job.id << " " << region.rect.x << " " << region.rect.y << " " << region.rect.width << " " << region.rect.height << " " << escapeText(region.text) << "\n";
+					acceptedCount++;
+				}
+			}
+			response << "DONE " << job.id << " OK " << decodeMs << " " << detectMs << " " << acceptedCount << (result.partial ? " PARTIAL" : "") << "\n";
+		}
+	}
+	catch (std::exception & ex)
+	{
+		response << "DONE " << job.id << " ERROR " << ex.what() << "\n";
+	}
+	catch (...)
+	{
+		response << "DONE " << job.id << " ERROR unknown exception" << "\n";
+	}
+
+	std::lock_guard<std::mutex> lock(m_outputLock);
+	out << response.str() << std::flush;
+}
+
+
+/**
+* \brief serve - Method for serving requests from given stream until QUIT or end of stream.
+* \param [in] std::istream & in - request stream.
+* \param [in] std::ostream & out - response stream.
+* \return int - 0 on success.
+*/
+int protech::DetectionService::serve(std::istream & in, std::ostream & out)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_outputLock);
+		out << "READY";
+		std::map<std::string, TextDetector*>::iterator it;
+		for (it = m_detectors.begin(); it != m_detectors.end(); ++it)
+		{
+			out << " " << it->first;
+		}
+		out << std::endl;
+	}
+
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+		if (line.empty())
+		{
+			continue;
+		}
+		if (line == "QUIT")
+		{
+			break;
+		}
+		if (line == "PING")
+		{
+			std::lock_guard<std::mutex> lock(m_outputLock);
+			out << "PONG" << std::endl;
+			continue;
+		}
+
+		DetectionJob job;
+		std::string error;
+		int status = readJob(in, line, job, error);
+		if (status != JOB_OK)
+		{
+			std::lock_guard<std::mutex> lock(m_outputLock);
+			out << "DONE " << (job.id.empty() ? "-" : job.id) << " ERROR " << error << std::endl;
+			if (status == JOB_STREAM_BROKEN)
+			{
+				break;
+			}
+			continue;
+		}
+
+		runJob(job, out);
+	}
+
+	return 0;
+}
+
+
+/**
+* \brief serveStdio - Method for serving requests from stdin, responses are written to stdout.
+* \return int - 0 on success.
+*/
+int protech::DetectionService::serveStdio()
+{
+#ifdef _WIN32
+	// inline image bytes must not be translated
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	return serve(std::cin, std::cout);
+}
+
+
+/**
+* \brief serveLoopback - Method for serving requests on a TCP port bound to the loopback interface, one thread per connection.
+* \param [in] unsigned short port - TCP port (only 127.0.0.1 is bound, the service is not reachable from other hosts).
+* \return int - -1 if port can not be bound, otherwise does not return.
+*/
+int protech::DetectionService::serveLoopback(unsigned short port)
+{
+	using boost::asio::ip::tcp;
+	try
+	{
+		boost::asio::io_service ioService;
+		tcp::acceptor acceptor(ioService, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+		std::cout << "Listening on 127.0.0.1:" << port << std::endl;
+
+		for (;;)
+		{
+			std::shared_ptr<tcp::iostream> stream(new tcp::iostream());
+			boost::system::error_code ec;
+			acceptor.accept(*stream->rdbuf(), ec);
+			if (ec)
+			{
+				std::cout << "Accept failed: " << ec.message() << std::endl;
+				continue;
+			}
+
+			std::thread connection([this, stream]()
+			{
+				serve(*stream, *stream);
+			});
+			connection.detach();
+		}
+	}
+	catch (std::exception & ex)
+	{
+		std::cout << "Exception: " << ex.what() << std::endl;
+	}
+	return -1;
+}
+
+
+/**
+* \brief runLoadGenerator - Method for measuring service request latency from a local client.
+*Requests are sent over given number of connections, each connection sends one request at a time.
+* \param [in] unsigned short port - service port on 127.0.0.1.
+* \param [in] const std::vector<std::string> & imagePaths - images, used round-robin.
+* \param [in] std::string language - request language ("-" for service default).
+* \param [in] int requestsCount - total requests count.
+* \param [in] int connectionsCount - concurrent connections count.
+* \param [in] bool sendInline - if true, image bytes are sent with the request, otherwise only path.
+* \return int - 0 if all requests succeeded, otherwise -1.
+*/
+int protech::runLoadGenerator(unsigned short port, const std::vector<std::string> & imagePaths, std::string language, int requestsCount, int connectionsCount, bool sendInline)
+{
+	std::string portName = boost::lexical_cast<std::string>(port);
+	if (imagePaths.empty() || requestsCount <= 0 || connectionsCount <= 0)
+	{
+		std::cout << "Nothing to send..." << std::endl;
+		return -1;
+	}
+
+	std::vector<std::string> inlineData(imagePaths.size());
+	if (sendInline)
+	{
+		for (size_t i = 0; i < imagePaths.size(); i++)
+		{
+			std::ifstream file(imagePaths[i].c_str(), std::ios::binary);
+			std::ostringstream bytes;
+			bytes << file.rdbuf();
+			inlineData[i] = bytes.str();
+		}
+	}
+
+	std::vector<double> latencies;
+	std::mutex latenciesLock;
+	std::atomic<int> nextRequest(0);
+	std::atomic<int> failed(0);
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+	std::vector<std::thread> clients;
+	for (int c = 0; c < connectionsCount; c++)
+	{
+		clients.push_back(std::thread([&]()
+		{
+			boost::asio::ip::tcp::iostream stream("127.0.0.1", portName);
+			std::string line;
+			if (!stream || !std::getline(stream, line))
+			{
+				std::cout << "Cannot connect to 127.0.0.1:" << port << std::endl;
+				return;
+			}
+
+			for (int r = nextRequest++; r < requestsCount; r = nextRequest++)
+			{
+				size_t imageIdx = r % imagePaths.size();
+				std::string id = boost::lexical_cast<std::string>(r);
+				std::string done = "DONE " + id + " ";
+
+				boost::posix_time::ptime requestStart = boost::posix_time::microsec_clock::local_time();
+				if (sendInline)
+				{
+					stream << "DETECT " << id << " " << language << " - DATA " << inlineData[imageIdx].size() << "\n";
+					stream.write(inlineData[imageIdx].data(), inlineData[imageIdx].size());
+				}
+				else
+				{
+					stream << "DETECT " << id << " " << language << " - PATH " << imagePaths[imageIdx] << "\n";
+				}
+				stream.flush();
+
+				bool ok = false;
+				while (std::getline(stream, line))
+				{
+					if (line.compare(0, done.size(), done) == 0)
+					{
+						ok = (line.compare(done.size(), 2, "OK") == 0);
+						break;
+					}
+				}
+				double latency = elapsedMs(requestStart);
+
+				if (!ok)
+				{
+					failed++;
+				}
+				std::lock_guard<std::mutex> lock(latenciesLock);
+				latencies.push_back(latency);
+			}
+		}));
+	}
+	for (size_t c = 0; c < clients.size(); c++)
+	{
+		clients[c].join();
+	}
+
+	double totalMs = elapsedMs(start);
+	if (latencies.empty())
+	{
+		return -1;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	const double percentiles[] = { 50.0, 90.0, 95.0, 99.0, 99.9 };
+
+	std::cout << "Requests: " << latencies.size() << ", failed: " << failed << ", connections: " << connectionsCount << std::endl;
+	std::cout << "Throughput: " << latencies.size() * 1000.0 / totalMs << " req/s" << std::endl;
+	std::cout << "Latency ms:";
+	for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++)
+	{
+		size_t rank = (size_t)std::ceil(percentiles[p] / 100.0 * latencies.size());
+		size_t idx = (rank > 0) ? rank - 1 : 0;
+		std::cout << " p" << percentiles[p] << "=" << latencies[idx];
+	}
+	std::cout << " max=" << latencies.back() << std::endl;
+
+	return (failed == 0) ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+/*!\file detection_service.h
+*
+*	Header for DetectionService (long-running service mode) used in TextDetection project.
+*	Engines for all configured languages are initialized once and jobs are read
+*	from a line-delimited protocol on stdin/stdout or on a TCP port bound to 127.0.0.1.
+*
+*	Request:  DETECT <id> <language> <options> PATH <image path>
+*	          DETECT <id> <language> <options> DATA <bytes count>\n<encoded image bytes>
+*	          PING | QUIT
+*	Response: REGION <id> <x> <y> <w> <h> <text>   (one line per accepted region)
+*	          DONE <id> OK <decode ms> <detect ms> <accepted regions count> [PARTIAL]
+*	          DONE <id> ERROR <message>
+*
+*	<options> is "-" or comma separated list of images=0|1, text=0|1 and deadline=<ms>.
+*	PARTIAL means that the deadline ran out and some regions were not verified.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef DETECTION_SERVICE_H
+#define DETECTION_SERVICE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include "textDetector.h"
+
+
+namespace protech
+{
+	/**
+	* \brief DetectionJob - One parsed service request.
+	*/
+	struct DetectionJob
+	{
+		std::string id;//!< Request id, echoed in responses.
+		std::string language;//!< Tesseract language code.
+		bool writeImages;//!< Write _masked and _rects images to output folder.
+		bool textRequested;//!< Return OCR text of accepted regions.
+		int deadlineMs;//!< Time budget for the image (0 means no budget).
+		std::string path;//!< Image path (empty when image is sent inline).
+		std::vector<uchar> data;//!< Encoded image bytes (empty when image is read from path).
+	};
+
+	class DetectionService
+	{
+	private:
+		std::string OUTPUT_FOLDER_PATH;//!< output folder path.
+		std::string DEFAULT_LANGUAGE;//!< Language used when request language is "-".
+		std::map<std::string, TextDetector*> m_detectors;//!< Preloaded detector per language code.
+		std::map<std::string, std::mutex*> m_detectorLocks;//!< Detector is used by one connection at a time.
+		std::mutex m_outputLock;//!< Serializes writes to a shared output stream.
+
+		int readJob(std::istream & in, const std::string & line, DetectionJob & job, std::string & error);
+		void runJob(DetectionJob & job, std::ostream & out);
+
+	public:
+		DetectionService(){};
+		~DetectionService();
+
+		bool initialize(std::string _OUTPUT_FOLDER_PATH, const std::vector<std::string> & languages);
+		void clear();
+
+		int serve(std::istream & in, std::ostream & out);
+		int serveStdio();
+		int serveLoopback(unsigned short port);
+	};
+
+	int runLoadGenerator(unsigned short port, const std::vector<std::string> & imagePaths, std::string language, int requestsCount, int connectionsCount, bool sendInline);
+}
+#endif
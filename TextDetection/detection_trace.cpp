@@ -0,0 +1,389 @@
+#include "detection_trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+
+namespace
+{
+	/**
+	* \brief RectLess - Orders rects by position, then size (trace comparison does not depend on pipeline order).
+	*/
+	struct RectLess
+	{
+		bool operator()(const cv::Rect & a, const cv::Rect & b) const
+		{
+			if (a.y != b.y) return a.y < b.y;
+			if (a.x != b.x) return a.x < b.x;
+			if (a.height != b.height) return a.height < b.height;
+			return a.width < b.width;
+		}
+	};
+
+	bool sameRect(const cv::Rect & a, const cv::Rect & b)
+	{
+		return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+	}
+
+	double intersectionOverUnion(const cv::Rect & a, const cv::Rect & b)
+	{
+		int intersection = (a & b).area();
+		int unionArea = a.area() + b.area() - intersection;
+		return (unionArea > 0) ? (double)intersection / unionArea : 0.0;
+	}
+
+	std::string rectString(const cv::Rect & rect)
+	{
+		std::ostringstream out;
+		out << "[" << rect.x << " " << rect.y << " " << rect.width << " " << rect.height << "]";
+		return out.str();
+	}
+
+	std::string escapeText(const std::string & text)
+	{
+		std::string result;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			switch (text[i])
+			{
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			default: result += text[i]; break;
+			}
+		}
+		return result;
+	}
+
+	std::string unescapeText(const std::string & text)
+	{
+		std::string result;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (text[i] == '\\' && i + 1 < text.size())
+			{
+				i++;
+				result += (text[i] == 'n') ? '\n' : (text[i] == 'r') ? '\r' : text[i];
+			}
+			else
+			{
+				result += text[i];
+			}
+		}
+		return result;
+	}
+
+	/**
+	* \brief matchRects - Method which pairs rects of golden and actual list.
+	*Exact matches are paired first; if iouThreshold > 0, remaining rects are paired greedily by best IoU >= threshold.
+	* \param [in] const std::vector<cv::Rect> & golden - golden rects.
+	* \param [in] const std::vector<cv::Rect> & actual - actual rects.
+	* \param [in] double iouThreshold - IoU threshold (0 for exact comparison only).
+	* \param [out] std::vector<int> & goldenMatch - index of paired actual rect (-1 if missing).
+	* \param [out] std::vector<int> & actualMatch - index of paired golden rect (-1 if extra).
+	*/
+	void matchRects(const std::vector<cv::Rect> & golden, const std::vector<cv::Rect> & actual, double iouThreshold, std::vector<int> & goldenMatch, std::vector<int> & actualMatch)
+	{
+		goldenMatch.assign(golden.size(), -1);
+		actualMatch.assign(actual.size(), -1);
+
+		for (size_t g = 0; g < golden.size(); g++)
+		{
+			for (size_t a = 0; a < actual.size(); a++)
+			{
+				if (actualMatch[a] < 0 && sameRect(golden[g], actual[a]))
+				{
+					goldenMatch[g] = (int)a;
+					actualMatch[a] = (int)g;
+					break;
+				}
+			}
+		}
+
+		if (iouThreshold <= 0.0)
+		{
+			return;
+		}
+
+		while (true)
+		{
+			double bestIou = iouThreshold;
+			int bestG = -1;
+			int bestA = -1;
+			for (size_t g = 0; g < golden.size(); g++)
+			{
+				if (goldenMatch[g] >= 0)
+					continue;
+				for (size_t a = 0; a < actual.size(); a++)
+				{
+					if (actualMatch[a] >= 0)
+						continue;
+					double iou = intersectionOverUnion(golden[g], actual[a]);
+					if (iou >= bestIou)
+					{
+						bestIou = iou;
+						bestG = (int)g;
+						bestA = (int)a;
+					}
+				}
+			}
+			if (bestG < 0)
+			{
+				break;
+			}
+			goldenMatch[bestG] = bestA;
+			actualMatch[bestA] = bestG;
+		}
+	}
+}
+
+
+/**
+* \brief stageName - Method which returns stage name used in golden files and reports.
+*/
+const char* protech::DetectionTrace::stageName(int stage)
+{
+	static const char* names[STAGES_COUNT] = { "contours_kept", "split", "valid", "rules", "super", "components" };
+	return names[stage];
+}
+
+
+/**
+* \brief clear - Method which removes all recorded outputs.
+*/
+void protech::DetectionTrace::clear()
+{
+	for (int s = 0; s < STAGES_COUNT; s++)
+	{
+		boxes[s].clear();
+	}
+	regions.clear();
+	missingReplays = 0;
+}
+
+
+/**
+* \brief findResponse - Method which finds recorded OCR response of region with given rect.
+* \param [in] const cv::Rect & rect - component rect.
+* \return const OcrResponse* - recorded response, NULL if region was not recorded.
+*/
+const protech::OcrResponse* protech::DetectionTrace::findResponse(const cv::Rect & rect) const
+{
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		if (sameRect(regions[i].rect, rect))
+		{
+			return &regions[i].response;
+		}
+	}
+	return NULL;
+}
+
+
+/**
+* \brief writeTrace - Method which writes trace as golden file.
+* \param [in] const std::string & path - golden file path.
+* \param [in] const DetectionTrace & trace - trace.
+* \return bool - false if file can not be written, otherwise true.
+*/
+bool protech::writeTrace(const std::string & path, const DetectionTrace & trace)
+{
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		return false;
+	}
+
+	out << "TRACE 1\n";
+	for (int s = 0; s < DetectionTrace::STAGES_COUNT; s++)
+	{
+		out << DetectionTrace::stageName(s) << " " << trace.boxes[s].size() << "\n";
+		for (size_t i = 0; i < trace.boxes[s].size(); i++)
+		{
+			const cv::Rect & rect = trace.boxes[s][i];
+			out << rect.x << " " << rect.y << " " << rect.width << " " << rect.height << "\n";
+		}
+	}
+
+	out << "regions " << trace.regions.size() << "\n";
+	for (size_t i = 0; i < trace.regions.size(); i++)
+	{
+		const TracedRegion & region = trace.regions[i];
+		out << region.rect.x << " " << region.rect.y << " " << region.rect.width << " " << region.rect.height << " "
+			<< region.response.layoutWords << " " << region.response.layoutLines << " " << (region.response.recognized ? 1 : 0) << " "
+			<< region.response.words << " " << region.response.lines << " " << (region.accepted ? 1 : 0) << " "
+			<< escapeText(region.response.text) << "\n";
+	}
+
+	return out.good();
+}
+
+
+/**
+* \brief readTrace - Method which reads golden file.
+* \param [in] const std::string & path - golden file path.
+* \param [out] DetectionTrace & trace - trace.
+* \return bool - false if file is missing or malformed, otherwise true.
+*/
+bool protech::readTrace(const std::string & path, DetectionTrace & trace)
+{
+	trace.clear();
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	std::string line;
+	if (!std::getline(in, line) || line != "TRACE 1")
+	{
+		return false;
+	}
+
+	for (int s = 0; s < DetectionTrace::STAGES_COUNT; s++)
+	{
+		std::string name;
+		size_t count = 0;
+		if (!std::getline(in, line))
+			return false;
+		std::istringstream header(line);
+		if (!(header >> name >> count) || name != DetectionTrace::stageName(s))
+			return false;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			cv::Rect rect;
+			if (!std::getline(in, line))
+				return false;
+			std::istringstream values(line);
+			if (!(values >> rect.x >> rect.y >> rect.width >> rect.height))
+				return false;
+			trace.boxes[s].push_back(rect);
+		}
+	}
+
+	std::string name;
+	size_t count = 0;
+	if (!std::getline(in, line))
+		return false;
+	std::istringstream header(line);
+	if (!(header >> name >> count) || name != "regions")
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		TracedRegion region;
+		int recognized = 0;
+		int accepted = 0;
+		if (!std::getline(in, line))
+			return false;
+		std::istringstream values(line);
+		if (!(values >> region.rect.x >> region.rect.y >> region.rect.width >> region.rect.height
+			>> region.response.layoutWords >> region.response.layoutLines >> recognized
+			>> region.response.words >> region.response.lines >> accepted))
+			return false;
+
+		std::string text;
+		std::getline(values, text);
+		if (!text.empty() && text[0] == ' ')
+			text.erase(0, 1);
+		region.response.text = unescapeText(text);
+		region.response.recognized = (recognized != 0);
+		region.accepted = (accepted != 0);
+		trace.regions.push_back(region);
+	}
+
+	return true;
+}
+
+
+/**
+* \brief compareTraces - Method which compares actual trace with golden trace and reports differences.
+*Rect lists are compared as sets. With iouThreshold > 0 rects which moved only slightly (IoU >= threshold)
+*are reported as shifted but not counted as differences.
+* \param [in] const DetectionTrace & golden - golden trace.
+* \param [in] const DetectionTrace & actual - actual trace.
+* \param [in] double iouThreshold - IoU threshold (0 for exact comparison).
+* \param [in] const std::string & name - image name used in report.
+* \param [in] std::ostream & report - report stream.
+* \return int - number of differences.
+*/
+int protech::compareTraces(const DetectionTrace & golden, const DetectionTrace & actual, double iouThreshold, const std::string & name, std::ostream & report)
+{
+	int differences = 0;
+	std::vector<int> goldenMatch;
+	std::vector<int> actualMatch;
+
+	for (int s = 0; s < DetectionTrace::STAGES_COUNT; s++)
+	{
+		std::vector<cv::Rect> goldenBoxes = golden.boxes[s];
+		std::vector<cv::Rect> actualBoxes = actual.boxes[s];
+		std::sort(goldenBoxes.begin(), goldenBoxes.end(), RectLess());
+		std::sort(actualBoxes.begin(), actualBoxes.end(), RectLess());
+
+		matchRects(goldenBoxes, actualBoxes, iouThreshold, goldenMatch, actualMatch);
+		for (size_t g = 0; g < goldenBoxes.size(); g++)
+		{
+			if (goldenMatch[g] < 0)
+			{
+				report << name << " " << DetectionTrace::stageName(s) << " missing " << rectString(goldenBoxes[g]) << "\n";
+				differences++;
+			}
+			else if (!sameRect(goldenBoxes[g], actualBoxes[goldenMatch[g]]))
+			{
+				report << name << " " << DetectionTrace::stageName(s) << " shifted " << rectString(goldenBoxes[g]) << " -> " << rectString(actualBoxes[goldenMatch[g]]) << "\n";
+			}
+		}
+		for (size_t a = 0; a < actualBoxes.size(); a++)
+		{
+			if (actualMatch[a] < 0)
+			{
+				report << name << " " << DetectionTrace::stageName(s) << " extra " << rectString(actualBoxes[a]) << "\n";
+				differences++;
+			}
+		}
+	}
+
+	std::vector<cv::Rect> goldenRects;
+	std::vector<cv::Rect> actualRects;
+	for (size_t i = 0; i < golden.regions.size(); i++)
+		goldenRects.push_back(golden.regions[i].rect);
+	for (size_t i = 0; i < actual.regions.size(); i++)
+		actualRects.push_back(actual.regions[i].rect);
+
+	matchRects(goldenRects, actualRects, iouThreshold, goldenMatch, actualMatch);
+	for (size_t g = 0; g < golden.regions.size(); g++)
+	{
+		const TracedRegion & goldenRegion = golden.regions[g];
+		if (goldenMatch[g] < 0)
+		{
+			report << name << " ocr missing " << rectString(goldenRegion.rect) << (goldenRegion.accepted ? " accepted" : " rejected") << "\n";
+			differences++;
+			continue;
+		}
+
+		const TracedRegion & actualRegion = actual.regions[goldenMatch[g]];
+		if (goldenRegion.accepted != actualRegion.accepted)
+		{
+			report << name << " ocr verdict " << rectString(goldenRegion.rect) << (goldenRegion.accepted ? " accepted -> rejected" : " rejected -> accepted") << "\n";
+			differences++;
+		}
+		else if (goldenRegion.response.recognized && actualRegion.response.recognized && goldenRegion.response.text != actualRegion.response.text)
+		{
+			report << name << " ocr text " << rectString(goldenRegion.rect) << " \"" << escapeText(goldenRegion.response.text) << "\" -> \"" << escapeText(actualRegion.response.text) << "\"\n";
+			differences++;
+		}
+	}
+	for (size_t a = 0; a < actual.regions.size(); a++)
+	{
+		if (actualMatch[a] < 0)
+		{
+			report << name << " ocr extra " << rectString(actual.regions[a].rect) << (actual.regions[a].accepted ? " accepted" : " rejected") << "\n";
+			differences++;
+		}
+	}
+
+	if (actual.missingReplays > 0)
+	{
+		report << name << " ocr replay missing for " << actual.missingReplays << " regions (treated as rejected)\n";
+	}
+
+	return differences;
+}
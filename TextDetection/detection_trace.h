@@ -0,0 +1,68 @@
+/*!\file detection_trace.h
+*
+*	Header for DetectionTrace (stage by stage intermediate outputs of TextDetector) used in TextDetection project.
+*	Traces are stored as golden files and compared after changes of the detection pipeline;
+*	recorded OCR responses let the comparison run without Tesseract.
+*
+*	Golden file format (text):
+*	  TRACE 1
+*	  <stage> <count>          followed by <count> lines "x y w h"
+*	  regions <count>          followed by <count> lines
+*	  x y w h layoutWords layoutLines recognized words lines accepted text
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef DETECTION_TRACE_H
+#define DETECTION_TRACE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "textDetector.h"
+
+
+namespace protech
+{
+	/**
+	* \brief TracedRegion - OCR response and verdict of one component.
+	*/
+	struct TracedRegion
+	{
+		cv::Rect rect;//!< Component rect.
+		OcrResponse response;//!< Tesseract output (recorded or replayed).
+		bool accepted;//!< Region verdict.
+	};
+
+	/**
+	* \brief DetectionTrace - Intermediate outputs of one textDetectionFunction call.
+	*/
+	struct DetectionTrace
+	{
+		enum Stage
+		{
+			STAGE_CONTOURS_KEPT = 0,//!< Boxes of contours which passed contour filter.
+			STAGE_SPLIT,//!< Boxes after splitting multi-line boxes.
+			STAGE_VALID,//!< Boxes after validation.
+			STAGE_RULES,//!< Boxes after applyRules.
+			STAGE_SUPER,//!< Super boxes from applyRules.
+			STAGE_COMPONENTS,//!< Component rects from floodFillNewRects.
+			STAGES_COUNT
+		};
+
+		std::vector<cv::Rect> boxes[STAGES_COUNT];//!< Rects of every stage.
+		std::vector<TracedRegion> regions;//!< OCR verdicts in component order.
+		int missingReplays;//!< Regions without recorded OCR response (replay only).
+
+		DetectionTrace() : missingReplays(0){};
+
+		static const char* stageName(int stage);
+		void clear();
+		const OcrResponse* findResponse(const cv::Rect & rect) const;
+	};
+
+	bool writeTrace(const std::string & path, const DetectionTrace & trace);
+	bool readTrace(const std::string & path, DetectionTrace & trace);
+	int compareTraces(const DetectionTrace & golden, const DetectionTrace & actual, double iouThreshold, const std::string & name, std::ostream & report);
+}
+#endif
@@ -0,0 +1,366 @@
+#include "folder_watcher.h"
+#include "image_files.h"
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+/**
+* \brief FolderWatcher::FolderWatcher - constructor.
+* \param [in] std::string folder - watched folder.
+* \param [in] size_t maxPending - maximum files waiting for processing; watcher blocks when reached.
+* \param [in] int settleMs - quiet time (ms) after the last write event before file is handed over.
+* \param [in] int pollMs - poll period (ms) used when inotify is not available.
+* \param [in] bool processExisting - if true, files which exist at start are processed too.
+*/
+protech::FolderWatcher::FolderWatcher(std::string folder, size_t maxPending, int settleMs, int pollMs, bool processExisting)
+	: m_folder(folder), m_settleMs(settleMs), m_pollMs(pollMs), m_processExisting(processExisting), m_ready(maxPending), m_stop(false)
+{
+}
+
+
+/**
+* \brief FolderWatcher::~FolderWatcher - destructor.
+*/
+protech::FolderWatcher::~FolderWatcher()
+{
+	stop();
+}
+
+
+/**
+* \brief start - Method which starts watcher thread.
+*/
+void protech::FolderWatcher::start()
+{
+	m_stop = false;
+	m_thread = std::thread(&FolderWatcher::watchLoop, this);
+}
+
+
+/**
+* \brief stop - Method which stops watcher thread and wakes waiting consumers.
+*/
+void protech::FolderWatcher::stop()
+{
+	m_stop = true;
+	m_ready.close();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+
+/**
+* \brief next - Method which waits for next file ready for processing.
+* \param [out] WatchedFile & file - ready file.
+* \return bool - false if watcher is stopped, otherwise true.
+*/
+bool protech::FolderWatcher::next(WatchedFile & file)
+{
+	return m_ready.pop(file);
+}
+
+
+/**
+* \brief tryNext - Method which hands over next ready file without waiting.
+* \param [out] WatchedFile & file - ready file.
+* \return bool - false if no file is ready now, otherwise true.
+*/
+bool protech::FolderWatcher::tryNext(WatchedFile & file)
+{
+	return m_ready.tryPop(file);
+}
+
+
+/**
+* \brief watchLoop - Watcher thread: initial scan, then inotify or polling until stopped.
+*/
+void protech::FolderWatcher::watchLoop()
+{
+	rescan(true);
+
+	if (!watchInotify())
+	{
+		std::cout << "inotify is not available, polling " << m_folder << " every " << m_pollMs << " ms..." << std::endl;
+		watchPolling();
+	}
+
+	m_ready.close();
+}
+
+
+/**
+* \brief rescan - Method which scans whole folder for new or rewritten image files.
+*Used at start and after inotify queue overflow (events were lost while detection was behind).
+*Handed over files which are no longer in the folder are forgotten, so a long watch does not grow.
+* \param [in] bool initial - true for the scan at start.
+*/
+void protech::FolderWatcher::rescan(bool initial)
+{
+	namespace fs = boost::filesystem;
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+
+	try
+	{
+		std::set<std::string> present;
+		fs::directory_iterator end_iter;
+		for (fs::directory_iterator dir_iter(m_folder); dir_iter != end_iter; ++dir_iter)
+		{
+			if (!fs::is_regular_file(dir_iter->status()) || !hasImageExtension(dir_iter->path()))
+			{
+				continue;
+			}
+
+			std::string key = dir_iter->path().string();
+			std::time_t writeTime = fs::last_write_time(dir_iter->path());
+			present.insert(key);
+
+			if (initial && !m_processExisting)
+			{
+				m_done[key] = writeTime;
+				continue;
+			}
+
+			std::map<std::string, std::time_t>::iterator done = m_done.find(key);
+			if (done != m_done.end() && done->second == writeTime)
+			{
+				continue;
+			}
+			if (m_pending.find(key) == m_pending.end())
+			{
+				touch(dir_iter->path(), now);
+			}
+		}
+
+		for (std::map<std::string, std::time_t>::iterator done = m_done.begin(); done != m_done.end();)
+		{
+			if (present.count(done->first) == 0)
+				m_done.erase(done++);
+			else
+				++done;
+		}
+	}
+	catch (fs::filesystem_error & ex)
+	{
+		std::cout << "Exception: " << ex.what() << std::endl;
+	}
+}
+
+
+/**
+* \brief touch - Method which (re)starts settle time of a file after write event.
+* \param [in] const boost::filesystem::path & path - file path.
+* \param [in] boost::posix_time::ptime now - event time.
+*/
+void protech::FolderWatcher::touch(const boost::filesystem::path & path, boost::posix_time::ptime now)
+{
+	boost::system::error_code ec;
+	boost::uintmax_t size = boost::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		return;
+	}
+
+	std::string key = path.string();
+	std::map<std::string, PendingFile>::iterator it = m_pending.find(key);
+	if (it == m_pending.end())
+	{
+		PendingFile pending;
+		pending.firstSeen = now;
+		pending.lastEvent = now;
+		pending.size = size;
+		m_pending[key] = pending;
+	}
+	else
+	{
+		it->second.lastEvent = now;
+		it->second.size = size;
+	}
+}
+
+
+/**
+* \brief handOverSettled - Method which moves settled files (quiet for settle time, size unchanged) to ready queue.
+*Blocks while ready queue is full, so detection which falls behind slows down the watcher.
+* \param [in] boost::posix_time::ptime now - current time.
+*/
+void protech::FolderWatcher::handOverSettled(boost::posix_time::ptime now)
+{
+	std::map<std::string, PendingFile>::iterator it = m_pending.begin();
+	while (it != m_pending.end() && !m_stop)
+	{
+		if ((now - it->second.lastEvent).total_milliseconds() < m_settleMs)
+		{
+			++it;
+			continue;
+		}
+
+		boost::filesystem::path path(it->first);
+		boost::system::error_code ec;
+		boost::uintmax_t size = boost::filesystem::file_size(path, ec);
+		if (ec)
+		{
+			// file is removed or renamed before it settled
+			m_pending.erase(it++);
+			continue;
+		}
+		if (size != it->second.size)
+		{
+			it->second.size = size;
+			it->second.lastEvent = now;
+			++it;
+			continue;
+		}
+
+		WatchedFile file;
+		file.path = path;
+		file.arrival = it->second.firstSeen;
+		m_done[it->first] = boost::filesystem::last_write_time(path, ec);
+		m_pending.erase(it++);
+
+		if (!m_ready.push(file))
+		{
+			return;
+		}
+	}
+}
+
+
+/**
+* \brief nextTimeoutMs - Method which computes how long to wait for events before next settle check.
+* \param [in] boost::posix_time::ptime now - current time.
+* \return int - wait time in milliseconds.
+*/
+int protech::FolderWatcher::nextTimeoutMs(boost::posix_time::ptime now)
+{
+	int timeoutMs = 1000;
+	std::map<std::string, PendingFile>::iterator it;
+	for (it = m_pending.begin(); it != m_pending.end(); ++it)
+	{
+		int remaining = m_settleMs - (int)(now - it->second.lastEvent).total_milliseconds();
+		if (remaining < timeoutMs)
+		{
+			timeoutMs = remaining;
+		}
+	}
+	return (timeoutMs < 10) ? 10 : timeoutMs;
+}
+
+
+/**
+* \brief watchInotify - Method which waits for IN_CLOSE_WRITE / IN_MOVED_TO events until stopped.
+*IN_DELETE / IN_MOVED_FROM events forget handed over files.
+* \return bool - false if inotify is not available (not Linux or watch can not be added), otherwise true.
+*/
+bool protech::FolderWatcher::watchInotify()
+{
+#ifdef __linux__
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (inotify_add_watch(fd, m_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// files written between initial scan and adding the watch
+	rescan(false);
+
+	std::vector<char> buffer(64 * 1024);
+	bool watching = true;
+	while (watching && !m_stop)
+	{
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		int rc = poll(&pfd, 1, nextTimeoutMs(boost::posix_time::microsec_clock::local_time()));
+		if (rc < 0 && errno != EINTR)
+		{
+			break;
+		}
+
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+		if (rc > 0 && (pfd.revents & POLLIN))
+		{
+			ssize_t length;
+			while ((length = read(fd, &buffer[0], buffer.size())) > 0)
+			{
+				char* ptr = &buffer[0];
+				while (ptr < &buffer[0] + length)
+				{
+					const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+					if (event->mask & IN_Q_OVERFLOW)
+					{
+						rescan(false);
+					}
+					else if (event->mask & IN_IGNORED)
+					{
+						std::cout << "Watched folder " << m_folder << " is removed..." << std::endl;
+						watching = false;
+					}
+					else if (event->len > 0)
+					{
+						boost::filesystem::path path = boost::filesystem::path(m_folder) / event->name;
+						if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+						{
+							m_done.erase(path.string());
+						}
+						else if (hasImageExtension(path))
+						{
+							touch(path, now);
+						}
+					}
+					ptr += sizeof(struct inotify_event) + event->len;
+				}
+			}
+		}
+
+		handOverSettled(now);
+	}
+
+	close(fd);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+* \brief watchPolling - Method which periodically rescans the folder until stopped (fallback for inotify).
+*/
+void protech::FolderWatcher::watchPolling()
+{
+	while (!m_stop)
+	{
+		rescan(false);
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+		handOverSettled(now);
+
+		int waitMs = m_pollMs;
+		if (!m_pending.empty() && nextTimeoutMs(now) < waitMs)
+		{
+			waitMs = nextTimeoutMs(now);
+		}
+		for (int slept = 0; slept < waitMs && !m_stop; slept += 50)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+}
@@ -0,0 +1,78 @@
+/*!\file folder_watcher.h
+*
+*	Header for FolderWatcher (watch-folder ingestion) used in TextDetection project.
+*	On Linux new files are reported by inotify (IN_CLOSE_WRITE / IN_MOVED_TO), elsewhere
+*	the folder is polled. A file is handed over only after it was quiet for the settle time
+*	and its size did not change, so partially written files are not processed.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef FOLDER_WATCHER_H
+#define FOLDER_WATCHER_H
+
+#include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "blocking_queue.h"
+
+
+namespace protech
+{
+	/**
+	* \brief WatchedFile - File which is ready for processing.
+	*/
+	struct WatchedFile
+	{
+		boost::filesystem::path path;//!< File path.
+		boost::posix_time::ptime arrival;//!< Time of the last write event (or first poll that saw the file).
+	};
+
+	class FolderWatcher
+	{
+	private:
+		/**
+		* \brief PendingFile - File which was written recently and waits for settle time.
+		*/
+		struct PendingFile
+		{
+			boost::posix_time::ptime firstSeen;//!< First event time.
+			boost::posix_time::ptime lastEvent;//!< Last event (or size change) time.
+			boost::uintmax_t size;//!< File size at last event.
+		};
+
+		std::string m_folder;//!< Watched folder.
+		int m_settleMs;//!< Quiet time before file is handed over.
+		int m_pollMs;//!< Poll period for polling fallback.
+		bool m_processExisting;//!< Hand over files which already exist at start.
+
+		BlockingQueue<WatchedFile> m_ready;//!< Files ready for processing (bounded, gives backpressure).
+		std::map<std::string, PendingFile> m_pending;//!< Files waiting for settle time.
+		std::map<std::string, std::time_t> m_done;//!< Handed over files still in the folder and their write time, used on rescan.
+
+		std::thread m_thread;
+		std::atomic<bool> m_stop;
+
+		void watchLoop();
+		bool watchInotify();
+		void watchPolling();
+		void rescan(bool initial);
+		void touch(const boost::filesystem::path & path, boost::posix_time::ptime now);
+		void handOverSettled(boost::posix_time::ptime now);
+		int nextTimeoutMs(boost::posix_time::ptime now);
+
+	public:
+		FolderWatcher(std::string folder, size_t maxPending, int settleMs, int pollMs, bool processExisting);
+		~FolderWatcher();
+
+		void start();
+		void stop();
+		bool next(WatchedFile & file);
+		bool tryNext(WatchedFile & file);
+	};
+}
+#endif
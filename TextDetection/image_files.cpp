@@ -0,0 +1,391 @@
+#include "image_files.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+
+/**
+* \brief hasImageExtension - Method which checks whether file has one of supported image extensions (.jpg, .jpeg, .png and .bmp).
+* \param [in] const boost::filesystem::path & path - file path.
+* \return bool - true if extension is supported (case insensitive), otherwise false.
+*/
+bool protech::hasImageExtension(const boost::filesystem::path & path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::toupper);
+
+	return (extension == ".JPG") || (extension == ".JPEG") || (extension == ".PNG") || (extension == ".BMP");
+}
+
+
+namespace
+{
+	/**
+	* \brief naturalCompare - Method which compares two names in "natural ordering" without allocation.
+	*Digit runs are compared by numeric value (leading zeros ignored, any length), other characters case insensitive.
+	* \param [in] const char * a - first name.
+	* \param [in] size_t aLength - first name length.
+	* \param [in] const char * b - second name.
+	* \param [in] size_t bLength - second name length.
+	* \return int - negative if a is before b, positive if b is before a, 0 if names differ only in case or leading zeros.
+	*/
+	int naturalCompare(const char * a, size_t aLength, const char * b, size_t bLength)
+	{
+		size_t i = 0;
+		size_t j = 0;
+		while (i < aLength && j < bLength)
+		{
+			unsigned char ca = (unsigned char)a[i];
+			unsigned char cb = (unsigned char)b[j];
+			bool digitA = (std::isdigit(ca) != 0);
+			bool digitB = (std::isdigit(cb) != 0);
+
+			if (digitA && !digitB)
+				return -1;
+			if (!digitA && digitB)
+				return 1;
+			if (!digitA && !digitB)
+			{
+				// characters which differ only in case do not decide, scanning continues
+				int ua = std::toupper(ca);
+				int ub = std::toupper(cb);
+				if (ua != ub)
+					return ua < ub ? -1 : 1;
+				i++;
+				j++;
+				continue;
+			}
+
+			// Both names continue with digit --> compare numbers by value
+			while (i < aLength && a[i] == '0')
+				i++;
+			while (j < bLength && b[j] == '0')
+				j++;
+			size_t startA = i;
+			size_t startB = j;
+			while (i < aLength && std::isdigit((unsigned char)a[i]))
+				i++;
+			while (j < bLength && std::isdigit((unsigned char)b[j]))
+				j++;
+
+			size_t digitsA = i - startA;
+			size_t digitsB = j - startB;
+			if (digitsA != digitsB)
+				return digitsA < digitsB ? -1 : 1;
+			for (size_t k = 0; k < digitsA; k++)
+			{
+				if (a[startA + k] != b[startB + k])
+					return a[startA + k] < b[startB + k] ? -1 : 1;
+			}
+			// Numbers are the same --> continue after them
+		}
+
+		if (i == aLength)
+			return (j == bLength) ? 0 : -1;
+		return 1;
+	}
+}
+
+
+/**
+* \brief naturalLess - Method which compares two names in "natural ordering" without allocation.
+*Digit runs are compared by numeric value (leading zeros ignored, any length), other characters case insensitive.
+*Names equal in that order ("IMG_01.jpg" / "img_1.JPG") are ordered by their bytes, so the order is total and
+*a strict weak ordering for std::sort, heaps and merges.
+* \param [in] const char * a - first name.
+* \param [in] size_t aLength - first name length.
+* \param [in] const char * b - second name.
+* \param [in] size_t bLength - second name length.
+* \return bool - true, if a is before b, otherwise false.
+*/
+bool protech::naturalLess(const char * a, size_t aLength, const char * b, size_t bLength)
+{
+	int order = naturalCompare(a, aLength, b, bLength);
+	if (order != 0)
+		return order < 0;
+
+	// deterministic tiebreak: case sensitive byte order, then length
+	size_t length = aLength < bLength ? aLength : bLength;
+	int bytes = (length > 0) ? std::memcmp(a, b, length) : 0;
+	if (bytes != 0)
+		return bytes < 0;
+	return aLength < bLength;
+}
+
+
+/**
+* \brief naturalLess - Method which compares two names in "natural ordering" without allocation.
+* \param [in] const std::string & a - first name.
+* \param [in] const std::string & b - second name.
+* \return bool - true, if a is before b, otherwise false.
+*/
+bool protech::naturalLess(const std::string & a, const std::string & b)
+{
+	return naturalLess(a.data(), a.size(), b.data(), b.size());
+}
+
+
+/**
+* \brief DirectoryImageStream::DirectoryImageStream - constructor.
+* \param [in] std::string dirPath - Path to the folder with images.
+* \param [in] size_t orderWindow - ORDER_NONE (directory order), ORDER_FULL (exact natural order) or
+*size of reorder window: at most this many names are kept, the smallest one is handed over when window is full.
+*Result is exactly ordered when folder has no more images than window size.
+*/
+protech::DirectoryImageStream::DirectoryImageStream(std::string dirPath, size_t orderWindow)
+	: m_orderWindow(orderWindow), m_sortedPos(0), m_sortedReady(false)
+{
+	namespace fs = boost::filesystem;
+	fs::path someDir(dirPath);
+	if (fs::exists(someDir) && fs::is_directory(someDir))
+	{
+		m_iter = fs::directory_iterator(someDir);
+	}
+}
+
+
+/**
+* \brief readEntry - Method which reads next image from directory.
+* \param [out] Entry & entry - next image.
+* \return bool - false when directory is exhausted, otherwise true.
+*/
+bool protech::DirectoryImageStream::readEntry(Entry & entry)
+{
+	namespace fs = boost::filesystem;
+	fs::directory_iterator end_iter;
+	for (; m_iter != end_iter; ++m_iter)
+	{
+		if (fs::is_regular_file(m_iter->status()) && hasImageExtension(m_iter->path()))
+		{
+			entry.path = m_iter->path();
+			entry.name = entry.path.filename().string();
+			++m_iter;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+* \brief next - Method which hands over next image.
+* \param [out] boost::filesystem::path & path - image path.
+* \return bool - false when there are no more images, otherwise true.
+*/
+bool protech::DirectoryImageStream::next(boost::filesystem::path & path)
+{
+	Entry entry;
+
+	if (m_orderWindow == ORDER_NONE)
+	{
+		if (!readEntry(entry))
+			return false;
+		path = entry.path;
+		return true;
+	}
+
+	if (m_orderWindow == ORDER_FULL)
+	{
+		if (!m_sortedReady)
+		{
+			while (readEntry(entry))
+			{
+				m_sorted.push_back(entry);
+			}
+			std::sort(m_sorted.begin(), m_sorted.end(), EntryLess());
+			m_sortedReady = true;
+		}
+		if (m_sortedPos >= m_sorted.size())
+			return false;
+		path = m_sorted[m_sortedPos++].path;
+		return true;
+	}
+
+	while (m_window.size() < m_orderWindow && readEntry(entry))
+	{
+		m_window.push(entry);
+	}
+	if (m_window.empty())
+		return false;
+	path = m_window.top().path;
+	m_window.pop();
+	return true;
+}
+
+
+namespace
+{
+	/**
+	* \brief legacyCompareNat - Previous recursive comparator, kept as reference for benchmarkNaturalOrder.
+	*/
+	bool legacyCompareNat(const std::string & a, const std::string & b)
+	{
+		if (a.empty())
+			return true;
+		if (b.empty())
+			return false;
+		if (std::isdigit(a[0]) && !std::isdigit(b[0]))
+			return true;
+		if (!std::isdigit(a[0]) && std::isdigit(b[0]))
+			return false;
+		if (!std::isdigit(a[0]) && !std::isdigit(b[0]))
+		{
+			if (a[0] == b[0])
+				return legacyCompareNat(a.substr(1), b.substr(1));
+			return (std::toupper(a[0]) < std::toupper(b[0]));
+		}
+
+		std::istringstream issa(a);
+		std::istringstream issb(b);
+		int ia, ib;
+		issa >> ia;
+		issb >> ib;
+		if (ia != ib)
+			return ia < ib;
+
+		std::string anew, bnew;
+		std::getline(issa, anew);
+		std::getline(issb, bnew);
+		return (legacyCompareNat(anew, bnew));
+	}
+
+	/**
+	* \brief checkStrictWeakOrder - Method which checks naturalLess on all triples of short mixed-case names.
+	* \return int - 0 if naturalLess is a strict weak ordering of the names, otherwise -1.
+	*/
+	int checkStrictWeakOrder()
+	{
+		const char alphabet[] = "aAbB0019_";
+		std::mt19937 generator(54321);
+		std::vector<std::string> names;
+		for (size_t n = 0; n < 160; n++)
+		{
+			std::string name;
+			size_t length = 1 + generator() % 4;
+			for (size_t k = 0; k < length; k++)
+			{
+				name += alphabet[generator() % (sizeof(alphabet) - 1)];
+			}
+			names.push_back(name);
+		}
+
+		size_t count = names.size();
+		std::vector<unsigned char> less(count * count);
+		for (size_t x = 0; x < count; x++)
+		{
+			for (size_t y = 0; y < count; y++)
+			{
+				less[x * count + y] = protech::naturalLess(names[x], names[y]) ? 1 : 0;
+			}
+		}
+
+		for (size_t x = 0; x < count; x++)
+		{
+			if (less[x * count + x])
+			{
+				std::cout << "Not irreflexive: " << names[x] << std::endl;
+				return -1;
+			}
+			for (size_t y = 0; y < count; y++)
+			{
+				if (less[x * count + y] && less[y * count + x])
+				{
+					std::cout << "Not asymmetric: " << names[x] << " / " << names[y] << std::endl;
+					return -1;
+				}
+				for (size_t z = 0; z < count; z++)
+				{
+					bool xy = less[x * count + y] != 0;
+					bool yz = less[y * count + z] != 0;
+					bool xz = less[x * count + z] != 0;
+					bool equivalentXY = !xy && !less[y * count + x];
+					bool equivalentYZ = !yz && !less[z * count + y];
+					bool equivalentXZ = !xz && !less[z * count + x];
+					if ((xy && yz && !xz) || (equivalentXY && equivalentYZ && !equivalentXZ))
+					{
+						std::cout << "Not transitive: " << names[x] << " / " << names[y] << " / " << names[z] << std::endl;
+						return -1;
+					}
+				}
+			}
+		}
+		std::cout << "naturalLess: strict weak ordering of " << count << " mixed-case names checked" << std::endl;
+		return 0;
+	}
+}
+
+
+/**
+* \brief benchmarkNaturalOrder - Method which measures sorting of synthetic scanner file names.
+*New comparator sorts all names, legacy comparator sorts first legacyCount names and both orders are cross-checked.
+*Strict weak ordering (irreflexivity, asymmetry, transitivity of order and of equivalence) is checked on all
+*triples of short mixed-case names.
+* \param [in] size_t namesCount - names count (e.g. 1000000).
+* \param [in] size_t legacyCount - names count sorted with legacy comparator (0 to skip).
+* \return int - 0 if orders agree and ordering is strict weak, otherwise -1.
+*/
+int protech::benchmarkNaturalOrder(size_t namesCount, size_t legacyCount)
+{
+	int status = checkStrictWeakOrder();
+
+	const char * prefixes[] = { "IMG_", "scan_", "Scan ", "DSC", "page-", "" };
+	const char * extensions[] = { ".jpg", ".JPG", ".png", ".bmp", ".jpeg" };
+
+	std::mt19937 generator(12345);
+	std::vector<std::string> names;
+	names.reserve(namesCount);
+	for (size_t i = 0; i < namesCount; i++)
+	{
+		std::ostringstream name;
+		name << prefixes[generator() % 6] << (generator() % 500);
+		if (generator() % 2)
+			name << "_" << std::setw(4) << std::setfill('0') << (generator() % 10000);
+		name << extensions[generator() % 5];
+		names.push_back(name.str());
+	}
+
+	std::vector<std::string> sorted(names);
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	std::sort(sorted.begin(), sorted.end(), static_cast<bool(*)(const std::string &, const std::string &)>(naturalLess));
+	boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+	std::cout << "naturalLess: " << namesCount << " names sorted in " << (end - start).total_milliseconds() << " ms" << std::endl;
+
+	if (legacyCount > 0)
+	{
+		if (legacyCount > namesCount)
+			legacyCount = namesCount;
+		std::vector<std::string> legacy(names.begin(), names.begin() + legacyCount);
+		std::vector<std::string> current(legacy);
+
+		start = boost::posix_time::microsec_clock::local_time();
+		std::stable_sort(legacy.begin(), legacy.end(), legacyCompareNat);
+		end = boost::posix_time::microsec_clock::local_time();
+		std::cout << "legacy compareNat: " << legacyCount << " names sorted in " << (end - start).total_milliseconds() << " ms" << std::endl;
+
+		start = boost::posix_time::microsec_clock::local_time();
+		std::stable_sort(current.begin(), current.end(), static_cast<bool(*)(const std::string &, const std::string &)>(naturalLess));
+		end = boost::posix_time::microsec_clock::local_time();
+		std::cout << "naturalLess: " << legacyCount << " names sorted in " << (end - start).total_milliseconds() << " ms" << std::endl;
+
+		// names equal by value (e.g. "a01" and "a1") may keep any relative order; legacy comparator also
+		// stops at the first case-only difference ("4.JPG" / "4.jpeg"), such pairs are not compared
+		for (size_t i = 1; i < legacy.size(); i++)
+		{
+			if (legacyCompareNat(legacy[i - 1], legacy[i]) && naturalCompare(legacy[i].data(), legacy[i].size(), legacy[i - 1].data(), legacy[i - 1].size()) < 0)
+			{
+				std::cout << "Order differs at " << i << ": " << legacy[i - 1] << " / " << legacy[i] << std::endl;
+				status = -1;
+				break;
+			}
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,81 @@
+/*!\file image_files.h
+*
+*	Helpers for finding input images used in TextDetection project.
+*	DirectoryImageStream hands over images while the folder is still being enumerated;
+*	ordering is optional and its memory can be bounded by a reorder window.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef IMAGE_FILES_H
+#define IMAGE_FILES_H
+
+#include <string>
+#include <vector>
+#include <queue>
+
+#include <boost/filesystem.hpp>
+
+
+namespace protech
+{
+	bool hasImageExtension(const boost::filesystem::path & path);
+
+	bool naturalLess(const char * a, size_t aLength, const char * b, size_t bLength);
+	bool naturalLess(const std::string & a, const std::string & b);
+
+	int benchmarkNaturalOrder(size_t namesCount, size_t legacyCount);
+
+	class DirectoryImageStream
+	{
+	public:
+		static const size_t ORDER_NONE = 0;//!< Directory order, first image is available immediately.
+		static const size_t ORDER_FULL = (size_t)-1;//!< Exact natural order, whole folder is enumerated first.
+
+	private:
+		/**
+		* \brief Entry - Enumerated image (file name is kept for comparison without allocation).
+		*/
+		struct Entry
+		{
+			std::string name;//!< File name.
+			boost::filesystem::path path;//!< Full path.
+		};
+
+		/**
+		* \brief EntryLess - Natural order of entries.
+		*/
+		struct EntryLess
+		{
+			bool operator()(const Entry & a, const Entry & b) const
+			{
+				return naturalLess(a.name, b.name);
+			}
+		};
+
+		/**
+		* \brief EntryGreater - Heap ordering, smallest natural name on top.
+		*/
+		struct EntryGreater
+		{
+			bool operator()(const Entry & a, const Entry & b) const
+			{
+				return naturalLess(b.name, a.name);
+			}
+		};
+
+		size_t m_orderWindow;//!< ORDER_NONE, ORDER_FULL or reorder window size.
+		boost::filesystem::directory_iterator m_iter;//!< Current directory position.
+		std::priority_queue<Entry, std::vector<Entry>, EntryGreater> m_window;//!< Reorder window.
+		std::vector<Entry> m_sorted;//!< All entries in ORDER_FULL mode.
+		size_t m_sortedPos;//!< Next entry in m_sorted.
+		bool m_sortedReady;//!< m_sorted is filled and sorted.
+
+		bool readEntry(Entry & entry);
+
+	public:
+		DirectoryImageStream(std::string dirPath, size_t orderWindow);
+
+		bool next(boost::filesystem::path & path);
+	};
+}
+#endif
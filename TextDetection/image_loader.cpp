@@ -0,0 +1,512 @@
+#include "image_loader.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#ifdef TEXTDETECTION_USE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+
+namespace
+{
+	/**
+	* \brief readBigEndian16 - Method which reads 16-bit big endian value.
+	*/
+	int readBigEndian16(const uchar * p)
+	{
+		return (p[0] << 8) | p[1];
+	}
+
+	/**
+	* \brief readBigEndian32 - Method which reads 32-bit big endian value.
+	*/
+	int readBigEndian32(const uchar * p)
+	{
+		return (int)(((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | (unsigned)p[3]);
+	}
+
+	/**
+	* \brief readLittleEndian32 - Method which reads 32-bit little endian value.
+	*/
+	int readLittleEndian32(const uchar * p)
+	{
+		return (int)((unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24));
+	}
+
+	/**
+	* \brief readTiff16 - Method which reads 16-bit value in byte order of TIFF header.
+	*/
+	int readTiff16(const uchar * p, bool bigEndian)
+	{
+		return bigEndian ? readBigEndian16(p) : (p[0] | (p[1] << 8));
+	}
+
+	/**
+	* \brief readTiff32 - Method which reads 32-bit value in byte order of TIFF header.
+	*/
+	int readTiff32(const uchar * p, bool bigEndian)
+	{
+		return bigEndian ? readBigEndian32(p) : readLittleEndian32(p);
+	}
+
+	/**
+	* \brief exifOrientation - Method which reads orientation tag (0x0112) from IFD0 of Exif APP1 segment.
+	* \param [in] const uchar * segment - segment data after its length field.
+	* \param [in] size_t size - segment data size.
+	* \return int - orientation 1..8, 1 if tag is missing or invalid.
+	*/
+	int exifOrientation(const uchar * segment, size_t size)
+	{
+		if (size < 14 || segment[0] != 'E' || segment[1] != 'x' || segment[2] != 'i' || segment[3] != 'f' || segment[4] != 0 || segment[5] != 0)
+		{
+			return 1;
+		}
+		const uchar * tiff = segment + 6;
+		size_t tiffSize = size - 6;
+		bool bigEndian = (tiff[0] == 'M' && tiff[1] == 'M');
+		if (!bigEndian && !(tiff[0] == 'I' && tiff[1] == 'I'))
+		{
+			return 1;
+		}
+
+		int ifd = readTiff32(tiff + 4, bigEndian);
+		if (ifd < 8 || (size_t)ifd + 2 > tiffSize)
+		{
+			return 1;
+		}
+		int entries = readTiff16(tiff + ifd, bigEndian);
+		for (int e = 0; e < entries; e++)
+		{
+			size_t entry = (size_t)ifd + 2 + 12 * (size_t)e;
+			if (entry + 12 > tiffSize)
+				break;
+			if (readTiff16(tiff + entry, bigEndian) == 0x0112)
+			{
+				int orientation = readTiff16(tiff + entry + 8, bigEndian);
+				return (orientation >= 1 && orientation <= 8) ? orientation : 1;
+			}
+		}
+		return 1;
+	}
+
+#ifdef TEXTDETECTION_USE_LIBJPEG
+	/**
+	* \brief JpegErrorManager - libjpeg error handler which returns to decodeJpegScaled instead of exiting.
+	*/
+	struct JpegErrorManager
+	{
+		struct jpeg_error_mgr pub;
+		jmp_buf jump;
+	};
+
+	void jpegErrorExit(j_common_ptr cinfo)
+	{
+		JpegErrorManager * manager = reinterpret_cast<JpegErrorManager *>(cinfo->err);
+		longjmp(manager->jump, 1);
+	}
+
+	/**
+	* \brief decodeJpegScaled - Method which decodes JPEG with libjpeg DCT scaling 1/factor.
+	* \param [in] const uchar * data - encoded JPEG.
+	* \param [in] size_t size - encoded size.
+	* \param [in] int factor - 1, 2, 4 or 8.
+	* \param [in] bool grayscale - decode to one channel.
+	* \return cv::Mat - decoded image (BGR or gray), empty on failure.
+	*/
+	cv::Mat decodeJpegScaled(const uchar * data, size_t size, int factor, bool grayscale)
+	{
+		struct jpeg_decompress_struct cinfo;
+		JpegErrorManager error;
+		cv::Mat image;
+
+		cinfo.err = jpeg_std_error(&error.pub);
+		error.pub.error_exit = jpegErrorExit;
+		if (setjmp(error.jump))
+		{
+			jpeg_destroy_decompress(&cinfo);
+			return cv::Mat();
+		}
+
+		jpeg_create_decompress(&cinfo);
+		jpeg_mem_src(&cinfo, const_cast<uchar *>(data), (unsigned long)size);
+		jpeg_read_header(&cinfo, TRUE);
+
+		if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK)
+		{
+			// leave CMYK conversion to OpenCV
+			jpeg_destroy_decompress(&cinfo);
+			return cv::Mat();
+		}
+
+		cinfo.scale_num = 1;
+		cinfo.scale_denom = factor;
+		cinfo.out_color_space = grayscale ? JCS_GRAYSCALE : JCS_RGB;
+		jpeg_start_decompress(&cinfo);
+
+		image.create(cinfo.output_height, cinfo.output_width, grayscale ? CV_8UC1 : CV_8UC3);
+		while (cinfo.output_scanline < cinfo.output_height)
+		{
+			JSAMPROW row = image.ptr(cinfo.output_scanline);
+			jpeg_read_scanlines(&cinfo, &row, 1);
+		}
+
+		jpeg_finish_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+
+		if (!grayscale)
+		{
+			cv::cvtColor(image, image, CV_RGB2BGR);
+		}
+		return image;
+	}
+#endif
+}
+
+
+/**
+* \brief readImageSize - Method which reads image size from JPEG, PNG or BMP header without decoding.
+* \param [in] const uchar * data - encoded image.
+* \param [in] size_t size - encoded size.
+* \param [out] int & width - image width.
+* \param [out] int & height - image height.
+* \param [out] bool & isJpeg - true for JPEG image.
+* \return bool - true if size is found, otherwise false.
+*/
+bool protech::readImageSize(const uchar * data, size_t size, int & width, int & height, bool & isJpeg)
+{
+	isJpeg = false;
+
+	// PNG: signature + IHDR chunk
+	if (size >= 24 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G')
+	{
+		width = readBigEndian32(data + 16);
+		height = readBigEndian32(data + 20);
+		return true;
+	}
+
+	// BMP: BITMAPINFOHEADER (height is negative for top-down bitmaps)
+	if (size >= 26 && data[0] == 'B' && data[1] == 'M')
+	{
+		width = readLittleEndian32(data + 18);
+		height = readLittleEndian32(data + 22);
+		if (height < 0)
+			height = -height;
+		return true;
+	}
+
+	// JPEG: walk markers until start of frame
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+	{
+		return false;
+	}
+	isJpeg = true;
+
+	size_t pos = 2;
+	while (pos + 4 <= size)
+	{
+		if (data[pos] != 0xFF)
+		{
+			return false;
+		}
+		uchar marker = data[pos + 1];
+		if (marker == 0xFF)
+		{
+			// fill byte
+			pos++;
+			continue;
+		}
+		if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+		{
+			// markers without length
+			pos += 2;
+			continue;
+		}
+
+		int length = readBigEndian16(data + pos + 2);
+		bool startOfFrame = (marker >= 0xC0 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+		if (startOfFrame)
+		{
+			if (pos + 9 > size)
+				return false;
+			height = readBigEndian16(data + pos + 5);
+			width = readBigEndian16(data + pos + 7);
+			return (width > 0 && height > 0);
+		}
+		if (marker == 0xD9 || marker == 0xDA || length < 2)
+		{
+			// end of image or start of scan before any frame header
+			return false;
+		}
+		pos += 2 + length;
+	}
+
+	return false;
+}
+
+
+/**
+* \brief readJpegOrientation - Method which reads Exif orientation of JPEG image without decoding.
+* \param [in] const uchar * data - encoded image.
+* \param [in] size_t size - encoded size.
+* \return int - Exif orientation 1..8 (5..8 mean the image is shown transposed), 1 if there is none.
+*/
+int protech::readJpegOrientation(const uchar * data, size_t size)
+{
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+	{
+		return 1;
+	}
+
+	size_t pos = 2;
+	while (pos + 4 <= size)
+	{
+		if (data[pos] != 0xFF)
+		{
+			return 1;
+		}
+		uchar marker = data[pos + 1];
+		if (marker == 0xFF)
+		{
+			pos++;
+			continue;
+		}
+		if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+		{
+			pos += 2;
+			continue;
+		}
+		if (marker == 0xD9 || marker == 0xDA)
+		{
+			return 1;
+		}
+
+		int length = readBigEndian16(data + pos + 2);
+		if (length < 2 || pos + 2 + length > size)
+		{
+			return 1;
+		}
+		if (marker == 0xE1)
+		{
+			int orientation = exifOrientation(data + pos + 4, length - 2);
+			if (orientation != 1)
+				return orientation;
+		}
+		pos += 2 + length;
+	}
+	return 1;
+}
+
+
+/**
+* \brief reducedDecodeAvailable - Method which tells whether this build decodes JPEGs at reduced size.
+* \return bool - true with OpenCV 3.2+ or TEXTDETECTION_USE_LIBJPEG, otherwise false (every image is decoded at full size).
+*/
+bool protech::reducedDecodeAvailable()
+{
+#if (CV_MAJOR_VERSION > 3) || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2) || defined(TEXTDETECTION_USE_LIBJPEG)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+* \brief reducedDecodeFactor - Method which picks the largest JPEG reduction which still gives at least target width.
+*libjpeg output width for reduction 1/d is ceil(width / d).
+* \param [in] int width - full image width.
+* \param [in] int targetWidth - working width.
+* \return int - 1, 2, 4 or 8.
+*/
+int protech::reducedDecodeFactor(int width, int targetWidth)
+{
+	int factor = 8;
+	while (factor > 1 && (width + factor - 1) / factor < targetWidth)
+	{
+		factor /= 2;
+	}
+	return factor;
+}
+
+
+/**
+* \brief decodeImage - Method which decodes image from memory at reduced resolution if possible.
+* \param [in] const uchar * data - encoded image.
+* \param [in] size_t size - encoded size.
+* \param [in] int targetWidth - working width, decoded image is never narrower (unless the original is).
+* \param [in] bool grayscale - decode straight to one channel (when no colour output is needed).
+* \param [out] int * reduction - used reduction factor (optional).
+* \return cv::Mat - decoded image, empty on failure.
+*/
+cv::Mat protech::decodeImage(const uchar * data, size_t size, int targetWidth, bool grayscale, int * reduction)
+{
+	int width = 0;
+	int height = 0;
+	bool isJpeg = false;
+	int factor = 1;
+	if (readImageSize(data, size, width, height, isJpeg) && isJpeg)
+	{
+#if (CV_MAJOR_VERSION > 3) || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+		// imdecode applies Exif orientation, the working width is taken along the oriented width
+		if (readJpegOrientation(data, size) >= 5)
+			std::swap(width, height);
+#endif
+		factor = reducedDecodeFactor(width, targetWidth);
+	}
+
+	cv::Mat buffer(1, (int)size, CV_8UC1, const_cast<uchar *>(data));
+	cv::Mat image;
+
+#if (CV_MAJOR_VERSION > 3) || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+	int flags = grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+	switch (factor)
+	{
+	case 2: flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2; break;
+	case 4: flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4; break;
+	case 8: flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8; break;
+	default: break;
+	}
+	image = cv::imdecode(buffer, flags);
+#else
+#ifdef TEXTDETECTION_USE_LIBJPEG
+	if (isJpeg)
+	{
+		image = decodeJpegScaled(data, size, factor, grayscale);
+	}
+#endif
+	if (image.data == NULL)
+	{
+		factor = 1;
+		image = cv::imdecode(buffer, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+	}
+#endif
+
+	if (reduction != NULL)
+	{
+		*reduction = factor;
+	}
+	return image;
+}
+
+
+/**
+* \brief loadImage - Method which memory maps image file and decodes it at reduced resolution if possible.
+* \param [in] const std::string & path - image path.
+* \param [in] int targetWidth - working width.
+* \param [in] bool grayscale - decode straight to one channel.
+* \param [out] int * reduction - used reduction factor (optional).
+* \return cv::Mat - decoded image, empty on failure.
+*/
+cv::Mat protech::loadImage(const std::string & path, int targetWidth, bool grayscale, int * reduction)
+{
+	try
+	{
+		boost::iostreams::mapped_file_source file(path);
+		if (file.is_open() && file.size() > 0)
+		{
+			return decodeImage(reinterpret_cast<const uchar *>(file.data()), file.size(), targetWidth, grayscale, reduction);
+		}
+	}
+	catch (std::exception &)
+	{
+		;
+	}
+
+	// mapping failed (e.g. empty file or unsupported file system)
+	if (reduction != NULL)
+	{
+		*reduction = 1;
+	}
+	return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+}
+
+
+/**
+* \brief benchmarkReducedDecode - Method which compares full size decoding (imdecode and resize to working width)
+*with decodeImage on the same in-memory files, each file is decoded rounds times by both paths.
+* \param [in] const std::vector<std::string> & paths - image paths.
+* \param [in] int targetWidth - working width.
+* \param [in] size_t rounds - decodes of each file per path.
+* \return int - 0 if every file is decoded by both paths, otherwise -1.
+*/
+int protech::benchmarkReducedDecode(const std::vector<std::string> & paths, int targetWidth, size_t rounds)
+{
+	std::vector<std::string> files;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		std::ifstream file(paths[i].c_str(), std::ios::binary);
+		std::ostringstream bytes;
+		bytes << file.rdbuf();
+		if (!bytes.str().empty())
+			files.push_back(bytes.str());
+	}
+	if (files.empty() || rounds == 0)
+	{
+		std::cout << "Nothing to decode..." << std::endl;
+		return -1;
+	}
+	if (!reducedDecodeAvailable())
+		std::cout << "Reduced JPEG decoding is not built in, both paths decode at full size..." << std::endl;
+
+	int status = 0;
+	size_t reduced[9] = { 0 };
+	long long fullUs = 0;
+	long long reducedUs = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const uchar * data = reinterpret_cast<const uchar *>(files[i].data());
+		cv::Mat buffer(1, (int)files[i].size(), CV_8UC1, const_cast<uchar *>(data));
+
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+		for (size_t r = 0; r < rounds; r++)
+		{
+			cv::Mat image = cv::imdecode(buffer, cv::IMREAD_GRAYSCALE);
+			if (image.data == NULL)
+			{
+				status = -1;
+				break;
+			}
+			cv::Mat resized;
+			cv::resize(image, resized, cv::Size(targetWidth, image.rows * targetWidth / image.cols), 0, 0, cv::INTER_AREA);
+		}
+		fullUs += (boost::posix_time::microsec_clock::local_time() - start).total_microseconds();
+
+		start = boost::posix_time::microsec_clock::local_time();
+		for (size_t r = 0; r < rounds; r++)
+		{
+			int factor = 1;
+			cv::Mat image = decodeImage(data, files[i].size(), targetWidth, true, &factor);
+			if (image.data == NULL)
+			{
+				status = -1;
+				break;
+			}
+			cv::Mat resized;
+			cv::resize(image, resized, cv::Size(targetWidth, image.rows * targetWidth / image.cols), 0, 0, cv::INTER_AREA);
+			if (r == 0)
+				reduced[factor]++;
+		}
+		reducedUs += (boost::posix_time::microsec_clock::local_time() - start).total_microseconds();
+	}
+
+	double decodes = (double)(files.size() * rounds);
+	std::cout << "Files: " << files.size() << ", rounds: " << rounds << ", working width: " << targetWidth << std::endl;
+	std::cout << "Reduction 1/1: " << reduced[1] << ", 1/2: " << reduced[2] << ", 1/4: " << reduced[4] << ", 1/8: " << reduced[8] << std::endl;
+	std::cout << "Full decode + resize: " << fullUs / 1000.0 / decodes << " ms/image" << std::endl;
+	std::cout << "decodeImage + resize: " << reducedUs / 1000.0 / decodes << " ms/image";
+	if (reducedUs > 0)
+		std::cout << " (" << (double)fullUs / reducedUs << "x)";
+	std::cout << std::endl;
+	return status;
+}
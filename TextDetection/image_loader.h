@@ -0,0 +1,37 @@
+/*!\file image_loader.h
+*
+*	Image decoding matched to the working width used in TextDetection project.
+*	Image header is read first and JPEG images are decoded in DCT domain at the largest
+*	reduction (1/2, 1/4, 1/8) which still gives at least the working width.
+*	Reduced decoding uses IMREAD_REDUCED_* (OpenCV 3.2 and newer, the factor is chosen from the Exif oriented
+*	size because imdecode rotates the image) or libjpeg directly (TEXTDETECTION_USE_LIBJPEG, image is not rotated,
+*	like imdecode of OpenCV 2.4), otherwise the image is decoded at full resolution and resized.
+*	The VS2013 project builds against OpenCV 2.4.9 and defines TEXTDETECTION_USE_LIBJPEG (jpeglib.h from OpenCV
+*	sources\3rdparty\libjpeg, libjpeg.lib from build\x86\vc12\staticlib). benchmarkReducedDecode (--bench-decode)
+*	compares decode time with full size decoding.
+*	Files are memory mapped and decoded in place, without reading them into a buffer first.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+
+namespace protech
+{
+	bool readImageSize(const uchar * data, size_t size, int & width, int & height, bool & isJpeg);
+	int readJpegOrientation(const uchar * data, size_t size);
+	bool reducedDecodeAvailable();
+	int reducedDecodeFactor(int width, int targetWidth);
+
+	cv::Mat decodeImage(const uchar * data, size_t size, int targetWidth, bool grayscale, int * reduction = NULL);
+	cv::Mat loadImage(const std::string & path, int targetWidth, bool grayscale, int * reduction = NULL);
+
+	int benchmarkReducedDecode(const std::vector<std::string> & paths, int targetWidth, size_t rounds);
+}
+#endif
@@ -0,0 +1,605 @@
+#include "image_source.h"
+#include "image_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#ifdef TEXTDETECTION_USE_ZSTD
+#include <boost/iostreams/filter/zstd.hpp>
+#endif
+#include <boost/lexical_cast.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+namespace
+{
+	const size_t TAR_BLOCK = 512;//!< Tar header and data are stored in blocks of this size.
+	const unsigned long long MAX_IMAGE_BYTES = 256 * 1024 * 1024;//!< Upper limit for one image in archive or stream.
+
+	/**
+	* \brief fieldString - Method which returns NUL terminated (or full length) text of a tar header field.
+	* \param [in] const char * field - field start.
+	* \param [in] size_t length - field length.
+	* \return std::string - field text.
+	*/
+	std::string fieldString(const char * field, size_t length)
+	{
+		return std::string(field, std::find(field, field + length, '\0'));
+	}
+
+	/**
+	* \brief fieldNumber - Method which parses octal (or base-256 for large values) number of a tar header field.
+	* \param [in] const char * field - field start.
+	* \param [in] size_t length - field length.
+	* \return unsigned long long - field value.
+	*/
+	unsigned long long fieldNumber(const char * field, size_t length)
+	{
+		unsigned long long value = 0;
+		if ((unsigned char)field[0] & 0x80)
+		{
+			for (size_t i = 1; i < length; i++)
+			{
+				value = (value << 8) | (unsigned char)field[i];
+			}
+			return value;
+		}
+		for (size_t i = 0; i < length; i++)
+		{
+			if (field[i] >= '0' && field[i] <= '7')
+				value = value * 8 + (field[i] - '0');
+			else if (field[i] != ' ' || value != 0)
+				break;
+		}
+		return value;
+	}
+
+	unsigned int readLe16(const unsigned char * data)
+	{
+		return data[0] | (data[1] << 8);
+	}
+
+	unsigned long readLe32(const unsigned char * data)
+	{
+		return (unsigned long)data[0] | ((unsigned long)data[1] << 8) | ((unsigned long)data[2] << 16) | ((unsigned long)data[3] << 24);
+	}
+}
+
+
+/**
+* \brief fileName - Method which returns file name of image (archive entry path without folders).
+* \return std::string - file name.
+*/
+std::string protech::SourceImage::fileName() const
+{
+	std::string::size_type pos = name.find_last_of("\\/");
+	return (pos == std::string::npos) ? name : name.substr(pos + 1);
+}
+
+
+/**
+* \brief stem - Method which returns file name of image without extension.
+* \return std::string - file name stem.
+*/
+std::string protech::SourceImage::stem() const
+{
+	return boost::filesystem::path(fileName()).stem().string();
+}
+
+
+/**
+* \brief fileImage - Method which describes image file on disk.
+* \param [in] const boost::filesystem::path & path - image path.
+* \return SourceImage - image read from path.
+*/
+protech::SourceImage protech::fileImage(const boost::filesystem::path & path)
+{
+	SourceImage image;
+	image.name = path.filename().string();
+	image.path = path;
+	return image;
+}
+
+
+/**
+* \brief decodeSourceImage - Method which decodes image from memory (archive or stream entry) or from its file.
+* \param [in] const SourceImage & image - image.
+* \param [in] int targetWidth - working width (see decodeImage).
+* \param [in] bool grayscale - decode without colour.
+* \param [out] int * reduction - applied decode reduction (may be NULL).
+* \return cv::Mat - decoded image, empty if image can not be decoded.
+*/
+cv::Mat protech::decodeSourceImage(const SourceImage & image, int targetWidth, bool grayscale, int * reduction)
+{
+	if (!image.data.empty())
+	{
+		return decodeImage(&image.data[0], image.data.size(), targetWidth, grayscale, reduction);
+	}
+	if (!image.path.empty())
+	{
+		return loadImage(image.path.string(), targetWidth, grayscale, reduction);
+	}
+	return cv::Mat();
+}
+
+
+/**
+* \brief next - Method which hands over next image (in stored order or through reorder window).
+* \param [out] SourceImage & image - next image.
+* \return bool - false when there are no more images, otherwise true.
+*/
+bool protech::ImageSource::next(SourceImage & image)
+{
+	if (m_orderWindow == 0)
+	{
+		return readImage(image);
+	}
+
+	while (m_window.size() < m_orderWindow)
+	{
+		std::shared_ptr<SourceImage> entry(new SourceImage());
+		if (!readImage(*entry))
+			break;
+		m_window.push_back(entry);
+		std::push_heap(m_window.begin(), m_window.end(), ImageGreater());
+	}
+	if (m_window.empty())
+		return false;
+
+	std::pop_heap(m_window.begin(), m_window.end(), ImageGreater());
+	std::shared_ptr<SourceImage> top = m_window.back();
+	m_window.pop_back();
+	image.name = top->name;
+	image.path = top->path;
+	image.data.swap(top->data);
+	return true;
+}
+
+
+/**
+* \brief readImage - Method which reads next image of folder.
+* \param [out] SourceImage & image - next image (path only).
+* \return bool - false when folder is exhausted, otherwise true.
+*/
+bool protech::DirectoryImageSource::readImage(SourceImage & image)
+{
+	boost::filesystem::path path;
+	if (!m_stream.next(path))
+	{
+		return false;
+	}
+	image.name = path.filename().string();
+	image.path = path;
+	image.data.clear();
+	return true;
+}
+
+
+/**
+* \brief open - Method which opens tar archive (decompressed while read for .gz / .tgz and .zst / .tzst).
+* \param [in] const std::string & path - archive path.
+* \return bool - false if archive can not be opened.
+*/
+bool protech::TarImageSource::open(const std::string & path)
+{
+	namespace io = boost::iostreams;
+	m_path = path;
+	if (boost::algorithm::iends_with(path, ".gz") || boost::algorithm::iends_with(path, ".tgz"))
+	{
+		m_stream.push(io::gzip_decompressor());
+	}
+	else if (boost::algorithm::iends_with(path, ".zst") || boost::algorithm::iends_with(path, ".tzst"))
+	{
+#ifdef TEXTDETECTION_USE_ZSTD
+		m_stream.push(io::zstd_decompressor());
+#else
+		std::cout << "zstd archives are not supported in this build (TEXTDETECTION_USE_ZSTD), " << path << " can not be read..." << std::endl;
+		return false;
+#endif
+	}
+
+	io::file_source file(path, std::ios_base::in | std::ios_base::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	// large buffer keeps reading sequential at disk bandwidth
+	m_stream.push(file, 1 << 20);
+	return true;
+}
+
+
+/**
+* \brief readBlock - Method which reads one tar block.
+* \param [out] char * block - TAR_BLOCK bytes.
+* \return bool - false at end of stream.
+*/
+bool protech::TarImageSource::readBlock(char * block)
+{
+	m_stream.read(block, TAR_BLOCK);
+	return (size_t)m_stream.gcount() == TAR_BLOCK;
+}
+
+
+/**
+* \brief skipBytes - Method which skips entry data (compressed streams can not seek, so data is read and dropped).
+* \param [in] unsigned long long size - bytes to skip.
+* \return bool - false at end of stream.
+*/
+bool protech::TarImageSource::skipBytes(unsigned long long size)
+{
+	while (size > 0)
+	{
+		std::streamsize chunk = (std::streamsize)((size > (1 << 30)) ? (1 << 30) : size);
+		m_stream.ignore(chunk);
+		if (m_stream.gcount() != chunk)
+			return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+
+/**
+* \brief readImage - Method which reads next image entry of tar archive.
+*GNU long names ('L') and pax paths ('x') are used for the following entry; other entry types are skipped.
+* \param [out] SourceImage & image - next image (data only).
+* \return bool - false when archive is exhausted or truncated, otherwise true.
+*/
+bool protech::TarImageSource::readImage(SourceImage & image)
+{
+	std::string longName;
+	char block[TAR_BLOCK];
+	try
+	{
+		while (!m_finished)
+		{
+			if (!readBlock(block))
+			{
+				std::cout << m_path << " is truncated..." << std::endl;
+				m_finished = true;
+				break;
+			}
+			if (std::count(block, block + TAR_BLOCK, '\0') == (std::ptrdiff_t)TAR_BLOCK)
+			{
+				// end of archive
+				m_finished = true;
+				break;
+			}
+
+			unsigned long long size = fieldNumber(block + 124, 12);
+			unsigned long long padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+			char type = block[156];
+			std::string name = longName;
+			longName.clear();
+			if (name.empty())
+			{
+				name = fieldString(block, 100);
+				if (std::memcmp(block + 257, "ustar", 5) == 0 && block[345] != '\0')
+					name = fieldString(block + 345, 155) + "/" + name;
+			}
+
+			if ((type == 'L' || type == 'x') && size <= MAX_IMAGE_BYTES)
+			{
+				std::string content((size_t)size, '\0');
+				if (size > 0)
+					m_stream.read(&content[0], (std::streamsize)size);
+				if ((unsigned long long)m_stream.gcount() != size || !skipBytes(padding))
+				{
+					std::cout << m_path << " is truncated..." << std::endl;
+					m_finished = true;
+					break;
+				}
+				if (type == 'L')
+				{
+					longName = fieldString(content.data(), content.size());
+					continue;
+				}
+
+				// pax records "<length> <key>=<value>\n"
+				std::string::size_type pos = 0;
+				while (pos < content.size())
+				{
+					std::string::size_type space = content.find(' ', pos);
+					if (space == std::string::npos)
+						break;
+					size_t length = boost::lexical_cast<size_t>(content.substr(pos, space - pos));
+					if (length == 0 || pos + length > content.size())
+						break;
+					std::string record = content.substr(space + 1, pos + length - space - 2);
+					if (record.compare(0, 5, "path=") == 0)
+						longName = record.substr(5);
+					pos += length;
+				}
+				continue;
+			}
+
+			if ((type == '0' || type == '\0' || type == '7') && size <= MAX_IMAGE_BYTES && hasImageExtension(boost::filesystem::path(name)))
+			{
+				image.name = name;
+				image.path.clear();
+				image.data.resize((size_t)size);
+				if (size > 0)
+					m_stream.read(reinterpret_cast<char*>(&image.data[0]), (std::streamsize)size);
+				if ((unsigned long long)m_stream.gcount() != size || !skipBytes(padding))
+				{
+					std::cout << m_path << " is truncated..." << std::endl;
+					m_finished = true;
+					break;
+				}
+				return true;
+			}
+
+			if (!skipBytes(size + padding))
+			{
+				std::cout << m_path << " is truncated..." << std::endl;
+				m_finished = true;
+			}
+		}
+	}
+	catch (std::exception & ex)
+	{
+		std::cout << m_path << " can not be read: " << ex.what() << std::endl;
+		m_finished = true;
+	}
+
+	return false;
+}
+
+
+/**
+* \brief open - Method which opens zip archive and reads its central directory.
+*ZIP64 archives are not supported.
+* \param [in] const std::string & path - archive path.
+* \return bool - false if archive can not be opened or its central directory is not found.
+*/
+bool protech::ZipImageSource::open(const std::string & path)
+{
+	m_path = path;
+	m_file.open(path.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!m_file)
+	{
+		return false;
+	}
+
+	// end of central directory record is in the last 22 bytes + archive comment (at most 65535 bytes)
+	m_file.seekg(0, std::ios_base::end);
+	unsigned long long fileSize = (unsigned long long)m_file.tellg();
+	unsigned long long tailSize = (fileSize < 22 + 65535) ? fileSize : 22 + 65535;
+	std::vector<unsigned char> tail((size_t)tailSize);
+	m_file.seekg((std::streamoff)(fileSize - tailSize));
+	if (tailSize < 22 || !m_file.read(reinterpret_cast<char*>(&tail[0]), (std::streamsize)tailSize))
+	{
+		return false;
+	}
+	size_t end = (size_t)tailSize - 22 + 1;
+	while (end > 0 && readLe32(&tail[end - 1]) != 0x06054b50)
+	{
+		end--;
+	}
+	if (end == 0)
+	{
+		std::cout << path << " is not a zip archive..." << std::endl;
+		return false;
+	}
+	const unsigned char * record = &tail[end - 1];
+	unsigned int entriesCount = readLe16(record + 10);
+	unsigned long directorySize = readLe32(record + 12);
+	unsigned long directoryOffset = readLe32(record + 16);
+	if (entriesCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+	{
+		std::cout << path << " is a ZIP64 archive, which is not supported..." << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> directory(directorySize + 1);
+	m_file.seekg(directoryOffset);
+	if (!m_file.read(reinterpret_cast<char*>(&directory[0]), directorySize))
+	{
+		return false;
+	}
+	size_t pos = 0;
+	while (pos + 46 <= directorySize && readLe32(&directory[pos]) == 0x02014b50)
+	{
+		const unsigned char * header = &directory[pos];
+		unsigned int nameLength = readLe16(header + 28);
+		unsigned int extraLength = readLe16(header + 30);
+		unsigned int commentLength = readLe16(header + 32);
+		if (pos + 46 + nameLength > directorySize)
+			break;
+
+		ZipEntry entry;
+		entry.name = std::string(reinterpret_cast<const char*>(header + 46), nameLength);
+		entry.method = readLe16(header + 10);
+		entry.compressedSize = readLe32(header + 20);
+		entry.size = readLe32(header + 24);
+		entry.offset = readLe32(header + 42);
+		if (!entry.name.empty() && entry.name[entry.name.size() - 1] != '/' && entry.size <= MAX_IMAGE_BYTES && hasImageExtension(boost::filesystem::path(entry.name)))
+		{
+			m_entries.push_back(entry);
+		}
+		pos += 46 + nameLength + extraLength + commentLength;
+	}
+
+	// entries are read in file order, so the archive is read front to back once
+	std::sort(m_entries.begin(), m_entries.end());
+	m_file.clear();
+	return true;
+}
+
+
+/**
+* \brief readImage - Method which reads (and inflates) next image entry of zip archive.
+* \param [out] SourceImage & image - next image (data only).
+* \return bool - false when archive is exhausted, otherwise true.
+*/
+bool protech::ZipImageSource::readImage(SourceImage & image)
+{
+	namespace io = boost::iostreams;
+	while (m_next < m_entries.size())
+	{
+		const ZipEntry & entry = m_entries[m_next++];
+		unsigned char header[30];
+		m_file.seekg((std::streamoff)entry.offset);
+		if (!m_file.read(reinterpret_cast<char*>(header), sizeof(header)) || readLe32(header) != 0x04034b50)
+		{
+			std::cout << entry.name << " in " << m_path << " can not be read..." << std::endl;
+			m_file.clear();
+			continue;
+		}
+		if (entry.method != 0 && entry.method != 8)
+		{
+			std::cout << entry.name << " in " << m_path << " uses unsupported compression " << entry.method << "..." << std::endl;
+			continue;
+		}
+		m_file.ignore(readLe16(header + 26) + readLe16(header + 28));
+
+		std::vector<uchar> compressed((size_t)entry.compressedSize);
+		if (!compressed.empty() && !m_file.read(reinterpret_cast<char*>(&compressed[0]), compressed.size()))
+		{
+			std::cout << entry.name << " in " << m_path << " is truncated..." << std::endl;
+			m_file.clear();
+			continue;
+		}
+
+		image.name = entry.name;
+		image.path.clear();
+		if (entry.method == 0)
+		{
+			image.data.swap(compressed);
+			return true;
+		}
+
+		try
+		{
+			// raw deflate stream, without zlib header
+			io::zlib_params params;
+			params.noheader = true;
+			io::filtering_istream inflater;
+			inflater.push(io::zlib_decompressor(params));
+			inflater.push(io::array_source(reinterpret_cast<const char*>(compressed.empty() ? NULL : &compressed[0]), compressed.size()));
+			image.data.resize((size_t)entry.size);
+			if (entry.size > 0)
+				inflater.read(reinterpret_cast<char*>(&image.data[0]), (std::streamsize)entry.size);
+			if ((unsigned long long)inflater.gcount() == entry.size)
+			{
+				return true;
+			}
+			std::cout << entry.name << " in " << m_path << " is corrupted..." << std::endl;
+		}
+		catch (std::exception & ex)
+		{
+			std::cout << entry.name << " in " << m_path << " can not be inflated: " << ex.what() << std::endl;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+* \brief readImage - Method which reads next image of "<name> <size>\n<bytes>" stream.
+* \param [out] SourceImage & image - next image (data only).
+* \return bool - false at end of stream or when stream is out of sync.
+*/
+bool protech::StreamImageSource::readImage(SourceImage & image)
+{
+	std::string header;
+	while (std::getline(m_in, header))
+	{
+		if (!header.empty() && header[header.size() - 1] == '\r')
+			header.erase(header.size() - 1);
+		if (header.empty())
+			continue;
+
+		std::string::size_type space = header.rfind(' ');
+		unsigned long long size = 0;
+		try
+		{
+			if (space != std::string::npos)
+				size = boost::lexical_cast<unsigned long long>(header.substr(space + 1));
+		}
+		catch (std::exception &)
+		{
+			size = 0;
+		}
+		if (space == std::string::npos || space == 0 || size == 0 || size > MAX_IMAGE_BYTES)
+		{
+			std::cout << "Bad image header \"" << header << "\" in input stream..." << std::endl;
+			return false;
+		}
+
+		image.name = header.substr(0, space);
+		image.path.clear();
+		image.data.resize((size_t)size);
+		m_in.read(reinterpret_cast<char*>(&image.data[0]), (std::streamsize)size);
+		if ((unsigned long long)m_in.gcount() != size)
+		{
+			std::cout << image.name << " is incomplete in input stream..." << std::endl;
+			return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+/**
+* \brief openImageSource - Method which opens folder, archive or stdin ("-") as image source.
+* \param [in] const std::string & input - folder, .tar, .tar.gz, .tgz, .tar.zst, .tzst or .zip path, or "-".
+* \param [in] size_t orderWindow - DirectoryImageStream order (archives and stdin keep stored order unless window is finite).
+* \return std::unique_ptr<ImageSource> - image source, empty if input can not be opened.
+*/
+std::unique_ptr<protech::ImageSource> protech::openImageSource(const std::string & input, size_t orderWindow)
+{
+	std::unique_ptr<ImageSource> source;
+	if (boost::filesystem::is_directory(input))
+	{
+		source.reset(new DirectoryImageSource(input, orderWindow));
+		return source;
+	}
+
+	if (input == "-")
+	{
+#ifdef _WIN32
+		// image bytes must not be translated
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		source.reset(new StreamImageSource(std::cin));
+	}
+	else if (boost::algorithm::iends_with(input, ".zip"))
+	{
+		ZipImageSource * zip = new ZipImageSource();
+		source.reset(zip);
+		if (!zip->open(input))
+			source.reset();
+	}
+	else if (boost::algorithm::iends_with(input, ".tar") || boost::algorithm::iends_with(input, ".tar.gz") || boost::algorithm::iends_with(input, ".tgz")
+		|| boost::algorithm::iends_with(input, ".tar.zst") || boost::algorithm::iends_with(input, ".tzst"))
+	{
+		TarImageSource * tar = new TarImageSource();
+		source.reset(tar);
+		if (!tar->open(input))
+			source.reset();
+	}
+	else
+	{
+		std::cout << input << " is not a folder or a supported archive..." << std::endl;
+		return source;
+	}
+
+	if (source && orderWindow != DirectoryImageStream::ORDER_FULL)
+		source->setOrderWindow(orderWindow);
+	return source;
+}
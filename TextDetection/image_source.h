@@ -0,0 +1,154 @@
+/*!\file image_source.h
+*
+*	Input image sources used in TextDetection project.
+*	Input is a folder, an archive or "-" for stdin, and images are decoded from memory (archive entries are never extracted):
+*	  - folder: images are listed by DirectoryImageStream (natural order or reorder window),
+*	  - tar archive (.tar, gzip compressed .tar.gz / .tgz, zstd compressed .tar.zst / .tzst with TEXTDETECTION_USE_ZSTD),
+*	    read as one sequential stream,
+*	  - zip archive (.zip, stored or deflated entries), central directory is read first and entries in file offset order,
+*	  - stdin stream of "<name> <size>\n" headers, each followed by <size> image bytes.
+*	Entries of archives must have an image extension (see hasImageExtension). Archives and stdin keep stored order,
+*	exact natural order would need random access; a reorder window (--order-window) keeps bytes of at most N entries.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef IMAGE_SOURCE_H
+#define IMAGE_SOURCE_H
+
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "image_files.h"
+
+
+namespace protech
+{
+	/**
+	* \brief SourceImage - Image handed over by an image source.
+	*/
+	struct SourceImage
+	{
+		std::string name;//!< File name, or entry path inside archive.
+		boost::filesystem::path path;//!< File path (empty when image is in memory).
+		std::vector<uchar> data;//!< Encoded image bytes (empty when image is read from path).
+
+		std::string fileName() const;
+		std::string stem() const;
+	};
+
+	SourceImage fileImage(const boost::filesystem::path & path);
+	cv::Mat decodeSourceImage(const SourceImage & image, int targetWidth, bool grayscale, int * reduction = NULL);
+
+	class ImageSource
+	{
+	private:
+		/**
+		* \brief ImageGreater - Heap ordering of reorder window, smallest natural name on top.
+		*/
+		struct ImageGreater
+		{
+			bool operator()(const std::shared_ptr<SourceImage> & a, const std::shared_ptr<SourceImage> & b) const
+			{
+				return naturalLess(b->name, a->name);
+			}
+		};
+
+		size_t m_orderWindow;//!< Images kept for ordering (0 means stored order).
+		std::vector<std::shared_ptr<SourceImage> > m_window;//!< Reorder window (heap).
+
+	protected:
+		virtual bool readImage(SourceImage & image) = 0;
+
+	public:
+		ImageSource() : m_orderWindow(0){};
+		virtual ~ImageSource(){};
+
+		void setOrderWindow(size_t window) { m_orderWindow = window; };
+		bool next(SourceImage & image);
+	};
+
+	class DirectoryImageSource : public ImageSource
+	{
+	private:
+		DirectoryImageStream m_stream;
+
+	protected:
+		bool readImage(SourceImage & image);
+
+	public:
+		DirectoryImageSource(std::string dirPath, size_t orderWindow) : m_stream(dirPath, orderWindow){};
+	};
+
+	class TarImageSource : public ImageSource
+	{
+	private:
+		boost::iostreams::filtering_istream m_stream;//!< Archive, decompressed while read.
+		std::string m_path;
+		bool m_finished;
+
+		bool readBlock(char * block);
+		bool skipBytes(unsigned long long size);
+
+	protected:
+		bool readImage(SourceImage & image);
+
+	public:
+		TarImageSource() : m_finished(false){};
+
+		bool open(const std::string & path);
+	};
+
+	class ZipImageSource : public ImageSource
+	{
+	private:
+		/**
+		* \brief ZipEntry - Central directory record of one entry.
+		*/
+		struct ZipEntry
+		{
+			std::string name;
+			int method;//!< 0 stored, 8 deflated.
+			unsigned long long compressedSize;
+			unsigned long long size;
+			unsigned long long offset;//!< Local header offset.
+
+			bool operator<(const ZipEntry & other) const { return offset < other.offset; };
+		};
+
+		std::ifstream m_file;
+		std::string m_path;
+		std::vector<ZipEntry> m_entries;//!< Image entries in file offset order.
+		size_t m_next;
+
+	protected:
+		bool readImage(SourceImage & image);
+
+	public:
+		ZipImageSource() : m_next(0){};
+
+		bool open(const std::string & path);
+	};
+
+	class StreamImageSource : public ImageSource
+	{
+	private:
+		std::istream & m_in;
+
+	protected:
+		bool readImage(SourceImage & image);
+
+	public:
+		StreamImageSource(std::istream & in) : m_in(in){};
+	};
+
+	std::unique_ptr<ImageSource> openImageSource(const std::string & input, size_t orderWindow);
+}
+#endif
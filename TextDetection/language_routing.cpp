@@ -0,0 +1,159 @@
+#include "language_routing.h"
+#include "textDetector.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+/**
+* \brief parseLanguageList - Method which parses languages separated by '+' or ','.
+* \param [in] const std::string & text - language list, e.g. "tha+eng" or "English,Thai".
+* \param [out] std::vector<std::string> & codes - Tesseract language codes, in given order.
+* \return bool - false if list is empty or contains unsupported language.
+*/
+bool protech::parseLanguageList(const std::string & text, std::vector<std::string> & codes)
+{
+	codes.clear();
+	std::string::size_type start = 0;
+	while (start <= text.size())
+	{
+		std::string::size_type end = text.find_first_of("+,", start);
+		if (end == std::string::npos)
+			end = text.size();
+
+		std::string code = languageCode(text.substr(start, end - start));
+		if (code.empty())
+		{
+			codes.clear();
+			return false;
+		}
+		if (std::find(codes.begin(), codes.end(), code) == codes.end())
+			codes.push_back(code);
+		start = end + 1;
+	}
+
+	return !codes.empty();
+}
+
+
+/**
+* \brief addLanguages - Method which remembers languages which must be kept warm.
+* \param [in] const std::vector<std::string> & codes - Tesseract language codes.
+*/
+void protech::LanguageRouter::addLanguages(const std::vector<std::string> & codes)
+{
+	for (size_t i = 0; i < codes.size(); i++)
+	{
+		if (std::find(m_languages.begin(), m_languages.end(), codes[i]) == m_languages.end())
+			m_languages.push_back(codes[i]);
+	}
+}
+
+
+/**
+* \brief setDefault - Method which sets language of images without route.
+* \param [in] const std::string & language - Tesseract language code.
+*/
+void protech::LanguageRouter::setDefault(const std::string & language)
+{
+	std::vector<std::string>::iterator it = std::find(m_languages.begin(), m_languages.end(), language);
+	if (it != m_languages.end())
+		m_languages.erase(it);
+	m_languages.insert(m_languages.begin(), language);
+}
+
+
+/**
+* \brief addConfigured - Method which adds languages which are kept warm even if no image is routed to them yet.
+* \param [in] const std::string & list - languages separated by ',' or '+'.
+* \return bool - false if list contains unsupported language.
+*/
+bool protech::LanguageRouter::addConfigured(const std::string & list)
+{
+	std::vector<std::string> codes;
+	if (!parseLanguageList(list, codes))
+	{
+		return false;
+	}
+	addLanguages(codes);
+	return true;
+}
+
+
+/**
+* \brief loadManifest - Method which reads sidecar manifest with languages per image.
+*Lines with unsupported languages are reported and skipped.
+* \param [in] const std::string & path - manifest file.
+* \return bool - false if manifest can not be opened.
+*/
+bool protech::LanguageRouter::loadManifest(const std::string & path)
+{
+	std::ifstream manifest(path.c_str());
+	if (!manifest)
+	{
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(manifest, line))
+	{
+		lineNumber++;
+		std::string::size_type comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream fields(line);
+		std::string fileName;
+		std::string list;
+		if (!(fields >> fileName))
+		{
+			continue;
+		}
+
+		std::vector<std::string> codes;
+		if (!(fields >> list) || !parseLanguageList(list, codes))
+		{
+			std::cout << path << ":" << lineNumber << ": bad languages for " << fileName << ", default language is used..." << std::endl;
+			continue;
+		}
+		m_manifest[fileName] = codes;
+		addLanguages(codes);
+	}
+
+	return true;
+}
+
+
+/**
+* \brief languagesFor - Method which returns OCR languages of an image.
+* \param [in] const std::string & fileName - image file name (without folder).
+* \return std::vector<std::string> - Tesseract language codes, empty for default language.
+*/
+std::vector<std::string> protech::LanguageRouter::languagesFor(const std::string & fileName) const
+{
+	std::map<std::string, std::vector<std::string> >::const_iterator it = m_manifest.find(fileName);
+	if (it != m_manifest.end())
+	{
+		return it->second;
+	}
+
+	std::vector<std::string> codes;
+	if (m_filenameRule)
+	{
+		// name.tha+eng.jpg: languages are the last dot separated part before extension
+		std::string::size_type extension = fileName.find_last_of('.');
+		if (extension != std::string::npos && extension > 0)
+		{
+			std::string::size_type start = fileName.find_last_of('.', extension - 1);
+			if (start != std::string::npos && parseLanguageList(fileName.substr(start + 1, extension - start - 1), codes))
+			{
+				return codes;
+			}
+		}
+	}
+
+	return std::vector<std::string>();
+}
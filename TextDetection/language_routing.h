@@ -0,0 +1,47 @@
+/*!\file language_routing.h
+*
+*	Per-image language routing used in TextDetection project.
+*	Mixed folders are processed in one pass: engines of all configured languages are kept warm and
+*	every image is routed to its own languages, taken from (in this order)
+*	  - sidecar manifest, one "<file name> <language>[+<language>...]" line per image ('#' starts a comment),
+*	  - file name rule "<name>.<language>[+<language>...].<extension>", e.g. menu.tha+eng.jpg,
+*	  - default language.
+*	Languages are names or Tesseract codes (see languageCode). When an image has several languages,
+*	detection runs once and only OCR of candidate regions is repeated per language.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef LANGUAGE_ROUTING_H
+#define LANGUAGE_ROUTING_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace protech
+{
+	bool parseLanguageList(const std::string & text, std::vector<std::string> & codes);
+
+	class LanguageRouter
+	{
+	private:
+		std::vector<std::string> m_languages;//!< All languages which can be routed, default first.
+		std::map<std::string, std::vector<std::string> > m_manifest;//!< Languages per image file name.
+		bool m_filenameRule;//!< Take languages from file name when image is not in manifest.
+
+		void addLanguages(const std::vector<std::string> & codes);
+
+	public:
+		LanguageRouter() : m_filenameRule(false){};
+
+		void setDefault(const std::string & language);
+		bool addConfigured(const std::string & list);
+		bool loadManifest(const std::string & path);
+		void setFilenameRule(bool enabled) { m_filenameRule = enabled; };
+
+		std::vector<std::string> languagesFor(const std::string & fileName) const;
+		const std::vector<std::string> & languages() const { return m_languages; };
+	};
+}
+#endif
@@ -0,0 +1,254 @@
+#include "memory_stats.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define MEMORY_THREAD_LOCAL __declspec(thread)
+#else
+#define MEMORY_THREAD_LOCAL __thread
+#endif
+
+
+namespace
+{
+	std::atomic<unsigned long long> g_allocations;//!< Process wide allocations (zero initialized before any allocation).
+	std::atomic<long long> g_currentBytes;
+	std::atomic<long long> g_peakBytes;
+
+	MEMORY_THREAD_LOCAL unsigned long long t_allocations;
+	MEMORY_THREAD_LOCAL long long t_currentBytes;//!< Bytes allocated minus bytes freed by this thread.
+	MEMORY_THREAD_LOCAL long long t_peakBytes;
+
+#ifdef TEXTDETECTION_ALLOCATION_TRACKING
+	/**
+	* \brief blockSize - Method which returns usable size of malloc block.
+	*Size is asked from the allocator instead of stored in a header, so blocks can still be freed
+	*by libraries with their own operator delete (and ours can free theirs).
+	*/
+	size_t blockSize(void* block)
+	{
+#ifdef _WIN32
+		return _msize(block);
+#else
+		return malloc_usable_size(block);
+#endif
+	}
+
+	/**
+	* \brief trackedAlloc - Method which allocates block and counts it.
+	*/
+	void* trackedAlloc(size_t requested)
+	{
+		void* block = malloc(requested);
+		if (block == NULL)
+		{
+			return NULL;
+		}
+		size_t size = blockSize(block);
+
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		long long current = g_currentBytes.fetch_add((long long)size, std::memory_order_relaxed) + (long long)size;
+		long long peak = g_peakBytes.load(std::memory_order_relaxed);
+		while (current > peak && !g_peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+		{
+			;
+		}
+
+		t_allocations++;
+		t_currentBytes += (long long)size;
+		if (t_currentBytes > t_peakBytes)
+			t_peakBytes = t_currentBytes;
+
+		return block;
+	}
+
+	/**
+	* \brief trackedFree - Method which frees block allocated by trackedAlloc.
+	*/
+	void trackedFree(void* block)
+	{
+		if (block == NULL)
+		{
+			return;
+		}
+		size_t size = blockSize(block);
+
+		g_currentBytes.fetch_sub((long long)size, std::memory_order_relaxed);
+		t_currentBytes -= (long long)size;
+		free(block);
+	}
+#endif
+}
+
+
+#ifdef TEXTDETECTION_ALLOCATION_TRACKING
+void* operator new(size_t size)
+{
+	void* pointer = trackedAlloc(size ? size : 1);
+	if (pointer == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t &) throw()
+{
+	return trackedAlloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t &) throw()
+{
+	return trackedAlloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) throw()
+{
+	trackedFree(pointer);
+}
+
+void operator delete[](void* pointer) throw()
+{
+	trackedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t &) throw()
+{
+	trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t &) throw()
+{
+	trackedFree(pointer);
+}
+#endif
+
+
+/**
+* \brief allocationTrackingEnabled - Method which checks if operator new is counted in this build.
+* \return bool - true if built with TEXTDETECTION_ALLOCATION_TRACKING.
+*/
+bool protech::allocationTrackingEnabled()
+{
+#ifdef TEXTDETECTION_ALLOCATION_TRACKING
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+* \brief threadMemory - Method which returns counters of the calling thread.
+* \return MemoryCounters - allocations, live bytes and peak since last resetThreadPeak.
+*/
+protech::MemoryCounters protech::threadMemory()
+{
+	MemoryCounters counters;
+	counters.allocations = t_allocations;
+	counters.currentBytes = t_currentBytes;
+	counters.peakBytes = t_peakBytes;
+	return counters;
+}
+
+
+/**
+* \brief resetThreadPeak - Method which starts new peak measurement of the calling thread (peak = live bytes).
+*/
+void protech::resetThreadPeak()
+{
+	t_peakBytes = t_currentBytes;
+}
+
+
+/**
+* \brief processMemory - Method which returns process wide counters.
+* \return MemoryCounters - allocations, live bytes and peak since start.
+*/
+protech::MemoryCounters protech::processMemory()
+{
+	MemoryCounters counters;
+	counters.allocations = g_allocations.load();
+	counters.currentBytes = g_currentBytes.load();
+	counters.peakBytes = g_peakBytes.load();
+	return counters;
+}
+
+
+/**
+* \brief processRssBytes - Method which returns resident set size (working set on Windows) of the process.
+* \return unsigned long long - bytes, 0 if not available.
+*/
+unsigned long long protech::processRssBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (unsigned long long)counters.WorkingSetSize;
+	return 0;
+#else
+	unsigned long long pages = 0;
+	unsigned long long residentPages = 0;
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL)
+	{
+		return 0;
+	}
+	if (fscanf(statm, "%llu %llu", &pages, &residentPages) != 2)
+		residentPages = 0;
+	fclose(statm);
+	return residentPages * (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+/**
+* \brief processPeakRssBytes - Method which returns highest resident set size (peak working set on Windows).
+* \return unsigned long long - bytes, 0 if not available.
+*/
+unsigned long long protech::processPeakRssBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (unsigned long long)counters.PeakWorkingSetSize;
+	return 0;
+#else
+	unsigned long long peakKb = 0;
+	FILE* status = fopen("/proc/self/status", "r");
+	if (status == NULL)
+	{
+		return 0;
+	}
+	char line[256];
+	while (fgets(line, sizeof(line), status) != NULL)
+	{
+		if (strncmp(line, "VmHWM:", 6) == 0)
+		{
+			sscanf(line + 6, "%llu", &peakKb);
+			break;
+		}
+	}
+	fclose(status);
+	return peakKb * 1024;
+#endif
+}
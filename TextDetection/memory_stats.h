@@ -0,0 +1,38 @@
+/*!\file memory_stats.h
+*
+*	Header for memory accounting used in TextDetection project.
+*	Global operator new/delete are replaced to count heap allocations and live bytes (usable block sizes),
+*	process wide and per thread (so a worker can measure its own image). Allocations made inside OpenCV
+*	and Leptonica use malloc directly and are seen only in process RSS; on Windows, blocks allocated
+*	by DLLs and freed here make the counters slightly low.
+*	Replacing operator new affects the whole process, so tracking is compiled in only when
+*	TEXTDETECTION_ALLOCATION_TRACKING is defined (soak and benchmark builds); otherwise heap counters stay 0,
+*	only RSS is measured and JSONL records and metrics exports leave the heap figures out (null in JSON).
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+
+namespace protech
+{
+	/**
+	* \brief MemoryCounters - Heap allocation counters (bytes requested through operator new).
+	*/
+	struct MemoryCounters
+	{
+		unsigned long long allocations;//!< Number of allocations.
+		long long currentBytes;//!< Live bytes (allocated minus freed).
+		long long peakBytes;//!< Highest live bytes since last resetThreadPeak (thread) or start (process).
+	};
+
+	bool allocationTrackingEnabled();
+	MemoryCounters threadMemory();
+	void resetThreadPeak();
+	MemoryCounters processMemory();
+
+	unsigned long long processRssBytes();
+	unsigned long long processPeakRssBytes();
+}
+#endif
@@ -0,0 +1,610 @@
+#include "metrics.h"
+#include "memory_stats.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+
+namespace
+{
+	protech::Metrics g_metrics;//!< Process wide metrics (constructed before main, so no lazy initialization race).
+
+	/**
+	* \brief escapeLabel - Method which escapes quotes and backslashes for Prometheus labels and JSON strings.
+	*/
+	std::string escapeLabel(const std::string & value)
+	{
+		std::string result;
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			if (value[i] == '"' || value[i] == '\\')
+				result += '\\';
+			result += value[i];
+		}
+		return result;
+	}
+}
+
+
+/**
+* \brief metrics - Method which returns process wide metrics.
+* \return protech::Metrics & - metrics.
+*/
+protech::Metrics & protech::metrics()
+{
+	return g_metrics;
+}
+
+
+/**
+* \brief LatencyHistogram::LatencyHistogram - constructor.
+*/
+protech::LatencyHistogram::LatencyHistogram()
+	: m_count(0), m_sumUs(0), m_maxUs(0)
+{
+	for (int i = 0; i < BUCKETS_COUNT; i++)
+	{
+		m_buckets[i].store(0);
+	}
+}
+
+
+/**
+* \brief bucketIndex - Method which maps value to bucket: values < 32 map directly, larger values by
+*position of the highest bit and the next 4 bits.
+* \param [in] unsigned long long valueUs - value.
+* \return int - bucket index.
+*/
+int protech::LatencyHistogram::bucketIndex(unsigned long long valueUs)
+{
+	if (valueUs < 2 * SUB_BUCKETS)
+	{
+		return (int)valueUs;
+	}
+	int shift = 0;
+	while ((valueUs >> shift) >= 2 * SUB_BUCKETS)
+	{
+		shift++;
+	}
+	int index = shift * SUB_BUCKETS + (int)(valueUs >> shift);
+	return (index < BUCKETS_COUNT) ? index : BUCKETS_COUNT - 1;
+}
+
+
+/**
+* \brief bucketUpperBound - Method which returns the largest value of the bucket.
+* \param [in] int index - bucket index.
+* \return unsigned long long - largest value.
+*/
+unsigned long long protech::LatencyHistogram::bucketUpperBound(int index)
+{
+	if (index < 2 * SUB_BUCKETS)
+	{
+		return (unsigned long long)index;
+	}
+	int shift = index / SUB_BUCKETS - 1;
+	unsigned long long mantissa = (unsigned long long)(index % SUB_BUCKETS + SUB_BUCKETS);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+
+/**
+* \brief record - Method which adds one value.
+* \param [in] unsigned long long valueUs - duration in microseconds.
+*/
+void protech::LatencyHistogram::record(unsigned long long valueUs)
+{
+	m_buckets[bucketIndex(valueUs)].fetch_add(1);
+	m_count.fetch_add(1);
+	m_sumUs.fetch_add(valueUs);
+
+	unsigned long long currentMax = m_maxUs.load();
+	while (valueUs > currentMax && !m_maxUs.compare_exchange_weak(currentMax, valueUs))
+	{
+		;
+	}
+}
+
+
+/**
+* \brief percentileUs - Method which returns value at percentile (upper bound of its bucket, but never above max).
+* \param [in] double percentile - percentile in range 0 - 100.
+* \return unsigned long long - value in microseconds, 0 if histogram is empty.
+*/
+unsigned long long protech::LatencyHistogram::percentileUs(double percentile) const
+{
+	unsigned long long counts[BUCKETS_COUNT];
+	unsigned long long total = 0;
+	for (int i = 0; i < BUCKETS_COUNT; i++)
+	{
+		counts[i] = m_buckets[i].load();
+		total += counts[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	unsigned long long rank = (unsigned long long)(percentile / 100.0 * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	unsigned long long seen = 0;
+	for (int i = 0; i < BUCKETS_COUNT; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			unsigned long long bound = bucketUpperBound(i);
+			unsigned long long maxValue = m_maxUs.load();
+			return (bound < maxValue) ? bound : maxValue;
+		}
+	}
+	return m_maxUs.load();
+}
+
+
+/**
+* \brief Metrics::Metrics - constructor.
+*/
+protech::Metrics::Metrics()
+	: m_slowestThresholdUs(0), m_started(boost::posix_time::microsec_clock::universal_time())
+{
+	for (int i = 0; i < COUNTERS_COUNT; i++)
+	{
+		m_counters[i].store(0);
+	}
+	for (int s = 0; s < STAGES_COUNT; s++)
+	{
+		m_stageHeapBytes[s].store(0);
+		m_stageHeapPeakBytes[s].store(0);
+	}
+}
+
+
+/**
+* \brief recordStageMemory - Method which records heap usage of one stage of one image.
+* \param [in] Stage stage - finished stage.
+* \param [in] long long currentBytes - heap bytes above image start at end of stage.
+* \param [in] long long peakBytes - highest heap bytes above image start during stage.
+*/
+void protech::Metrics::recordStageMemory(Stage stage, long long currentBytes, long long peakBytes)
+{
+	m_stageHeapBytes[stage].store(currentBytes);
+
+	long long currentPeak = m_stageHeapPeakBytes[stage].load();
+	while (peakBytes > currentPeak && !m_stageHeapPeakBytes[stage].compare_exchange_weak(currentPeak, peakBytes))
+	{
+		;
+	}
+}
+
+
+/**
+* \brief stageName - Method which returns stage label.
+*/
+const char* protech::Metrics::stageName(int stage)
+{
+	static const char* names[STAGES_COUNT] = { "decode", "triage", "preprocess", "contours", "split", "validate", "rules", "components", "ocr", "output", "total" };
+	return names[stage];
+}
+
+
+/**
+* \brief counterName - Method which returns funnel counter label.
+*/
+const char* protech::Metrics::counterName(int counter)
+{
+	static const char* names[COUNTERS_COUNT] = { "images", "contours", "contours_kept", "boxes_split", "boxes_valid", "rules_boxes", "super_boxes", "components", "layout_calls", "recognize_calls", "accepted", "ocr_skipped", "partial_images", "region_tasks", "regions_stolen", "triage_skipped" };
+	return names[counter];
+}
+
+
+/**
+* \brief priorityName - Method which returns scheduling class label.
+*/
+const char* protech::Metrics::priorityName(int priority)
+{
+	static const char* names[PRIORITY_CLASSES] = { "high", "normal", "bulk" };
+	return names[priority];
+}
+
+
+/**
+* \brief recordImage - Method which counts image and keeps it if it is one of the slowest.
+*Lock is taken only when image is slower than the fastest image in the full list.
+* \param [in] const std::string & name - image name.
+* \param [in] unsigned long long totalUs - total detection time.
+*/
+void protech::Metrics::recordImage(const std::string & name, unsigned long long totalUs)
+{
+	m_counters[COUNT_IMAGES].fetch_add(1);
+	m_stages[STAGE_TOTAL].record(totalUs);
+
+	if (totalUs <= m_slowestThresholdUs.load())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_slowestLock);
+	SlowImage image;
+	image.name = name;
+	image.totalUs = totalUs;
+
+	std::vector<SlowImage>::iterator it = m_slowest.begin();
+	while (it != m_slowest.end() && it->totalUs >= totalUs)
+	{
+		++it;
+	}
+	m_slowest.insert(it, image);
+	if (m_slowest.size() > SLOWEST_COUNT)
+	{
+		m_slowest.pop_back();
+	}
+	if (m_slowest.size() == SLOWEST_COUNT)
+	{
+		m_slowestThresholdUs.store(m_slowest.back().totalUs);
+	}
+}
+
+
+/**
+* \brief writePrometheus - Method which writes snapshot in Prometheus text exposition format.
+* \param [in] std::ostream & out - output stream.
+*/
+void protech::Metrics::writePrometheus(std::ostream & out)
+{
+	static const double quantiles[] = { 0.5, 0.9, 0.95, 0.99, 0.999 };
+
+	out << "# HELP textdetection_uptime_seconds Time since process start.\n";
+	out << "# TYPE textdetection_uptime_seconds gauge\n";
+	out << "textdetection_uptime_seconds " << (boost::posix_time::microsec_clock::universal_time() - m_started).total_milliseconds() / 1000.0 << "\n";
+
+	out << "# HELP textdetection_funnel_total Candidates which reached each pipeline step.\n";
+	out << "# TYPE textdetection_funnel_total counter\n";
+	for (int c = 0; c < COUNTERS_COUNT; c++)
+	{
+		out << "textdetection_funnel_total{step=\"" << counterName(c) << "\"} " << m_counters[c].load() << "\n";
+	}
+
+	out << "# HELP textdetection_stage_seconds Stage latency per image.\n";
+	out << "# TYPE textdetection_stage_seconds summary\n";
+	for (int s = 0; s < STAGES_COUNT; s++)
+	{
+		for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+		{
+			out << "textdetection_stage_seconds{stage=\"" << stageName(s) << "\",quantile=\"" << quantiles[q] << "\"} " << m_stages[s].percentileUs(quantiles[q] * 100.0) / 1e6 << "\n";
+		}
+		out << "textdetection_stage_seconds_sum{stage=\"" << stageName(s) << "\"} " << m_stages[s].sumUs() / 1e6 << "\n";
+		out << "textdetection_stage_seconds_count{stage=\"" << stageName(s) << "\"} " << m_stages[s].count() << "\n";
+	}
+
+	out << "# HELP textdetection_stage_max_seconds Longest stage latency.\n";
+	out << "# TYPE textdetection_stage_max_seconds gauge\n";
+	for (int s = 0; s < STAGES_COUNT; s++)
+	{
+		out << "textdetection_stage_max_seconds{stage=\"" << stageName(s) << "\"} " << m_stages[s].maxUs() / 1e6 << "\n";
+	}
+
+	out << "# HELP textdetection_queue_delay_seconds Time from submit until a worker starts the image, per priority class.\n";
+	out << "# TYPE textdetection_queue_delay_seconds summary\n";
+	for (int p = 0; p < PRIORITY_CLASSES; p++)
+	{
+		for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+		{
+			out << "textdetection_queue_delay_seconds{class=\"" << priorityName(p) << "\",quantile=\"" << quantiles[q] << "\"} " << m_queueDelay[p].percentileUs(quantiles[q] * 100.0) / 1e6 << "\n";
+		}
+		out << "textdetection_queue_delay_seconds_sum{class=\"" << priorityName(p) << "\"} " << m_queueDelay[p].sumUs() / 1e6 << "\n";
+		out << "textdetection_queue_delay_seconds_count{class=\"" << priorityName(p) << "\"} " << m_queueDelay[p].count() << "\n";
+	}
+
+	out << "# HELP textdetection_process_rss_bytes Resident set size (working set) of the process.\n";
+	out << "# TYPE textdetection_process_rss_bytes gauge\n";
+	out << "textdetection_process_rss_bytes " << processRssBytes() << "\n";
+	out << "# HELP textdetection_process_peak_rss_bytes Highest resident set size of the process.\n";
+	out << "# TYPE textdetection_process_peak_rss_bytes gauge\n";
+	out << "textdetection_process_peak_rss_bytes " << processPeakRssBytes() << "\n";
+	// heap series are left out rather than reported as 0 when operator new is not counted
+	if (allocationTrackingEnabled())
+	{
+		MemoryCounters heap = processMemory();
+		out << "# HELP textdetection_heap_bytes Live heap bytes allocated with operator new.\n";
+		out << "# TYPE textdetection_heap_bytes gauge\n";
+		out << "textdetection_heap_bytes " << heap.currentBytes << "\n";
+		out << "textdetection_heap_peak_bytes " << heap.peakBytes << "\n";
+
+		out << "# HELP textdetection_stage_heap_bytes Heap bytes held above image start at end of stage (last image).\n";
+		out << "# TYPE textdetection_stage_heap_bytes gauge\n";
+		for (int s = 0; s < STAGES_COUNT; s++)
+		{
+			out << "textdetection_stage_heap_bytes{stage=\"" << stageName(s) << "\"} " << m_stageHeapBytes[s].load() << "\n";
+		}
+		out << "# HELP textdetection_stage_heap_peak_bytes Highest heap bytes above image start during stage.\n";
+		out << "# TYPE textdetection_stage_heap_peak_bytes gauge\n";
+		for (int s = 0; s < STAGES_COUNT; s++)
+		{
+			out << "textdetection_stage_heap_peak_bytes{stage=\"" << stageName(s) << "\"} " << m_stageHeapPeakBytes[s].load() << "\n";
+		}
+
+		out << "# HELP textdetection_image_allocations Heap allocations per image.\n";
+		out << "# TYPE textdetection_image_allocations summary\n";
+		for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+		{
+			out << "textdetection_image_allocations{quantile=\"" << quantiles[q] << "\"} " << m_imageAllocations.percentileUs(quantiles[q] * 100.0) << "\n";
+		}
+		out << "textdetection_image_allocations_sum " << m_imageAllocations.sumUs() << "\n";
+		out << "textdetection_image_allocations_count " << m_imageAllocations.count() << "\n";
+	}
+
+	std::lock_guard<std::mutex> lock(m_slowestLock);
+	out << "# HELP textdetection_slowest_image_seconds Images with the longest total detection time.\n";
+	out << "# TYPE textdetection_slowest_image_seconds gauge\n";
+	for (size_t i = 0; i < m_slowest.size(); i++)
+	{
+		out << "textdetection_slowest_image_seconds{rank=\"" << i + 1 << "\",image=\"" << escapeLabel(m_slowest[i].name) << "\"} " << m_slowest[i].totalUs / 1e6 << "\n";
+	}
+}
+
+
+/**
+* \brief writeJson - Method which writes snapshot as JSON object.
+* \param [in] std::ostream & out - output stream.
+*/
+void protech::Metrics::writeJson(std::ostream & out)
+{
+	static const double percentiles[] = { 50, 90, 95, 99, 99.9 };
+
+	out << "{\n  \"uptime_s\": " << (boost::posix_time::microsec_clock::universal_time() - m_started).total_milliseconds() / 1000.0 << ",\n";
+
+	out << "  \"funnel\": {";
+	for (int c = 0; c < COUNTERS_COUNT; c++)
+	{
+		out << (c ? ", " : " ") << "\"" << counterName(c) << "\": " << m_counters[c].load();
+	}
+	out << " },\n";
+
+	out << "  \"stages_ms\": {\n";
+	for (int s = 0; s < STAGES_COUNT; s++)
+	{
+		out << "    \"" << stageName(s) << "\": { \"count\": " << m_stages[s].count() << ", \"sum\": " << m_stages[s].sumUs() / 1000.0;
+		for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++)
+		{
+			out << ", \"p" << percentiles[p] << "\": " << m_stages[s].percentileUs(percentiles[p]) / 1000.0;
+		}
+		out << ", \"max\": " << m_stages[s].maxUs() / 1000.0 << " }" << (s + 1 < STAGES_COUNT ? "," : "") << "\n";
+	}
+	out << "  },\n";
+
+	out << "  \"queue_delay_ms\": {\n";
+	for (int p = 0; p < PRIORITY_CLASSES; p++)
+	{
+		out << "    \"" << priorityName(p) << "\": { \"count\": " << m_queueDelay[p].count();
+		for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+		{
+			out << ", \"p" << percentiles[i] << "\": " << m_queueDelay[p].percentileUs(percentiles[i]) / 1000.0;
+		}
+		out << ", \"max\": " << m_queueDelay[p].maxUs() / 1000.0 << " }" << (p + 1 < PRIORITY_CLASSES ? "," : "") << "\n";
+	}
+	out << "  },\n";
+
+	out << "  \"memory\": {\n";
+	out << "    \"rss_bytes\": " << processRssBytes() << ", \"peak_rss_bytes\": " << processPeakRssBytes();
+	if (!allocationTrackingEnabled())
+	{
+		// heap figures are unknown, not 0, when operator new is not counted
+		out << ", \"heap_bytes\": null, \"heap_peak_bytes\": null,\n";
+		out << "    \"image_allocations\": null,\n    \"stages\": null\n  },\n";
+	}
+	else
+	{
+		MemoryCounters heap = processMemory();
+		out << ", \"heap_bytes\": " << heap.currentBytes << ", \"heap_peak_bytes\": " << heap.peakBytes << ",\n";
+		out << "    \"image_allocations\": { \"count\": " << m_imageAllocations.count();
+		for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+		{
+			out << ", \"p" << percentiles[i] << "\": " << m_imageAllocations.percentileUs(percentiles[i]);
+		}
+		out << ", \"max\": " << m_imageAllocations.maxUs() << " },\n";
+		out << "    \"stages\": {";
+		for (int s = 0; s < STAGES_COUNT; s++)
+		{
+			out << (s ? ", " : " ") << "\"" << stageName(s) << "\": { \"heap_bytes\": " << m_stageHeapBytes[s].load() << ", \"heap_peak_bytes\": " << m_stageHeapPeakBytes[s].load() << " }";
+		}
+		out << " }\n  },\n";
+	}
+
+	std::lock_guard<std::mutex> lock(m_slowestLock);
+	out << "  \"slowest\": [";
+	for (size_t i = 0; i < m_slowest.size(); i++)
+	{
+		out << (i ? ", " : " ") << "{ \"image\": \"" << escapeLabel(m_slowest[i].name) << "\", \"total_ms\": " << m_slowest[i].totalUs / 1000.0 << " }";
+	}
+	out << " ]\n}\n";
+}
+
+
+/**
+* \brief StageClock::StageClock - constructor, starts measuring.
+* \param [out] std::vector<unsigned long long>* stageUs - if set, lap times of this image are also stored here (indexed by stage).
+*/
+protech::StageClock::StageClock(std::vector<unsigned long long>* stageUs)
+	: m_stageUs(stageUs), m_peakBytes(0), m_carriedAllocations(0)
+{
+	m_start = boost::posix_time::microsec_clock::universal_time();
+	m_last = m_start;
+	if (m_stageUs != NULL)
+		m_stageUs->assign(Metrics::STAGES_COUNT, 0);
+
+	MemoryCounters memory = threadMemory();
+	m_startAllocations = memory.allocations;
+	m_startBytes = memory.currentBytes;
+	resetThreadPeak();
+}
+
+
+/**
+* \brief lap - Method which records time since previous lap as given stage.
+* \param [in] Metrics::Stage stage - finished stage.
+* \return unsigned long long - stage time in microseconds.
+*/
+unsigned long long protech::StageClock::lap(Metrics::Stage stage)
+{
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	unsigned long long us = (unsigned long long)(now - m_last).total_microseconds();
+	m_last = now;
+	metrics().recordStage(stage, us);
+	if (m_stageUs != NULL)
+		(*m_stageUs)[stage] = us;
+
+	MemoryCounters memory = threadMemory();
+	long long peakBytes = memory.peakBytes - m_startBytes;
+	metrics().recordStageMemory(stage, memory.currentBytes - m_startBytes, peakBytes);
+	if (peakBytes > m_peakBytes)
+		m_peakBytes = peakBytes;
+	resetThreadPeak();
+	return us;
+}
+
+
+/**
+* \brief totalUs - Method which returns time since clock was created.
+*/
+unsigned long long protech::StageClock::totalUs()
+{
+	return (unsigned long long)(boost::posix_time::microsec_clock::universal_time() - m_start).total_microseconds();
+}
+
+
+/**
+* \brief allocations - Method which returns heap allocations of this thread since clock was created.
+*/
+unsigned long long protech::StageClock::allocations()
+{
+	return m_carriedAllocations + threadMemory().allocations - m_startAllocations;
+}
+
+
+/**
+* \brief suspend - Method which stops memory measurement on the calling thread, before image is handed to another thread.
+*/
+void protech::StageClock::suspend()
+{
+	m_carriedAllocations += threadMemory().allocations - m_startAllocations;
+	m_startAllocations = threadMemory().allocations;
+}
+
+
+/**
+* \brief resume - Method which continues memory measurement on the calling thread (after suspend on another thread).
+*Allocations made meanwhile by other threads (e.g. region OCR on other workers) are not counted.
+*/
+void protech::StageClock::resume()
+{
+	MemoryCounters memory = threadMemory();
+	m_startAllocations = memory.allocations;
+	m_startBytes = memory.currentBytes;
+	resetThreadPeak();
+}
+
+
+/**
+* \brief MetricsExporter::MetricsExporter - constructor.
+* \param [in] std::string path - output file; .json gives JSON snapshot, otherwise Prometheus text format.
+* \param [in] int periodMs - export period in milliseconds.
+*/
+protech::MetricsExporter::MetricsExporter(std::string path, int periodMs)
+	: m_path(path), m_periodMs(periodMs), m_stop(false)
+{
+}
+
+
+/**
+* \brief MetricsExporter::~MetricsExporter - destructor, writes final snapshot.
+*/
+protech::MetricsExporter::~MetricsExporter()
+{
+	stop();
+}
+
+
+/**
+* \brief start - Method which starts export thread.
+*/
+void protech::MetricsExporter::start()
+{
+	m_stop = false;
+	m_thread = std::thread(&MetricsExporter::exportLoop, this);
+}
+
+
+/**
+* \brief stop - Method which stops export thread and writes final snapshot.
+*/
+void protech::MetricsExporter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+		m_wake.notify_all();
+	}
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+		writeSnapshot();
+	}
+}
+
+
+/**
+* \brief exportLoop - Export thread: writes snapshot every period until stopped.
+*/
+void protech::MetricsExporter::exportLoop()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	while (!m_stop)
+	{
+		m_wake.wait_for(lock, std::chrono::milliseconds(m_periodMs));
+		if (!m_stop)
+		{
+			lock.unlock();
+			writeSnapshot();
+			lock.lock();
+		}
+	}
+}
+
+
+/**
+* \brief writeSnapshot - Method which writes snapshot to temporary file and renames it over the output file,
+*so readers (e.g. node exporter textfile collector) never see partial file.
+* \return bool - false if file can not be written, otherwise true.
+*/
+bool protech::MetricsExporter::writeSnapshot()
+{
+	std::ostringstream snapshot;
+	boost::filesystem::path path(m_path);
+	if (path.extension() == ".json")
+	{
+		metrics().writeJson(snapshot);
+	}
+	else
+	{
+		metrics().writePrometheus(snapshot);
+	}
+
+	std::string tmpPath = m_path + ".tmp";
+	{
+		std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file << snapshot.str();
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, path, ec);
+	return !ec;
+}
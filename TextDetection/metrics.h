@@ -0,0 +1,196 @@
+/*!\file metrics.h
+*
+*	Header for pipeline metrics used in TextDetection project.
+*	Stage latencies are kept in log-linear (HDR style) histograms and candidate counts
+*	(contours -> boxes -> super boxes -> components -> OCR -> accepted) in counters.
+*	Recording only uses atomic increments, so it is cheap on every worker thread.
+*	Heap bytes per stage, allocations per image and process RSS come from memory_stats; heap figures are
+*	exported only by builds with allocation tracking (JSON writes null for them otherwise).
+*	MetricsExporter writes a snapshot periodically as Prometheus text format
+*	(or JSON when file name ends with .json), replacing the file atomically.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+
+namespace protech
+{
+	/**
+	* \brief LatencyHistogram - Log-linear histogram of durations in microseconds.
+	*Values below 32 us have own buckets, above that every power of two is split in 16 buckets (relative error < 6.25%).
+	*/
+	class LatencyHistogram
+	{
+	public:
+		static const int SUB_BUCKETS = 16;
+		static const int BUCKETS_COUNT = 16 * 34;
+
+	private:
+		std::atomic<unsigned long long> m_buckets[BUCKETS_COUNT];
+		std::atomic<unsigned long long> m_count;
+		std::atomic<unsigned long long> m_sumUs;
+		std::atomic<unsigned long long> m_maxUs;
+
+		static int bucketIndex(unsigned long long valueUs);
+		static unsigned long long bucketUpperBound(int index);
+
+	public:
+		LatencyHistogram();
+
+		void record(unsigned long long valueUs);
+		unsigned long long count() const { return m_count.load(); };
+		unsigned long long sumUs() const { return m_sumUs.load(); };
+		unsigned long long maxUs() const { return m_maxUs.load(); };
+		unsigned long long percentileUs(double percentile) const;
+	};
+
+	class Metrics
+	{
+	public:
+		enum Stage
+		{
+			STAGE_DECODE = 0,
+			STAGE_TRIAGE,
+			STAGE_PREPROCESS,
+			STAGE_CONTOURS,
+			STAGE_SPLIT,
+			STAGE_VALIDATE,
+			STAGE_RULES,
+			STAGE_COMPONENTS,
+			STAGE_OCR,
+			STAGE_OUTPUT,
+			STAGE_TOTAL,
+			STAGES_COUNT
+		};
+
+		enum Counter
+		{
+			COUNT_IMAGES = 0,
+			COUNT_CONTOURS,
+			COUNT_CONTOURS_KEPT,
+			COUNT_BOXES_SPLIT,
+			COUNT_BOXES_VALID,
+			COUNT_RULES_BOXES,
+			COUNT_SUPER_BOXES,
+			COUNT_COMPONENTS,
+			COUNT_LAYOUT_CALLS,
+			COUNT_RECOGNIZE_CALLS,
+			COUNT_ACCEPTED,
+			COUNT_OCR_SKIPPED,
+			COUNT_PARTIAL_IMAGES,
+			COUNT_REGION_TASKS,
+			COUNT_REGIONS_STOLEN,
+			COUNT_TRIAGE_SKIPPED,
+			COUNTERS_COUNT
+		};
+
+		/**
+		* \brief SlowImage - Image with one of the longest total detection times.
+		*/
+		struct SlowImage
+		{
+			std::string name;//!< Image name.
+			unsigned long long totalUs;//!< Total detection time.
+		};
+
+		static const size_t SLOWEST_COUNT = 10;
+		static const int PRIORITY_CLASSES = 3;//!< Scheduling classes (see DetectionOptions::Priority).
+
+	private:
+		LatencyHistogram m_stages[STAGES_COUNT];
+		LatencyHistogram m_queueDelay[PRIORITY_CLASSES];//!< Time from submit to worker start per class.
+		std::atomic<long long> m_stageHeapBytes[STAGES_COUNT];//!< Heap bytes above image start at end of stage (last image).
+		std::atomic<long long> m_stageHeapPeakBytes[STAGES_COUNT];//!< Highest heap bytes above image start during stage.
+		LatencyHistogram m_imageAllocations;//!< Heap allocations per image (counts, not microseconds).
+		std::atomic<unsigned long long> m_counters[COUNTERS_COUNT];
+		std::vector<SlowImage> m_slowest;//!< Slowest images, longest first.
+		std::atomic<unsigned long long> m_slowestThresholdUs;//!< Shortest time in full slowest list.
+		std::mutex m_slowestLock;
+		boost::posix_time::ptime m_started;
+
+	public:
+		Metrics();
+
+		static const char* stageName(int stage);
+		static const char* counterName(int counter);
+		static const char* priorityName(int priority);
+
+		void recordStage(Stage stage, unsigned long long valueUs) { m_stages[stage].record(valueUs); };
+		void add(Counter counter, unsigned long long value) { m_counters[counter].fetch_add(value); };
+		unsigned long long counter(Counter counter) const { return m_counters[counter].load(); };
+		const LatencyHistogram & stage(int stage) const { return m_stages[stage]; };
+		void recordImage(const std::string & name, unsigned long long totalUs);
+		void recordQueueDelay(int priority, unsigned long long valueUs) { m_queueDelay[priority].record(valueUs); };
+		const LatencyHistogram & queueDelay(int priority) const { return m_queueDelay[priority]; };
+		void recordStageMemory(Stage stage, long long currentBytes, long long peakBytes);
+		void recordImageAllocations(unsigned long long allocations) { m_imageAllocations.record(allocations); };
+		const LatencyHistogram & imageAllocations() const { return m_imageAllocations; };
+		long long stageHeapPeakBytes(int stage) const { return m_stageHeapPeakBytes[stage].load(); };
+
+		void writePrometheus(std::ostream & out);
+		void writeJson(std::ostream & out);
+	};
+
+	Metrics & metrics();
+
+	/**
+	* \brief StageClock - Measures consecutive stages of one image: every lap records time since previous lap,
+	*and heap bytes of the calling thread (live at lap and peak during stage, both above image start).
+	*/
+	class StageClock
+	{
+	private:
+		boost::posix_time::ptime m_start;
+		boost::posix_time::ptime m_last;
+		std::vector<unsigned long long>* m_stageUs;//!< Optional per-image copy of stage times.
+		unsigned long long m_startAllocations;//!< Thread allocations when clock was created.
+		long long m_startBytes;//!< Thread live heap bytes when clock was created.
+		long long m_peakBytes;//!< Highest heap bytes above start in any finished stage.
+		unsigned long long m_carriedAllocations;//!< Allocations counted on threads which measured the image before.
+
+	public:
+		StageClock(std::vector<unsigned long long>* stageUs = NULL);
+
+		void suspend();
+		void resume();
+
+		unsigned long long lap(Metrics::Stage stage);
+		unsigned long long totalUs();
+		unsigned long long allocations();
+		long long peakBytes() const { return m_peakBytes; };
+	};
+
+	class MetricsExporter
+	{
+	private:
+		std::string m_path;//!< Output file (.json for JSON snapshot, otherwise Prometheus text format).
+		int m_periodMs;//!< Export period.
+		bool m_stop;
+		std::mutex m_lock;
+		std::condition_variable m_wake;
+		std::thread m_thread;
+
+		void exportLoop();
+
+	public:
+		MetricsExporter(std::string path, int periodMs);
+		~MetricsExporter();
+
+		void start();
+		void stop();
+		bool writeSnapshot();
+	};
+}
+#endif
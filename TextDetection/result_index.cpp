@@ -0,0 +1,335 @@
+#include "result_index.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+
+namespace
+{
+	/**
+	* \brief splitTabs - Method which splits index line into tab separated fields.
+	* \param [in] const std::string & line - index line.
+	* \return std::vector<std::string> - fields.
+	*/
+	std::vector<std::string> splitTabs(const std::string & line)
+	{
+		std::vector<std::string> fields;
+		std::string::size_type begin = 0;
+		while (true)
+		{
+			std::string::size_type end = line.find('\t', begin);
+			fields.push_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+			if (end == std::string::npos)
+				break;
+			begin = end + 1;
+		}
+		return fields;
+	}
+
+	/**
+	* \brief parseNumber - Method which parses whole field as a number.
+	* \param [in] const std::string & field - field.
+	* \param [in] bool hex - hexadecimal field.
+	* \param [out] T & value - parsed number.
+	* \return bool - false if field is not a number.
+	*/
+	template <class T>
+	bool parseNumber(const std::string & field, bool hex, T & value)
+	{
+		if (field.empty())
+			return false;
+		std::istringstream stream(field);
+		if (hex)
+			stream >> std::hex;
+		stream >> value;
+		return !stream.fail() && stream.eof();
+	}
+
+	/**
+	* \brief printable - Method which checks that text can be stored in one index field.
+	* \param [in] const std::string & text - image or output name.
+	* \return bool - false if text is empty or contains tab or line break.
+	*/
+	bool printable(const std::string & text)
+	{
+		return !text.empty() && text.find_first_of("\t\r\n") == std::string::npos;
+	}
+
+	/**
+	* \brief readFile - Method which reads whole file.
+	* \param [in] const boost::filesystem::path & path - file path.
+	* \param [out] std::vector<uchar> & data - file bytes.
+	* \return bool - false if file can not be read.
+	*/
+	bool readFile(const boost::filesystem::path & path, std::vector<uchar> & data)
+	{
+		std::ifstream file(path.string().c_str(), std::ios::in | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.seekg(0, std::ios::end);
+		std::streamoff size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		if (size < 0)
+		{
+			return false;
+		}
+		data.resize((size_t)size);
+		if (size > 0)
+		{
+			file.read((char *)&data[0], size);
+		}
+		return !file.fail();
+	}
+}
+
+
+/**
+* \brief fnv1aHash - Method which computes 64-bit FNV-1a hash of bytes.
+* \param [in] const void * data - bytes.
+* \param [in] size_t size - number of bytes.
+* \param [in] boost::uint64_t hash - initial value (offset basis, or hash of preceding bytes).
+* \return boost::uint64_t - hash.
+*/
+boost::uint64_t protech::fnv1aHash(const void * data, size_t size, boost::uint64_t hash)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+/**
+* \brief parseLine - Method which reads one index line ("name, content hash, config hash, size, modified, outputs...").
+* \param [in] const std::string & line - index line.
+* \return bool - false if line is malformed (e.g. torn by an interrupted run), entry is not changed then.
+*/
+bool protech::ResultIndex::parseLine(const std::string & line)
+{
+	std::vector<std::string> fields = splitTabs(line);
+	if (fields.size() < 5 || fields[0].empty())
+	{
+		return false;
+	}
+
+	IndexEntry entry;
+	if (!parseNumber(fields[1], true, entry.contentHash) || !parseNumber(fields[2], true, entry.configHash)
+		|| !parseNumber(fields[3], false, entry.size) || !parseNumber(fields[4], false, entry.modified))
+	{
+		return false;
+	}
+	entry.outputs.assign(fields.begin() + 5, fields.end());
+	m_entries[fields[0]] = entry;
+	return true;
+}
+
+
+/**
+* \brief writeLine - Method which writes one index line.
+* \param [in] std::ostream & out - index stream.
+* \param [in] const std::string & name - image name.
+* \param [in] const IndexEntry & entry - image entry.
+*/
+void protech::ResultIndex::writeLine(std::ostream & out, const std::string & name, const IndexEntry & entry) const
+{
+	out << name << '\t' << std::hex << std::setw(16) << std::setfill('0') << entry.contentHash
+		<< '\t' << std::setw(16) << entry.configHash << std::dec << std::setfill(' ')
+		<< '\t' << entry.size << '\t' << entry.modified;
+	for (size_t i = 0; i < entry.outputs.size(); i++)
+	{
+		out << '\t' << entry.outputs[i];
+	}
+	out << '\n';
+}
+
+
+/**
+* \brief open - Method which loads index of given shard from output folder and opens it for appending.
+* \param [in] std::string outputFolder - output folder.
+* \param [in] const ShardSpec & spec - shard.
+* \param [in] bool verifyContent - hash every file, even when size and modification time are unchanged.
+* \return bool - true if index is opened, otherwise false.
+*/
+bool protech::ResultIndex::open(std::string outputFolder, const ShardSpec & spec, bool verifyContent)
+{
+	m_outputFolder = outputFolder;
+	m_path = outputFolder + "//index" + shardSuffix(spec) + ".tsv";
+	m_verifyContent = verifyContent;
+	m_entries.clear();
+	m_seen.clear();
+
+	bool terminated = true;
+	bool empty = true;
+	{
+		std::ifstream file(m_path.c_str(), std::ios::in | std::ios::binary);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			empty = false;
+			terminated = !file.eof();
+			if (!line.empty() && line[line.size() - 1] == '\r')
+				line.erase(line.size() - 1);
+			if (line.empty() || line[0] == '#')
+				continue;
+			parseLine(line);
+		}
+	}
+
+	m_file.open(m_path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+	if (!m_file.is_open())
+	{
+		return false;
+	}
+	if (empty)
+	{
+		m_file << "# name\tcontent\tconfig\tsize\tmodified\toutputs" << std::endl;
+	}
+	else if (!terminated)
+	{
+		// torn last line of an interrupted run must not swallow the next record
+		m_file << std::endl;
+	}
+	return true;
+}
+
+
+/**
+* \brief upToDate - Method which checks whether outputs of an image are current.
+*File images whose size or modification time changed are read into image.data for hashing, so the image is not
+*read again when it is processed. An image with the same bytes and a new modification time is recorded again.
+* \param [in, out] SourceImage & image - image (file bytes may be loaded).
+* \param [in] boost::uint64_t configHash - hash of configuration used for this image.
+* \param [in] const std::vector<std::string> & outputs - output files of this image, relative to output folder.
+* \param [out] IndexEntry & entry - current state of the image, to be recorded when it is processed.
+* \return bool - true if image can be skipped, otherwise false.
+*/
+bool protech::ResultIndex::upToDate(SourceImage & image, boost::uint64_t configHash, const std::vector<std::string> & outputs, IndexEntry & entry)
+{
+	namespace fs = boost::filesystem;
+
+	m_seen.insert(image.name);
+	entry = IndexEntry();
+	entry.configHash = configHash;
+	entry.outputs = outputs;
+
+	std::map<std::string, IndexEntry>::const_iterator recorded = m_entries.find(image.name);
+	bool known = (recorded != m_entries.end());
+
+	bool statMatches = false;
+	if (image.data.empty() && !image.path.empty())
+	{
+		boost::system::error_code error;
+		entry.size = fs::file_size(image.path, error);
+		if (error)
+			return false;
+		entry.modified = (long long)fs::last_write_time(image.path, error);
+		if (error)
+			return false;
+		statMatches = !m_verifyContent && known && recorded->second.size == entry.size && recorded->second.modified == entry.modified;
+	}
+
+	if (statMatches)
+	{
+		entry.contentHash = recorded->second.contentHash;
+	}
+	else
+	{
+		if (image.data.empty() && (image.path.empty() || !readFile(image.path, image.data)))
+		{
+			image.data.clear();
+			return false;
+		}
+		entry.size = image.data.size();
+		entry.contentHash = fnv1aHash(image.data.empty() ? NULL : &image.data[0], image.data.size());
+	}
+
+	if (!known || recorded->second.contentHash != entry.contentHash || recorded->second.configHash != entry.configHash
+		|| recorded->second.outputs != entry.outputs)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < outputs.size(); i++)
+	{
+		if (!fs::exists(fs::path(m_outputFolder) / outputs[i]))
+		{
+			return false;
+		}
+	}
+
+	if (recorded->second.size != entry.size || recorded->second.modified != entry.modified)
+	{
+		record(image.name, entry);
+	}
+	return true;
+}
+
+
+/**
+* \brief record - Method which records finished image (line is flushed, so interrupted runs keep their index).
+*Not thread safe, images are recorded by the thread which collects results.
+* \param [in] const std::string & name - image name.
+* \param [in] const IndexEntry & entry - image state returned by upToDate.
+*/
+void protech::ResultIndex::record(const std::string & name, const IndexEntry & entry)
+{
+	if (!m_file.is_open() || !printable(name))
+	{
+		return;
+	}
+	for (size_t i = 0; i < entry.outputs.size(); i++)
+	{
+		if (!printable(entry.outputs[i]))
+			return;
+	}
+	m_entries[name] = entry;
+	m_seen.insert(name);
+	writeLine(m_file, name, entry);
+	m_file.flush();
+}
+
+
+/**
+* \brief compact - Method which rewrites index with one line per image of current run.
+*Call it only after a completed run, images which were not listed are dropped.
+* \return bool - false if index can not be rewritten (appended index is kept then).
+*/
+bool protech::ResultIndex::compact()
+{
+	if (!m_file.is_open())
+	{
+		return false;
+	}
+
+	std::string tmpPath = m_path + ".tmp";
+	{
+		std::ofstream file(tmpPath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file << "# name\tcontent\tconfig\tsize\tmodified\toutputs\n";
+		for (std::map<std::string, IndexEntry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			if (m_seen.count(it->first))
+				writeLine(file, it->first, it->second);
+		}
+		file.flush();
+		if (file.fail())
+		{
+			return false;
+		}
+	}
+
+	m_file.close();
+	boost::system::error_code error;
+	boost::filesystem::rename(tmpPath, m_path, error);
+	m_file.open(m_path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+	return !error && m_file.is_open();
+}
@@ -0,0 +1,75 @@
+/*!\file result_index.h
+*
+*	Incremental reprocessing index used in TextDetection project.
+*	With --incremental every finished image is recorded in OUTPUT_FOLDER/index[_shard_i_of_N].tsv: image name,
+*	FNV-1a hash of its bytes, hash of the configuration which produced its outputs (preset, output modes, deadline,
+*	triage, languages of the image), file size and modification time, and its output files.
+*	An image is skipped when content and configuration hashes match the index and its outputs still exist, so
+*	an unchanged folder is not processed again, a changed preset or language recomputes the affected images and
+*	an interrupted run continues with images it did not finish (every line is flushed).
+*	Bytes of a file are hashed only when its size or modification time differ from the index (--incremental=verify
+*	hashes every file); archive and stream entries are always hashed. Partial (deadline) and failed images are
+*	not recorded. Lines are appended and the last line of an image wins; a completed run rewrites the index with
+*	images of the run. Deleting the index file forces a full run.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef RESULT_INDEX_H
+#define RESULT_INDEX_H
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "image_source.h"
+#include "shard.h"
+
+
+namespace protech
+{
+	/**
+	* \brief IndexEntry - Recorded state of one image.
+	*/
+	struct IndexEntry
+	{
+		boost::uint64_t contentHash;//!< FNV-1a hash of image bytes.
+		boost::uint64_t configHash;//!< Hash of configuration which produced the outputs.
+		boost::uint64_t size;//!< Image size in bytes.
+		long long modified;//!< File modification time (0 for archive and stream entries).
+		std::vector<std::string> outputs;//!< Output files, relative to output folder.
+
+		IndexEntry() : contentHash(0), configHash(0), size(0), modified(0){};
+	};
+
+	boost::uint64_t fnv1aHash(const void * data, size_t size, boost::uint64_t hash = 14695981039346656037ULL);
+
+	class ResultIndex
+	{
+	private:
+		std::string m_outputFolder;
+		std::string m_path;//!< Index file.
+		std::ofstream m_file;//!< Index opened for appending.
+		std::map<std::string, IndexEntry> m_entries;//!< Latest entry of every image.
+		std::set<std::string> m_seen;//!< Images of current run.
+		bool m_verifyContent;//!< Hash every file, even when size and modification time are unchanged.
+
+		bool parseLine(const std::string & line);
+		void writeLine(std::ostream & out, const std::string & name, const IndexEntry & entry) const;
+
+	public:
+		ResultIndex() : m_verifyContent(false){};
+
+		bool open(std::string outputFolder, const ShardSpec & spec, bool verifyContent);
+		bool isOpen() const { return m_file.is_open(); };
+		size_t size() const { return m_entries.size(); };
+
+		bool upToDate(SourceImage & image, boost::uint64_t configHash, const std::vector<std::string> & outputs, IndexEntry & entry);
+		void record(const std::string & name, const IndexEntry & entry);
+		bool compact();
+	};
+}
+#endif
@@ -0,0 +1,399 @@
+#include "results_writer.h"
+#include "memory_stats.h"
+#include "metrics.h"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+
+/**
+* \brief jsonString - Method which quotes and escapes a string for JSON.
+* \param [in] const std::string & text - UTF-8 text.
+* \return std::string - JSON string literal.
+*/
+static std::string jsonString(const std::string & text)
+{
+	std::string out = "\"";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += (char)c;
+		}
+		else if (c == '\n')
+		{
+			out += "\\n";
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			sprintf(escaped, "\\u%04x", c);
+			out += escaped;
+		}
+		else
+		{
+			out += (char)c;
+		}
+	}
+	out += "\"";
+	return out;
+}
+
+
+/**
+* \brief statusName - Method which returns name of region status used in results file.
+* \param [in] int status - TextRegionResult::Status.
+* \return const char* - status name.
+*/
+static const char* statusName(int status)
+{
+	switch (status)
+	{
+	case protech::TextRegionResult::REGION_UNVERIFIED:
+		return "unverified";
+	case protech::TextRegionResult::REGION_SKIPPED:
+		return "skipped";
+	default:
+		return "verified";
+	}
+}
+
+
+/**
+* \brief encodeMaskRle - Method which run-length encodes binary mask in row-major order.
+* \param [in] const cv::Mat & mask - CV_8UC1 mask, every non-zero pixel is set.
+* \param [out] std::vector<int> & counts - alternating run lengths, first run counts zeros.
+*/
+void protech::encodeMaskRle(const cv::Mat & mask, std::vector<int> & counts)
+{
+	counts.clear();
+	bool value = false;
+	int run = 0;
+	for (int i = 0; i < mask.rows; i++)
+	{
+		const uchar* row = mask.ptr<uchar>(i);
+		for (int j = 0; j < mask.cols; j++)
+		{
+			if ((row[j] != 0) != value)
+			{
+				counts.push_back(run);
+				value = !value;
+				run = 0;
+			}
+			run++;
+		}
+	}
+	counts.push_back(run);
+}
+
+
+/**
+* \brief decodeMaskRle - Method which rebuilds mask from run lengths.
+* \param [in] const std::vector<int> & counts - alternating run lengths, first run counts zeros.
+* \param [in] cv::Size size - mask size.
+* \param [out] cv::Mat & mask - CV_8UC1 mask with 255 for set pixels.
+* \return bool - false if runs do not cover the mask exactly.
+*/
+bool protech::decodeMaskRle(const std::vector<int> & counts, cv::Size size, cv::Mat & mask)
+{
+	mask = cv::Mat::zeros(size, CV_8UC1);
+	size_t total = (size_t)size.width * size.height;
+	size_t position = 0;
+	for (size_t k = 0; k < counts.size(); k++)
+	{
+		if (counts[k] < 0 || position + counts[k] > total)
+		{
+			return false;
+		}
+		if (k % 2 == 1)
+		{
+			for (size_t p = position; p < position + counts[k]; p++)
+			{
+				mask.at<uchar>((int)(p / size.width), (int)(p % size.width)) = 255;
+			}
+		}
+		position += counts[k];
+	}
+	return position == total;
+}
+
+
+/**
+* \brief open - Method which opens results file for appending.
+* \param [in] const std::string & path - JSON Lines file.
+* \return bool - false if file can not be opened.
+*/
+bool protech::ResultsWriter::open(const std::string & path)
+{
+	m_path = path;
+	m_file.open(path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+	return m_file.is_open();
+}
+
+
+/**
+* \brief write - Method which appends one image record (thread safe).
+*Record is flushed as a single write, so an interrupted run leaves at most its last record torn.
+* \param [in] const std::string & image - image file name.
+* \param [in] const TextDetectionResult & result - detection result (with mask if it was requested).
+* \param [in] long decodeMs - image decode time.
+*/
+void protech::ResultsWriter::write(const std::string & image, const TextDetectionResult & result, long decodeMs)
+{
+	std::ostringstream record;
+	int acceptedCount = 0;
+	for (size_t i = 0; i < result.regions.size(); i++)
+	{
+		if (result.regions[i].accepted)
+			acceptedCount++;
+	}
+
+	record << "{\"image\": " << jsonString(image) << ", \"width\": " << result.size.width << ", \"height\": " << result.size.height
+		<< ", \"partial\": " << (result.partial ? "true" : "false") << ", \"decode_ms\": " << decodeMs;
+
+	record << ", \"stages_us\": {";
+	bool first = true;
+	for (size_t s = 0; s < result.stageUs.size(); s++)
+	{
+		if (s == Metrics::STAGE_DECODE)
+			continue;
+		record << (first ? "" : ", ") << "\"" << Metrics::stageName((int)s) << "\": " << result.stageUs[s];
+		first = false;
+	}
+	record << "}, \"languages\": [";
+	for (size_t l = 0; l < result.languages.size(); l++)
+	{
+		record << (l ? ", " : "") << jsonString(result.languages[l]);
+	}
+	if (allocationTrackingEnabled())
+		record << "], \"allocations\": " << result.allocations << ", \"peak_heap_bytes\": " << result.peakBytes;
+	else
+		record << "], \"allocations\": null, \"peak_heap_bytes\": null";
+	record << ", \"triaged\": " << (result.triaged ? "true" : "false") << ", \"triage_score\": " << result.triageScore;
+
+	record << ", \"regions_count\": " << result.regions.size() << ", \"accepted_count\": " << acceptedCount << ", \"regions\": [";
+	for (size_t i = 0; i < result.regions.size(); i++)
+	{
+		const TextRegionResult & region = result.regions[i];
+		record << (i ? ", " : "") << "{\"x\": " << region.rect.x << ", \"y\": " << region.rect.y << ", \"w\": " << region.rect.width << ", \"h\": " << region.rect.height
+			<< ", \"words\": " << region.wordsCount << ", \"lines\": " << region.linesCount << ", \"status\": \"" << statusName(region.status) << "\""
+			<< ", \"accepted\": " << (region.accepted ? "true" : "false") << ", \"language\": " << jsonString(region.language) << ", \"text\": " << jsonString(region.text) << "}";
+	}
+	record << "]";
+
+	if (result.mask.data != NULL)
+	{
+		std::vector<int> counts;
+		encodeMaskRle(result.mask, counts);
+		record << ", \"mask\": {\"size\": [" << result.mask.rows << ", " << result.mask.cols << "], \"counts\": [";
+		for (size_t k = 0; k < counts.size(); k++)
+		{
+			record << (k ? "," : "") << counts[k];
+		}
+		record << "]}";
+	}
+	record << "}\n";
+
+	std::string line = record.str();
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_file.write(line.data(), line.size());
+	m_file.flush();
+}
+
+
+/**
+* \brief recordImage - Method which returns image key of a complete record line.
+* \param [in] const std::string & line - record line (without line break).
+* \param [out] std::string & image - escaped image name, as written in the record.
+* \return bool - false if line is not a complete record (e.g. torn by an interrupted run).
+*/
+static bool recordImage(const std::string & line, std::string & image)
+{
+	const std::string prefix = "{\"image\": \"";
+	if (line.compare(0, prefix.size(), prefix) != 0 || line[line.size() - 1] != '}')
+	{
+		return false;
+	}
+	for (size_t i = prefix.size(); i < line.size(); i++)
+	{
+		if (line[i] == '\\')
+		{
+			i++;
+		}
+		else if (line[i] == '"')
+		{
+			image = line.substr(prefix.size(), i - prefix.size());
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+* \brief compact - Method which rewrites results file with the last record of every image (in order of last records).
+*Call it only after a completed run; torn records are dropped.
+* \return bool - false if file can not be rewritten (appended file is kept then).
+*/
+bool protech::ResultsWriter::compact()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!m_file.is_open())
+	{
+		return false;
+	}
+	m_file.flush();
+
+	// first pass finds last record of every image, records are not kept in memory (masks can be large)
+	std::map<std::string, size_t> lastRecord;
+	{
+		std::ifstream file(m_path.c_str(), std::ios::in | std::ios::binary);
+		std::string line;
+		std::string image;
+		for (size_t i = 0; std::getline(file, line); i++)
+		{
+			if (recordImage(line, image))
+				lastRecord[image] = i;
+		}
+	}
+
+	std::string tmpPath = m_path + ".tmp";
+	{
+		std::ifstream file(m_path.c_str(), std::ios::in | std::ios::binary);
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!out.is_open())
+		{
+			return false;
+		}
+		std::string line;
+		std::string image;
+		for (size_t i = 0; std::getline(file, line); i++)
+		{
+			if (recordImage(line, image) && lastRecord[image] == i)
+				out << line << '\n';
+		}
+		out.flush();
+		if (out.fail())
+		{
+			return false;
+		}
+	}
+
+	m_file.close();
+	boost::system::error_code error;
+	boost::filesystem::rename(tmpPath, m_path, error);
+	m_file.open(m_path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+	return !error && m_file.is_open();
+}
+
+
+/**
+* \brief renderResults - Method which rebuilds _masked and _rects images from results file.
+*Rects are drawn as in detection: green accepted, red rejected, yellow skipped or unverified
+*(intermediate candidate boxes are not stored, so they are not drawn).
+* \param [in] const std::string & resultsPath - JSON Lines results file.
+* \param [in] const std::string & inputFolder - folder with original images.
+* \param [in] const std::string & outputFolder - folder for overlay images.
+* \return int - exit code (0 if all records were rendered).
+*/
+int protech::renderResults(const std::string & resultsPath, const std::string & inputFolder, const std::string & outputFolder)
+{
+	std::ifstream results(resultsPath.c_str());
+	if (!results)
+	{
+		std::cout << "Cannot open results file " << resultsPath << "..." << std::endl;
+		return -1;
+	}
+
+	int renderedCount = 0;
+	int failedCount = 0;
+	std::string line;
+	while (std::getline(results, line))
+	{
+		if (line.empty())
+		{
+			continue;
+		}
+
+		boost::property_tree::ptree record;
+		try
+		{
+			std::istringstream lineStream(line);
+			boost::property_tree::read_json(lineStream, record);
+
+			boost::filesystem::path imagePath = boost::filesystem::path(inputFolder) / record.get<std::string>("image", "");
+			cv::Mat original = cv::imread(imagePath.string());
+			if (original.data == NULL)
+			{
+				std::cout << "Cannot read " << imagePath.string() << ", skipping..." << std::endl;
+				failedCount++;
+				continue;
+			}
+
+			cv::Size size(record.get<int>("width", TextDetector::WORKING_WIDTH), record.get<int>("height", 0));
+			if (size.height <= 0)
+				size.height = (int)(original.rows / (original.cols / (double)TextDetector::WORKING_WIDTH));
+			cv::Mat large;
+			cv::resize(original, large, size, 0, 0, CV_INTER_NN);
+
+			cv::Mat rects = large.clone();
+			boost::property_tree::ptree noRegions;
+			const boost::property_tree::ptree & regions = record.get_child("regions", noRegions);
+			for (boost::property_tree::ptree::const_iterator it = regions.begin(); it != regions.end(); ++it)
+			{
+				const boost::property_tree::ptree & region = it->second;
+				cv::Rect rect(region.get<int>("x"), region.get<int>("y"), region.get<int>("w"), region.get<int>("h"));
+				cv::Scalar colour(0, 0, 255);
+				if (region.get<bool>("accepted", false))
+					colour = cv::Scalar(0, 255, 0);
+				else if (region.get<std::string>("status", "verified") != "verified")
+					colour = cv::Scalar(0, 255, 255);
+				cv::rectangle(rects, rect, colour, 2);
+			}
+
+			cv::Mat masked = large;
+			boost::optional<boost::property_tree::ptree &> maskRecord = record.get_child_optional("mask");
+			if (maskRecord)
+			{
+				std::vector<int> counts;
+				const boost::property_tree::ptree & countsRecord = maskRecord->get_child("counts");
+				for (boost::property_tree::ptree::const_iterator it = countsRecord.begin(); it != countsRecord.end(); ++it)
+				{
+					counts.push_back(it->second.get_value<int>());
+				}
+
+				cv::Mat mask;
+				if (!decodeMaskRle(counts, size, mask))
+				{
+					std::cout << "Bad mask for " << imagePath.string() << "..." << std::endl;
+					failedCount++;
+					continue;
+				}
+				cv::Mat mask3C;
+				cv::cvtColor(mask, mask3C, CV_GRAY2BGR);
+				masked = large + mask3C;
+			}
+
+			std::string name = imagePath.stem().string();
+			cv::imwrite(outputFolder + "//" + name + "_masked.jpg", masked);
+			cv::imwrite(outputFolder + "//" + name + "_rects.jpg", rects);
+			renderedCount++;
+		}
+		catch (std::exception & ex)
+		{
+			std::cout << "Bad record: " << ex.what() << std::endl;
+			failedCount++;
+		}
+	}
+
+	std::cout << "Rendered " << renderedCount << " images, " << failedCount << " failed" << std::endl;
+	return (failedCount > 0) ? 1 : 0;
+}
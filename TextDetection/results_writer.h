@@ -0,0 +1,56 @@
+/*!\file results_writer.h
+*
+*	Header for ResultsWriter (compact detection results) used in TextDetection project.
+*	Instead of _masked and _rects images, one JSON record per image is appended to a JSON Lines file:
+*
+*	  {"image": "<file>", "width": W, "height": H, "partial": false, "decode_ms": D,
+*	   "stages_us": {"<stage>": us, ...}, "languages": ["eng", ...], "allocations": A, "peak_heap_bytes": B,
+*	   "triaged": false, "triage_score": S, "regions_count": N, "accepted_count": K,
+*	   "regions": [{"x": , "y": , "w": , "h": , "words": , "lines": , "status": "verified", "accepted": true, "language": "eng", "text": ""}, ...],
+*	   "mask": {"size": [H, W], "counts": [zeros, ones, zeros, ...]}}
+*
+*	allocations and peak_heap_bytes are null when allocation tracking is not compiled in (see memory_stats.h).
+*	Rects and mask are at working resolution (TextDetector::WORKING_WIDTH). The mask is run-length encoded
+*	in row-major order, runs alternate starting with a (possibly empty) run of zeros.
+*	Records are appended, so a reprocessed image (e.g. changed with --incremental) has several records and the last
+*	one is current. A completed batch run compacts the file to the last record of every image; after an interrupted
+*	run readers must keep only the last record per image themselves.
+*	renderResults rebuilds _masked and _rects overlay images from the records and the original images.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef RESULTS_WRITER_H
+#define RESULTS_WRITER_H
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "textDetector.h"
+
+
+namespace protech
+{
+	void encodeMaskRle(const cv::Mat & mask, std::vector<int> & counts);
+	bool decodeMaskRle(const std::vector<int> & counts, cv::Size size, cv::Mat & mask);
+
+	class ResultsWriter
+	{
+	private:
+		std::string m_path;//!< Results file path.
+		std::ofstream m_file;//!< Results file, opened for appending.
+		std::mutex m_lock;//!< Records are written whole, one at a time.
+
+	public:
+		ResultsWriter(){};
+
+		bool open(const std::string & path);
+		bool isOpen() const { return m_file.is_open(); };
+		void write(const std::string & image, const TextDetectionResult & result, long decodeMs);
+		bool compact();
+	};
+
+	int renderResults(const std::string & resultsPath, const std::string & inputFolder, const std::string & outputFolder);
+}
+#endif
@@ -0,0 +1,248 @@
+#include "shard.h"
+#include "image_files.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+
+/**
+* \brief parseShardSpec - Method which parses shard argument "i/N".
+* \param [in] const std::string & text - shard argument, e.g. "0/4".
+* \param [out] ShardSpec & spec - parsed shard.
+* \return bool - true if argument is valid (0 <= i < N), otherwise false.
+*/
+bool protech::parseShardSpec(const std::string & text, ShardSpec & spec)
+{
+	std::string::size_type pos = text.find('/');
+	if (pos == std::string::npos)
+	{
+		return false;
+	}
+
+	try
+	{
+		spec.index = boost::lexical_cast<int>(text.substr(0, pos));
+		spec.count = boost::lexical_cast<int>(text.substr(pos + 1));
+	}
+	catch (boost::bad_lexical_cast &)
+	{
+		return false;
+	}
+
+	return (spec.count > 0) && (spec.index >= 0) && (spec.index < spec.count);
+}
+
+
+/**
+* \brief stablePathHash - Method which computes 64-bit FNV-1a hash of relative path.
+*Path separators are normalized to '/', so Windows and Linux nodes agree.
+* \param [in] const std::string & relativePath - path relative to input folder.
+* \return boost::uint64_t - hash.
+*/
+boost::uint64_t protech::stablePathHash(const std::string & relativePath)
+{
+	boost::uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < relativePath.size(); i++)
+	{
+		unsigned char c = (unsigned char)relativePath[i];
+		if (c == '\\')
+		{
+			c = '/';
+		}
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+/**
+* \brief inShard - Method which checks whether image belongs to given shard.
+* \param [in] const std::string & relativePath - path relative to input folder.
+* \param [in] const ShardSpec & spec - shard.
+* \return bool - true if image is processed by this shard, otherwise false.
+*/
+bool protech::inShard(const std::string & relativePath, const ShardSpec & spec)
+{
+	if (spec.count <= 1)
+	{
+		return true;
+	}
+	return (int)(stablePathHash(relativePath) % (boost::uint64_t)spec.count) == spec.index;
+}
+
+
+/**
+* \brief shardSuffix - Method which returns file name suffix of given shard.
+* \param [in] const ShardSpec & spec - shard.
+* \return std::string - e.g. "_shard_0_of_4", or empty string without sharding.
+*/
+std::string protech::shardSuffix(const ShardSpec & spec)
+{
+	if (spec.count <= 1)
+	{
+		return "";
+	}
+	return "_shard_" + boost::lexical_cast<std::string>(spec.index) + "_of_" + boost::lexical_cast<std::string>(spec.count);
+}
+
+
+/**
+* \brief open - Method which opens (appends to) manifest of given shard in output folder.
+* \param [in] std::string outputFolder - output folder.
+* \param [in] const ShardSpec & spec - shard.
+* \return bool - true if manifest is opened, otherwise false.
+*/
+bool protech::ShardManifest::open(std::string outputFolder, const ShardSpec & spec)
+{
+	m_file.open((outputFolder + "//manifest" + shardSuffix(spec) + ".csv").c_str(), std::ios::app);
+	return m_file.is_open();
+}
+
+
+/**
+* \brief write - Method which records one processed image (line is flushed, so interrupted runs keep their manifest).
+* \param [in] const std::string & relativePath - path relative to input folder.
+* \param [in] long imreadMs - image read time.
+* \param [in] long detectMs - text detection time.
+* \param [in] const std::string & status - "ok", "unchanged" (skipped by result index) or error description.
+*/
+void protech::ShardManifest::write(const std::string & relativePath, long imreadMs, long detectMs, const std::string & status)
+{
+	if (!m_file.is_open())
+	{
+		return;
+	}
+	m_file << relativePath << ";" << imreadMs << ";" << detectMs << ";" << status << std::endl;
+}
+
+
+namespace
+{
+	/**
+	* \brief appendLines - Method which appends all non-empty lines of a file.
+	* \param [in] const boost::filesystem::path & path - file path.
+	* \param [out] std::vector<std::string> & lines - lines.
+	*/
+	void appendLines(const boost::filesystem::path & path, std::vector<std::string> & lines)
+	{
+		std::ifstream file(path.string().c_str());
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (!line.empty())
+			{
+				lines.push_back(line);
+			}
+		}
+	}
+
+	/**
+	* \brief manifestLess - Natural order of manifest lines by relative path.
+	*/
+	bool manifestLess(const std::string & a, const std::string & b)
+	{
+		return protech::naturalLess(a.data(), a.find(';'), b.data(), b.find(';'));
+	}
+}
+
+
+/**
+* \brief mergeShards - Method which combines shard manifests and execution time logs.
+*Writes manifest.csv (natural order, one line per image) and ExecutionTime.csv (time order) into output folder,
+*both are rewritten, so merging again gives the same files.
+* \param [in] std::string outputFolder - folder for merged files.
+* \param [in] const std::vector<std::string> & shardFolders - folders with manifest_shard_*.csv and ExecutionTime_shard_*.csv files.
+* \return int - 0 on success, -1 if no manifest is found.
+*/
+int protech::mergeShards(std::string outputFolder, const std::vector<std::string> & shardFolders)
+{
+	namespace fs = boost::filesystem;
+
+	std::vector<std::string> manifestLines;
+	std::vector<std::string> executionLines;
+	int manifestsCount = 0;
+
+	for (size_t f = 0; f < shardFolders.size(); f++)
+	{
+		if (!fs::is_directory(shardFolders[f]))
+		{
+			std::cout << "Not a folder: " << shardFolders[f] << std::endl;
+			continue;
+		}
+		fs::directory_iterator end_iter;
+		for (fs::directory_iterator dir_iter(shardFolders[f]); dir_iter != end_iter; ++dir_iter)
+		{
+			std::string name = dir_iter->path().filename().string();
+			if (name.compare(0, 15, "manifest_shard_") == 0)
+			{
+				appendLines(dir_iter->path(), manifestLines);
+				manifestsCount++;
+			}
+			else if (name.compare(0, 20, "ExecutionTime_shard_") == 0)
+			{
+				appendLines(dir_iter->path(), executionLines);
+			}
+		}
+	}
+
+	if (manifestsCount == 0)
+	{
+		std::cout << "No shard manifest found..." << std::endl;
+		return -1;
+	}
+
+	std::stable_sort(manifestLines.begin(), manifestLines.end(), manifestLess);
+	std::stable_sort(executionLines.begin(), executionLines.end());
+
+	int duplicates = 0;
+	int failed = 0;
+	int unchanged = 0;
+	long imreadTotal = 0;
+	long detectTotal = 0;
+	std::ofstream manifest((outputFolder + "//manifest.csv").c_str());
+	for (size_t i = 0; i < manifestLines.size(); i++)
+	{
+		std::istringstream fields(manifestLines[i]);
+		std::string path, imreadMs, detectMs, status;
+		std::getline(fields, path, ';');
+		std::getline(fields, imreadMs, ';');
+		std::getline(fields, detectMs, ';');
+		std::getline(fields, status);
+
+		if (i + 1 < manifestLines.size() && manifestLines[i + 1].compare(0, path.size() + 1, path + ";") == 0)
+		{
+			// reprocessed image (e.g. shard restarted), last record wins
+			duplicates++;
+			continue;
+		}
+		if (status == "unchanged")
+		{
+			unchanged++;
+		}
+		else if (status != "ok")
+		{
+			failed++;
+		}
+		imreadTotal += atol(imreadMs.c_str());
+		detectTotal += atol(detectMs.c_str());
+		manifest << manifestLines[i] << std::endl;
+	}
+
+	std::ofstream execution((outputFolder + "//ExecutionTime.csv").c_str(), std::ios::trunc);
+	for (size_t i = 0; i < executionLines.size(); i++)
+	{
+		execution << executionLines[i] << std::endl;
+	}
+
+	std::cout << "Merged " << manifestsCount << " manifests: " << manifestLines.size() - duplicates << " images, " << unchanged << " unchanged, " << failed << " failed, " << duplicates << " processed more than once" << std::endl;
+	std::cout << "Total imread: " << imreadTotal << " ms, total detection: " << detectTotal << " ms" << std::endl;
+
+	return 0;
+}
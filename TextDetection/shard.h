@@ -0,0 +1,50 @@
+/*!\file shard.h
+*
+*	Deterministic sharding of input images across processes and nodes used in TextDetection project.
+*	An image belongs to shard i of N when FNV-1a hash of its relative path modulo N equals i,
+*	so the split does not depend on directory order and needs no coordination.
+*	Every shard writes its own manifest (and execution time log); mergeShards combines them.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+
+namespace protech
+{
+	/**
+	* \brief ShardSpec - Shard index (0 based) and shards count.
+	*/
+	struct ShardSpec
+	{
+		int index;//!< Shard index, 0 <= index < count.
+		int count;//!< Shards count, 1 means no sharding.
+	};
+
+	bool parseShardSpec(const std::string & text, ShardSpec & spec);
+	boost::uint64_t stablePathHash(const std::string & relativePath);
+	bool inShard(const std::string & relativePath, const ShardSpec & spec);
+	std::string shardSuffix(const ShardSpec & spec);
+
+	class ShardManifest
+	{
+	private:
+		std::ofstream m_file;//!< Manifest file, one line per processed image.
+
+	public:
+		ShardManifest(){};
+
+		bool open(std::string outputFolder, const ShardSpec & spec);
+		void write(const std::string & relativePath, long imreadMs, long detectMs, const std::string & status);
+	};
+
+	int mergeShards(std::string outputFolder, const std::vector<std::string> & shardFolders);
+}
+#endif
@@ -0,0 +1,260 @@
+#include "striped_stages.h"
+
+#include <cfloat>
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+namespace
+{
+	/**
+	* \brief stripeRows - Method which returns first and last+1 row of a stripe.
+	* \param [in] int rows - image height.
+	* \param [in] int stripes - number of stripes.
+	* \param [in] int s - stripe index.
+	* \param [out] int & begin - first row.
+	* \param [out] int & end - last row + 1.
+	*/
+	void stripeRows(int rows, int stripes, int s, int & begin, int & end)
+	{
+		begin = (int)((long long)rows * s / stripes);
+		end = (int)((long long)rows * (s + 1) / stripes);
+	}
+
+	class GrayBody : public cv::ParallelLoopBody
+	{
+	private:
+		const cv::Mat & m_src;
+		cv::Mat & m_dst;
+		int m_stripes;
+
+	public:
+		GrayBody(const cv::Mat & src, cv::Mat & dst, int stripes) : m_src(src), m_dst(dst), m_stripes(stripes){};
+
+		void operator()(const cv::Range & range) const
+		{
+			for (int s = range.start; s < range.end; s++)
+			{
+				int begin, end;
+				stripeRows(m_src.rows, m_stripes, s, begin, end);
+				cv::Mat dstStripe = m_dst.rowRange(begin, end);
+				cv::cvtColor(m_src.rowRange(begin, end), dstStripe, CV_BGR2GRAY);
+			}
+		}
+	};
+
+	class MorphologyBody : public cv::ParallelLoopBody
+	{
+	private:
+		const cv::Mat & m_src;
+		cv::Mat & m_dst;
+		int m_op;
+		const cv::Mat & m_kernel;
+		int m_halo;//!< Rows read above and below each stripe.
+		int m_stripes;
+
+	public:
+		MorphologyBody(const cv::Mat & src, cv::Mat & dst, int op, const cv::Mat & kernel, int halo, int stripes)
+			: m_src(src), m_dst(dst), m_op(op), m_kernel(kernel), m_halo(halo), m_stripes(stripes){};
+
+		void operator()(const cv::Range & range) const
+		{
+			for (int s = range.start; s < range.end; s++)
+			{
+				int begin, end;
+				stripeRows(m_src.rows, m_stripes, s, begin, end);
+				int haloBegin = begin - m_halo < 0 ? 0 : begin - m_halo;
+				int haloEnd = end + m_halo > m_src.rows ? m_src.rows : end + m_halo;
+
+				cv::Mat stripe;
+				cv::morphologyEx(m_src.rowRange(haloBegin, haloEnd), stripe, m_op, m_kernel);
+				cv::Mat dstStripe = m_dst.rowRange(begin, end);
+				stripe.rowRange(begin - haloBegin, end - haloBegin).copyTo(dstStripe);
+			}
+		}
+	};
+
+	class HistogramBody : public cv::ParallelLoopBody
+	{
+	private:
+		const cv::Mat & m_src;
+		std::vector<int> & m_histograms;//!< 256 bins per stripe.
+		int m_stripes;
+
+	public:
+		HistogramBody(const cv::Mat & src, std::vector<int> & histograms, int stripes) : m_src(src), m_histograms(histograms), m_stripes(stripes){};
+
+		void operator()(const cv::Range & range) const
+		{
+			for (int s = range.start; s < range.end; s++)
+			{
+				int begin, end;
+				stripeRows(m_src.rows, m_stripes, s, begin, end);
+				int * h = &m_histograms[s * 256];
+				for (int i = begin; i < end; i++)
+				{
+					const uchar* row = m_src.ptr<uchar>(i);
+					for (int j = 0; j < m_src.cols; j++)
+					{
+						h[row[j]]++;
+					}
+				}
+			}
+		}
+	};
+
+	class FunctionBody : public cv::ParallelLoopBody
+	{
+	private:
+		const std::function<void(int)> & m_body;
+
+	public:
+		FunctionBody(const std::function<void(int)> & body) : m_body(body){};
+
+		void operator()(const cv::Range & range) const
+		{
+			for (int i = range.start; i < range.end; i++)
+			{
+				m_body(i);
+			}
+		}
+	};
+}
+
+
+/**
+* \brief stripesFor - Method which returns number of stripes used for an image.
+* \param [in] int rows - image height.
+* \param [in] int stripes - requested stripes (0 means one per OpenCV thread, 1 disables striping).
+* \return int - stripes, each at least MIN_STRIPE_ROWS high.
+*/
+int protech::stripesFor(int rows, int stripes)
+{
+	if (stripes <= 0)
+		stripes = cv::getNumThreads();
+	int maxStripes = rows / MIN_STRIPE_ROWS;
+	if (stripes > maxStripes)
+		stripes = maxStripes;
+	return stripes < 1 ? 1 : stripes;
+}
+
+
+/**
+* \brief stripedGray - Method which converts BGR image to grayscale, stripes in parallel.
+* \param [in] const cv::Mat & src - BGR image.
+* \param [out] cv::Mat & dst - grayscale image (must not share data with src).
+* \param [in] int stripes - requested stripes (see stripesFor).
+*/
+void protech::stripedGray(const cv::Mat & src, cv::Mat & dst, int stripes)
+{
+	stripes = stripesFor(src.rows, stripes);
+	if (stripes == 1)
+	{
+		cv::cvtColor(src, dst, CV_BGR2GRAY);
+		return;
+	}
+	dst.create(src.size(), CV_8UC1);
+	cv::parallel_for_(cv::Range(0, stripes), GrayBody(src, dst, stripes));
+}
+
+
+/**
+* \brief stripedMorphology - Method which applies morphological operation, stripes in parallel.
+*Each stripe is filtered with halo rows of two kernel radii (closing and opening filter twice),
+*only its own rows are copied to dst, so result equals cv::morphologyEx of the whole image.
+* \param [in] const cv::Mat & src - source image.
+* \param [out] cv::Mat & dst - result (must not share data with src).
+* \param [in] int op - cv::MORPH_* operation (one iteration).
+* \param [in] const cv::Mat & kernel - structuring element (centred anchor).
+* \param [in] int stripes - requested stripes (see stripesFor).
+*/
+void protech::stripedMorphology(const cv::Mat & src, cv::Mat & dst, int op, const cv::Mat & kernel, int stripes)
+{
+	stripes = stripesFor(src.rows, stripes);
+	if (stripes == 1)
+	{
+		cv::morphologyEx(src, dst, op, kernel);
+		return;
+	}
+	dst.create(src.size(), src.type());
+	int halo = 2 * (kernel.rows / 2);
+	cv::parallel_for_(cv::Range(0, stripes), MorphologyBody(src, dst, op, kernel, halo, stripes));
+}
+
+
+/**
+* \brief stripedOtsu - Method which binarizes image with Otsu threshold of stripe histograms computed in parallel.
+*Threshold search is the one of cv::threshold with CV_THRESH_OTSU, so the same threshold is chosen.
+* \param [in] const cv::Mat & src - grayscale image.
+* \param [out] cv::Mat & dst - binary image (0 / 255).
+* \param [in] int stripes - requested stripes (see stripesFor).
+* \return double - Otsu threshold.
+*/
+double protech::stripedOtsu(const cv::Mat & src, cv::Mat & dst, int stripes)
+{
+	stripes = stripesFor(src.rows, stripes);
+	if (stripes == 1)
+	{
+		return cv::threshold(src, dst, 0.0, 255.0, cv::THRESH_BINARY | cv::THRESH_OTSU);
+	}
+
+	std::vector<int> histograms(stripes * 256, 0);
+	cv::parallel_for_(cv::Range(0, stripes), HistogramBody(src, histograms, stripes));
+	int h[256] = { 0 };
+	for (int s = 0; s < stripes; s++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			h[i] += histograms[s * 256 + i];
+		}
+	}
+
+	double scale = 1. / ((double)src.rows * src.cols);
+	double mu = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		mu += i * (double)h[i];
+	}
+	mu *= scale;
+
+	double mu1 = 0, q1 = 0;
+	double maxSigma = 0, maxVal = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		double p = h[i] * scale;
+		mu1 *= q1;
+		q1 += p;
+		double q2 = 1. - q1;
+		double qMin = q1 < q2 ? q1 : q2;
+		double qMax = q1 < q2 ? q2 : q1;
+		if (qMin < FLT_EPSILON || qMax > 1. - FLT_EPSILON)
+			continue;
+		mu1 = (mu1 + i * p) / q1;
+		double mu2 = (mu - q1 * mu1) / q2;
+		double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > maxSigma)
+		{
+			maxSigma = sigma;
+			maxVal = i;
+		}
+	}
+
+	// cv::threshold stripes the binarization itself
+	cv::threshold(src, dst, maxVal, 255.0, cv::THRESH_BINARY);
+	return maxVal;
+}
+
+
+/**
+* \brief parallelFor - Method which runs body for indices 0 .. count-1 in OpenCV's thread pool.
+*Body must only write data of its own index.
+* \param [in] int count - number of indices.
+* \param [in] const std::function<void(int)> & body - work of one index.
+*/
+void protech::parallelFor(int count, const std::function<void(int)> & body)
+{
+	if (count <= 0)
+		return;
+	cv::parallel_for_(cv::Range(0, count), FunctionBody(body));
+}
@@ -0,0 +1,30 @@
+/*!\file striped_stages.h
+*
+*	Intra-image parallelism used in TextDetection project.
+*	Image-level stages of one image (grey conversion, morphology, Otsu binarization) run on horizontal stripes
+*	in OpenCV's thread pool (cv::parallel_for_). Every stripe of a morphology stage reads halo rows of its
+*	neighbours (two kernel radii, enough for gradient and closing), so striped output equals full-image output.
+*	Otsu threshold is taken from the sum of stripe histograms, with the same rule as cv::threshold.
+*	Per-box loops use parallelFor; findContours and contour drawing stay on one thread.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef STRIPED_STAGES_H
+#define STRIPED_STAGES_H
+
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+
+namespace protech
+{
+	static const int MIN_STRIPE_ROWS = 64;//!< Stripes are not made thinner, halo rows would dominate.
+
+	int stripesFor(int rows, int stripes);
+	void stripedGray(const cv::Mat & src, cv::Mat & dst, int stripes);
+	void stripedMorphology(const cv::Mat & src, cv::Mat & dst, int op, const cv::Mat & kernel, int stripes);
+	double stripedOtsu(const cv::Mat & src, cv::Mat & dst, int stripes);
+	void parallelFor(int count, const std::function<void(int)> & body);
+}
+#endif
@@ -77,6 +77,18 @@ bool TesseractEngine::initialize(std::string tessdataPath)
 	std::string tessdata(tessdataPath);
 	
 	int success = m_tessBase.Init(tessdata.c_str(), m_lang.c_str(), m_mode);
+	if (success != 0 && m_mode != tesseract::OEM_TESSERACT_ONLY)
+	{
+		// Cube data is not installed for every language
+		printf("Engine mode %d is not available for %s, using Tesseract only...\n", (int)m_mode, m_lang.c_str());
+		m_mode = tesseract::OEM_TESSERACT_ONLY;
+		success = m_tessBase.Init(tessdata.c_str(), m_lang.c_str(), m_mode);
+	}
+	if (success != 0)
+	{
+		printf("Loading Tesseract data for %s failed!!!\n", m_lang.c_str());
+		return false;
+	}
 
 	//std::cout << "Tesseract Open Source OCR Engine with Leptonica: " << tesseract::TessBaseAPI::Version() << std::endl;
 
@@ -104,6 +116,7 @@ bool TesseractEngine::initialize(std::string tessdataPath)
 void TesseractEngine::clear()
 {
 	m_tessBase.Clear();
+	m_pix.reset();
 }
 
 /**
@@ -126,36 +139,46 @@ void TesseractEngine::setPageSegMode(tesseract::PageSegMode segMode)
 }
 
 
+/**
+* \brief setEngineMode - This method sets tesseract OCR engine mode (used by next initialize).
+* \param [in] tesseract::OcrEngineMode mode - engine mode.
+*/
+void TesseractEngine::setEngineMode(tesseract::OcrEngineMode mode)
+{
+	m_mode = mode;
+}
+
+
 /**
 * \brief createPix - This method creates tesseract image.
 * \param [in] int width - image width.
 * \param [in] int height - image height.
 * \param [in] int depth - image depth.
-* \param [in] int widthStep - image width step.
+* \param [in] int widthStep - image width step in bytes.
 * \param [in] int * imageData - image data.
-* \return *Pix - tesseract image.
+* \return PixPtr - tesseract image (owns its data, NULL if it can not be allocated).
 */
-Pix* TesseractEngine::createPix(int width, int height, int depth, int widthStep, const int *imageData)
+PixPtr TesseractEngine::createPix(int width, int height, int depth, int widthStep, const int *imageData)
 {
-	Pix* pix = pixCreateNoInit(width, height, depth);
-	pixSetWpl(pix, width);
-	pixSetColormap(pix, NULL);
-
-	int length = height*widthStep;
-
-	if (m_datas != NULL)
+	PixPtr pix(pixCreateNoInit(width, height, depth));
+	if (!pix)
 	{
-		delete[] m_datas;
-		m_datas = NULL;
+		return pix;
+	}
+	pixSetColormap(pix.get(), NULL);
+
+	// copy rows into Leptonica buffer (rows are padded to words, Mat rows to widthStep bytes)
+	l_uint32* data = pixGetData(pix.get());
+	int wpl = pixGetWpl(pix.get());
+	size_t rowBytes = ((size_t)width * depth + 7) / 8;
+	const char* source = reinterpret_cast<const char*>(imageData);
+	for (int y = 0; y < height; y++)
+	{
+		memcpy(data + (size_t)y * wpl, source + (size_t)y * widthStep, rowBytes);
 	}
-	m_datas = new l_uint32[length];
-
-	// get a copy of the image data
-	memcpy(m_datas, reinterpret_cast<const l_uint32*>(imageData), length);
-	pixSetData(pix, m_datas);
 
 	// correct the endianess
-	pixEndianByteSwap(pix);
+	pixEndianByteSwap(pix.get());
 
 	return pix;
 }
@@ -215,14 +238,25 @@ void TesseractEngine::setImage(const cv::Mat &image)
 	default:
 		break;
 	}
-	if (m_pix != 0)
+	if (m_pix)
 	{
-		m_tessBase.SetImage(m_pix);
+		m_tessBase.SetImage(m_pix.get());
 		//std::cout << "Slika podesena! " << std::endl;
 	}
 }
 
 
+/**
+* \brief setRectangle - This method restricts layout analysis and recognition to a part of the image set by setImage.
+*Previous recognition results are cleared, the image itself is kept.
+* \param [in] const cv::Rect &rect - region in image coordinates.
+*/
+void TesseractEngine::setRectangle(const cv::Rect &rect)
+{
+	m_tessBase.SetRectangle(rect.x, rect.y, rect.width, rect.height);
+}
+
+
 /**
 * \brief setWhiteList - This method sets characters white list.
 * \param [in] const char *whitelist - white list.
@@ -253,7 +287,7 @@ bool TesseractEngine::setVariable(std::string name, std::string value)
 STRING TesseractEngine::processPage()
 {
 	STRING text_out;
-	if (!m_tessBase.ProcessPage(m_pix, NULL, 0, NULL, 10000, &text_out))
+	if (!m_tessBase.ProcessPage(m_pix.get(), NULL, 0, NULL, 10000, &text_out))
 	{
 		;//printf("Error during processing.\n");
 	}
@@ -263,11 +297,120 @@ STRING TesseractEngine::processPage()
 	return text_out;
 }
 
+
+/**
+* \brief RecognitionDeadline - Deadline passed to cancel callback and whether the callback stopped recognition.
+*Deadlines use boost::chrono::steady_clock (QueryPerformanceCounter); std::chrono::steady_clock of VS2013 is
+*system_clock and a wall clock adjustment would stretch or cut every running deadline.
+*/
+struct RecognitionDeadline
+{
+	boost::chrono::steady_clock::time_point deadline;
+	bool cancelled;//!< Set when callback asked Tesseract to stop.
+};
+
+
+/**
+* \brief deadlineCancel - Tesseract cancel callback, stops recognition when deadline is reached.
+* \param [in] void * cancel_this - pointer to RecognitionDeadline.
+* \param [in] int - number of words recognized so far (not used).
+* \return bool - true if recognition should stop.
+*/
+static bool deadlineCancel(void * cancel_this, int /*words*/)
+{
+	RecognitionDeadline * deadline = static_cast<RecognitionDeadline *>(cancel_this);
+	if (boost::chrono::steady_clock::now() >= deadline->deadline)
+	{
+		deadline->cancelled = true;
+	}
+	return deadline->cancelled;
+}
+
+
+/**
+* \brief recognize - This method runs tesseract OCR which can be cancelled at given deadline.
+*Deadline is checked only by the cancel callback of the progress monitor while words are recognized, so a
+*recognition which finished is never reported as cancelled.
+* \param [in] boost::chrono::steady_clock::time_point deadline - recognition is stopped at this time.
+* \param [out] std::string & text - OCR result (empty if recognition is cancelled).
+* \return bool - true if recognition finished before deadline, otherwise false.
+*/
+bool TesseractEngine::recognize(boost::chrono::steady_clock::time_point deadline, std::string & text)
+{
+	text.clear();
+
+	long long remainingMs = boost::chrono::duration_cast<boost::chrono::milliseconds>(deadline - boost::chrono::steady_clock::now()).count();
+	if (remainingMs <= 0)
+	{
+		return false;
+	}
+
+	RecognitionDeadline recognitionDeadline;
+	recognitionDeadline.deadline = deadline;
+	recognitionDeadline.cancelled = false;
+
+	ETEXT_DESC monitor;
+	monitor.cancel = deadlineCancel;
+	monitor.cancel_this = &recognitionDeadline;
+
+	if (m_tessBase.Recognize(&monitor) < 0 || recognitionDeadline.cancelled)
+	{
+		return false;
+	}
+
+	char * utf8 = m_tessBase.GetUTF8Text();
+	if (utf8 != NULL)
+	{
+		text = utf8;
+		delete[] utf8;
+	}
+	return true;
+}
+
+/**
+* \brief getWordsCount - This method counts words and text lines of the last recognition.
+* \param [out] int & WCount - words count.
+* \param [out] int & LCount - text lines count.
+*/
 void TesseractEngine::getWordsCount(int & WCount, int & LCount)
 {
-	Boxa* bounds = m_tessBase.GetWords(NULL);
-	WCount = (int)bounds->n;
+	BoxaPtr bounds(m_tessBase.GetWords(NULL));
+	WCount = bounds ? (int)boxaGetCount(bounds.get()) : 0;
 	
-	Boxa* boundsLines = m_tessBase.GetTextlines(NULL, NULL);
-	LCount = (int)boundsLines->n;
+	BoxaPtr boundsLines(m_tessBase.GetTextlines(NULL, NULL));
+	LCount = boundsLines ? (int)boxaGetCount(boundsLines.get()) : 0;
+}
+
+/**
+* \brief getLayoutCounts - This method counts words and text lines found by tesseract layout analysis only.
+*Character classifier is not run, so this is much cheaper than processPage.
+* \param [out] int & WCount - words count.
+* \param [out] int & LCount - text lines count.
+*/
+void TesseractEngine::getLayoutCounts(int & WCount, int & LCount)
+{
+	WCount = 0;
+	LCount = 0;
+
+	tesseract::PageIterator* it = m_tessBase.AnalyseLayout();
+	if (it == NULL)
+	{
+		return;
+	}
+
+	int left, top, right, bottom;
+	do
+	{
+		if (!it->BoundingBox(tesseract::RIL_WORD, &left, &top, &right, &bottom))
+		{
+			break;
+		}
+		if (it->IsAtBeginningOf(tesseract::RIL_TEXTLINE))
+		{
+			LCount++;
+		}
+		WCount++;
+	} while (it->Next(tesseract::RIL_WORD));
+
+	delete it;
 }
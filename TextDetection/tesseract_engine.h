@@ -12,6 +12,7 @@
 
 
 #include <tesseract/baseapi.h>
+#include <tesseract/ocrclass.h>
 #include <leptonica/allheaders.h>
 #include <iostream>
 #include <string>
@@ -20,11 +21,32 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <boost/chrono/chrono.hpp>
+#include <memory>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+	/**
+	* \brief PixDeleter - Releases Leptonica image (reference counted, pixDestroy frees data with the last reference).
+	*/
+	struct PixDeleter
+	{
+		void operator()(Pix* pix) const { pixDestroy(&pix); }
+	};
+
+	/**
+	* \brief BoxaDeleter - Releases Leptonica box array returned by Tesseract.
+	*/
+	struct BoxaDeleter
+	{
+		void operator()(Boxa* boxa) const { boxaDestroy(&boxa); }
+	};
+
+	typedef std::unique_ptr<Pix, PixDeleter> PixPtr;//!< Owning Pix handle.
+	typedef std::unique_ptr<Boxa, BoxaDeleter> BoxaPtr;//!< Owning Boxa handle.
+
 	class TesseractEngine
 	{
 
@@ -41,26 +63,33 @@
 
 		void setPageSegMode(tesseract::PageSegMode segMode);
 
+		void setEngineMode(tesseract::OcrEngineMode mode);
+
 		void setImage(const cv::Mat &image);
 
+		void setRectangle(const cv::Rect &rect);
+
 		bool setWhiteList(const char *whitelist);
 
 		bool setVariable(std::string name, std::string value);
 
 		STRING processPage();
 
+		bool recognize(boost::chrono::steady_clock::time_point deadline, std::string & text);
+
 		void getWordsCount(int & WCount, int & LCount);
 
+		void getLayoutCounts(int & WCount, int & LCount);
+
 	private:
 		std::string m_lang;
-		Pix* m_pix = 0;
-		l_uint32* m_datas = NULL;
+		PixPtr m_pix;//!< Image set to Tesseract (Tesseract keeps own reference while it is set).
 
 		tesseract::TessBaseAPI m_tessBase;
 		tesseract::OcrEngineMode m_mode;
 		tesseract::PageSegMode m_pageSegMode;
 
-		Pix* createPix(int width, int height, int depth, int widthStep, const int *imageData);
+		PixPtr createPix(int width, int height, int depth, int widthStep, const int *imageData);
 
 		std::string ModulePath();
 
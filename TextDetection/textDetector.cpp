@@ -1,4 +1,38 @@
 #include "textDetector.h"
+#include "box_store.h"
+#include "detection_pool.h"
+#include "detection_trace.h"
+#include "metrics.h"
+#include "striped_stages.h"
+#include "triage.h"
+
+#include <random>
+
+
+/**
+* \brief languageCode - Method for mapping language argument to Tesseract language code.
+* \param [in] const std::string & language - language name (e.g. English, chinese) or Tesseract code (e.g. eng, chi_sim).
+* \return std::string - Tesseract language code, or empty string for unsupported language.
+*/
+std::string protech::languageCode(const std::string & language)
+{
+	if (language == "English" || language == "english" || language == "eng")
+		return "eng";
+	if (language == "Chinese" || language == "chinese" || language == "chi_sim")
+		return "chi_sim";
+	if (language == "Indonesian" || language == "indonesian" || language == "ind")
+		return "ind";
+	if (language == "Hindi" || language == "hindi" || language == "hin")
+		return "hin";
+	if (language == "Japanese" || language == "japanese" || language == "jpn")
+		return "jpn";
+	if (language == "Korean" || language == "korean" || language == "kor")
+		return "kor";
+	if (language == "Thai" || language == "thai" || language == "tha")
+		return "tha";
+
+	return "";
+}
 
 
 /**
@@ -6,6 +40,7 @@
 */
 protech::TextDetector::~TextDetector()
 {
+	m_pool.reset();
 	clear();
 }
 
@@ -32,13 +67,96 @@ std::string protech::TextDetector::ModulePathA()
 /**
 * \brief initialize - Method for initializing Tesseract and setting up parameters.
 * \param [in] std::string _OUTPUT_FOLDER_PATH - output folder.
+* \param [in] std::string _LANGUAGE - Tesseract language code (default language of images).
+* \param [in] bool initializeEngine - if false, Tesseract is not loaded: OCR responses must be replayed (see setOcrReplay)
+*or images are only submitted to the worker pool, whose workers load own engines of the added languages.
 */
-void  protech::TextDetector::initialize(std::string _OUTPUT_FOLDER_PATH, std::string _LANGUAGE)
+void  protech::TextDetector::initialize(std::string _OUTPUT_FOLDER_PATH, std::string _LANGUAGE, bool initializeEngine)
 {
 	OUTPUT_FOLDER_PATH = _OUTPUT_FOLDER_PATH;
 	LANGUAGE = _LANGUAGE;
-	std::string tessdataPath = ModulePathA() + "//";
-	tessEngine.initialize(tessdataPath);
+	m_loadEngines = initializeEngine;
+	addLanguage(LANGUAGE);
+	selectLanguage(LANGUAGE);
+}
+
+
+/**
+* \brief addLanguage - Method for loading Tesseract engine of another language, so images in that language do not wait for it.
+* \param [in] const std::string & language - Tesseract language code.
+* \return bool - false if Tesseract data of the language can not be loaded.
+*/
+bool protech::TextDetector::addLanguage(const std::string & language)
+{
+	if (m_engines.find(language) != m_engines.end())
+	{
+		return true;
+	}
+
+	std::shared_ptr<TesseractEngine> engine;
+	if (m_loadEngines)
+	{
+		engine.reset(new TesseractEngine(language));
+		engine->setEngineMode((tesseract::OcrEngineMode)PARAMS.ocrEngineMode);
+		if (!engine->initialize(ModulePathA() + "//"))
+		{
+			return false;
+		}
+	}
+	m_engines[language] = engine;
+	m_languages.push_back(language);
+	return true;
+}
+
+
+/**
+* \brief setImageLanguages - Method for setting OCR languages of the following images.
+*Detection runs once; OCR of every region is repeated per language until one language accepts it.
+*Languages which were not added are loaded on first use.
+* \param [in] const std::vector<std::string> & languages - Tesseract language codes (empty means default language).
+*/
+void protech::TextDetector::setImageLanguages(const std::vector<std::string> & languages)
+{
+	m_imageLanguages = languages;
+}
+
+
+/**
+* \brief selectLanguage - Method for switching OCR engine and verdict rules to given language.
+* \param [in] const std::string & language - Tesseract language code.
+* \return bool - false if engine of the language can not be loaded.
+*/
+bool protech::TextDetector::selectLanguage(const std::string & language)
+{
+	m_ocrLanguage = language;
+	if (!addLanguage(language))
+	{
+		m_engine = NULL;
+		return false;
+	}
+	m_engine = m_engines[language].get();
+	return true;
+}
+
+
+/**
+* \brief setTrace - Method for recording intermediate outputs of the following detections.
+* \param [in] DetectionTrace * trace - trace which is cleared and filled by every detection (NULL disables tracing).
+*/
+void protech::TextDetector::setTrace(DetectionTrace * trace)
+{
+	m_trace = trace;
+}
+
+
+/**
+* \brief setOcrReplay - Method for replaying recorded OCR responses instead of running Tesseract.
+*Regions are looked up by rect; region without recorded response is rejected.
+* \param [in] const DetectionTrace * replay - recorded trace (NULL runs Tesseract).
+*/
+void protech::TextDetector::setOcrReplay(const DetectionTrace * replay)
+{
+	m_ocrReplay = replay;
 }
 
 
@@ -47,8 +165,14 @@ void  protech::TextDetector::initialize(std::string _OUTPUT_FOLDER_PATH, std::st
 */
 void  protech::TextDetector::clear()
 {
-	tessEngine.clear();
-	tessEngine.~TesseractEngine();
+	for (std::map<std::string, std::shared_ptr<TesseractEngine> >::iterator it = m_engines.begin(); it != m_engines.end(); ++it)
+	{
+		if (it->second)
+		{
+			it->second->clear();
+			it->second->end();
+		}
+	}
 }
 
 
@@ -165,236 +289,620 @@ void protech::TextDetector::floodFillNewRects(cv::Mat & foreground, cv::Mat & ou
 
 
 /**
-* \brief getTextInfoTesseract - method for getting OCR text from given image.
-* \param [in] const cv::Mat & inputImg -  image for text detection.
-* \param [out] std::string & result - detected text.
+* \brief rectXLess - Order of rects by left edge (then top edge and size), used by sweep over super boxes.
 */
-void protech::TextDetector::getTextInfoTesseract(const cv::Mat & inputImg, std::string & result, int & lineCount, int & wordCount)
+static bool rectXLess(const cv::Rect & a, const cv::Rect & b)
 {
-	try{
-		cv::Mat openCVImage2;
-		inputImg.copyTo(openCVImage2);
-
-		tessEngine.setImage(openCVImage2);
+	if (a.x != b.x)
+		return a.x < b.x;
+	if (a.y != b.y)
+		return a.y < b.y;
+	if (a.width != b.width)
+		return a.width < b.width;
+	return a.height < b.height;
+}
 
-		result = tessEngine.processPage().string();
-		tessEngine.getWordsCount(wordCount, lineCount);
 
-		if (!openCVImage2.empty())
-			openCVImage2.release();
-	}
-	catch (std::exception & e)
+/**
+* \brief findRoot - Union-find root with path halving.
+*/
+static int findRoot(std::vector<int> & parent, int i)
+{
+	while (parent[i] != i)
 	{
-		;
+		parent[i] = parent[parent[i]];
+		i = parent[i];
 	}
-	catch (char * str)
+	return i;
+}
+
+
+/**
+* \brief mergeSuperBoxes - method for merging overlapping super boxes into components in rectangle domain.
+*Gives the same components as drawing super boxes, dilating them by 2x2 kernel and labeling them with floodFillNewRects,
+*but only component areas are rasterized. Duplicate super boxes (same pair found from both boxes) are merged once.
+* \param [in] const std::vector<cv::Rect> & superBoxes - super boxes from applyRules.
+* \param [in] cv::Size imageSize - working image size.
+* \param [in] int AREA_DOWN - Threshold for deleting small components (union area in pixels).
+* \param [in] int AREA_UP - Threshold for deleting big components.
+* \param [in] double elongationDown - Lower limit threshold for ratio of width and height of component bounding box.
+* \param [in] double elongationUp - Upper limit threshold for ratio of width and height of component bounding box.
+* \param [in] double rectangularityDown - Ratio of component area and bounding box area.
+* \param [out] std::vector<cv::Rect> & allRects - Component bounding boxes in raster order of their first pixel.
+* \param [out] std::vector<cv::Mat> & allMasks - Component masks (size of bounding box, 255 inside union of boxes).
+*/
+void protech::TextDetector::mergeSuperBoxes(const std::vector<cv::Rect> & superBoxes, cv::Size imageSize, int AREA_DOWN, int AREA_UP, double elongationDown, double elongationUp, double rectangularityDown, std::vector<cv::Rect> & allRects, std::vector<cv::Mat> & allMasks)
+{
+	cv::Rect frame(0, 0, imageSize.width, imageSize.height);
+
+	// 2x2 dilation (anchor 1,1) grows every box by one pixel to the right and down
+	std::vector<cv::Rect> boxes;
+	boxes.reserve(superBoxes.size());
+	for (size_t i = 0; i < superBoxes.size(); i++)
 	{
-		;
+		cv::Rect dilated = cv::Rect(superBoxes[i].x, superBoxes[i].y, superBoxes[i].width + 1, superBoxes[i].height + 1) & frame;
+		if (dilated.area() > 0)
+			boxes.push_back(dilated);
 	}
-	catch (...)
+	std::sort(boxes.begin(), boxes.end(), rectXLess);
+	boxes.erase(std::unique(boxes.begin(), boxes.end()), boxes.end());
+
+	// boxes are 8-connected when they overlap or touch (also diagonally); sweep in x order
+	std::vector<int> parent(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		parent[i] = (int)i;
+	for (size_t i = 0; i < boxes.size(); i++)
 	{
-		;
+		for (size_t j = i + 1; j < boxes.size() && boxes[j].x <= boxes[i].x + boxes[i].width; j++)
+		{
+			if (boxes[j].y <= boxes[i].y + boxes[i].height && boxes[i].y <= boxes[j].y + boxes[j].height)
+			{
+				int rootI = findRoot(parent, (int)i);
+				int rootJ = findRoot(parent, (int)j);
+				if (rootI != rootJ)
+					parent[rootJ] = rootI;
+			}
+		}
 	}
-}
 
+	std::vector<std::vector<int> > members(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		members[findRoot(parent, (int)i)].push_back((int)i);
 
-// Erase low and high bounding boxes
-void protech::TextDetector::eraseLowAndHigh(std::vector<cv::Rect> & boundingBoxes)
-{
-	const int minHeihgt = 30;
-	const int maxHeihgt = 300;
+	// components are reported in raster order of their first pixel, as flood fill finds them
+	std::vector<std::pair<cv::Point, int> > order;
+	for (size_t r = 0; r < members.size(); r++)
+	{
+		if (members[r].empty())
+			continue;
+		cv::Point first(boxes[members[r][0]].x, boxes[members[r][0]].y);
+		for (size_t k = 1; k < members[r].size(); k++)
+		{
+			const cv::Rect & box = boxes[members[r][k]];
+			if (box.y < first.y || (box.y == first.y && box.x < first.x))
+				first = cv::Point(box.x, box.y);
+		}
+		order.push_back(std::make_pair(first, (int)r));
+	}
+	std::sort(order.begin(), order.end(), [](const std::pair<cv::Point, int> & a, const std::pair<cv::Point, int> & b)
+	{
+		return (a.first.y != b.first.y) ? (a.first.y < b.first.y) : (a.first.x < b.first.x);
+	});
 
-	// Erase small and big bounding boxes
-	int i = 0;
-	while (i < boundingBoxes.size())
+	for (size_t c = 0; c < order.size(); c++)
 	{
-		cv::Rect boundingBoxCurrent = boundingBoxes[i];
+		const std::vector<int> & component = members[order[c].second];
+		cv::Rect bounding = boxes[component[0]];
+		for (size_t k = 1; k < component.size(); k++)
+			bounding = bounding | boxes[component[k]];
 
-		if (boundingBoxCurrent.height < minHeihgt || boundingBoxCurrent.height > maxHeihgt)
+		cv::Mat componentMask = cv::Mat::zeros(bounding.size(), CV_8UC1);
+		for (size_t k = 0; k < component.size(); k++)
 		{
-			boundingBoxes.erase(boundingBoxes.begin() + i);
+			const cv::Rect & box = boxes[component[k]];
+			componentMask(cv::Rect(box.x - bounding.x, box.y - bounding.y, box.width, box.height)).setTo(cv::Scalar(255));
 		}
-		else
+
+		int area = cv::countNonZero(componentMask);
+		if ((area < AREA_DOWN) || (area > AREA_UP))//Deleting small and big artefacts
+			continue;
+
+		double elongation = (double)(bounding.width) / (double)(bounding.height);//b.box w and h ratio
+		double rectangularity = (double)(area) / (double)(bounding.width * bounding.height);
+		if ((rectangularity > rectangularityDown) && (elongation > elongationDown) && (elongation < elongationUp))
 		{
-			i++;
+			allRects.push_back(bounding);
+			allMasks.push_back(componentMask);
 		}
 	}
 }
 
-// Check whether a bounding box has a neighbour near from left or right side and if it has, connect them.
-void protech::TextDetector::connectLeftAndRight(std::vector<cv::Rect> & boundingBoxes)
+
+/**
+* \brief benchmarkSuperBoxMerge - Method which measures mergeSuperBoxes on synthetic super boxes and checks it against raster path.
+*Raster path draws super boxes into a frame mask, dilates it by 2x2 kernel and labels it with floodFillNewRects (as detection
+*did before mergeSuperBoxes); both paths must return the same component rects in the same order and the same component pixels.
+* \param [in] size_t setsCount - frames count (e.g. 500).
+* \return int - 0 if both paths agree, otherwise -1.
+*/
+int protech::TextDetector::benchmarkSuperBoxMerge(size_t setsCount)
 {
-	int i = 0;
-	while (i < boundingBoxes.size())
+	cv::Size imageSize(WORKING_WIDTH, 2000);
+	std::mt19937 generator(12345);
+	std::vector<std::vector<cv::Rect> > sets(setsCount);
+	for (size_t s = 0; s < setsCount; s++)
 	{
-		cv::Rect boundingBoxCurrent = boundingBoxes[i];
-		int connect = 0;
-		int j = 0;
-		while (connect == 0 && j < boundingBoxes.size())
+		std::vector<cv::Rect> & boxes = sets[s];
+		int groups = 5 + generator() % 20;
+		for (int g = 0; g < groups; g++)
 		{
-			if (i != j)
+			// text blocks: lines of super boxes which overlap, touch or nearly touch; some run over the frame edge
+			int x = generator() % imageSize.width;
+			int y = generator() % imageSize.height;
+			int lines = 1 + generator() % 6;
+			for (int l = 0; l < lines; l++)
 			{
-				cv::Rect boundingBoxNext = boundingBoxes[j];
-
-				//Check left/right
-				if (boundingBoxCurrent.x > boundingBoxNext.x)
-				{
-					// Check left
-					if ((double)boundingBoxNext.width - (double)0.4 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) < (double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) &&
-						(double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) < (double)boundingBoxNext.width + (double)1.1 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)std::abs(min(boundingBoxCurrent.y, boundingBoxNext.y) - (double)max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height)) < (double)max(boundingBoxCurrent.height, boundingBoxNext.height) + (double)0.4 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > (double)0.6)
-					{
-						connect = 1;
-						boundingBoxes[i].x = min(boundingBoxCurrent.x, boundingBoxNext.x);
-						boundingBoxes[i].y = min(boundingBoxCurrent.y, boundingBoxNext.y);
-						boundingBoxes[i].height = std::abs(boundingBoxes[i].y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
-						boundingBoxes[i].width = std::abs(boundingBoxes[i].x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
-						boundingBoxes.erase(boundingBoxes.begin() + j);
-					}
-
-				}
-				else if (boundingBoxCurrent.x < boundingBoxNext.x)
-				{
-					// Check right
-					if ((double)boundingBoxCurrent.width - (double)0.4 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) < (double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) &&
-						(double)std::abs(boundingBoxCurrent.x - boundingBoxNext.x) < (double)boundingBoxCurrent.width + (double)1.1 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)std::abs(min(boundingBoxCurrent.y, boundingBoxNext.y) - (double)max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height)) < (double)max(boundingBoxCurrent.height, boundingBoxNext.height) + (double)0.4 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > (double)0.6)
-					{
-						connect = 1;
-						boundingBoxes[i].x = min(boundingBoxCurrent.x, boundingBoxNext.x);
-						boundingBoxes[i].y = min(boundingBoxCurrent.y, boundingBoxNext.y);
-						boundingBoxes[i].height = std::abs(boundingBoxes[i].y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
-						boundingBoxes[i].width = std::abs(boundingBoxes[i].x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
-						boundingBoxes.erase(boundingBoxes.begin() + j);
-					}
-				}
+				int width = 20 + generator() % 400;
+				int height = 10 + generator() % 60;
+				cv::Rect box(x + (int)(generator() % 30) - 15, y, width, height);
+				boxes.push_back(box);
+				if (generator() % 8 == 0)
+					boxes.push_back(box);
+				y += height + (int)(generator() % 4) - 2;
 			}
-			j++;
 		}
+		std::shuffle(boxes.begin(), boxes.end(), generator);
+	}
 
-		if (connect == 0)
+	int status = 0;
+	size_t componentsCount = 0;
+	long long rasterUs = 0;
+	long long mergeUs = 0;
+	for (size_t s = 0; s < setsCount; s++)
+	{
+		boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+		cv::Mat superRectMask = cv::Mat::zeros(imageSize, CV_8UC1);
+		for (size_t b = 0; b < sets[s].size(); b++)
+			cv::rectangle(superRectMask, sets[s][b], cv::Scalar(255), -1);
+		cv::Mat connectedRects;
+		cv::morphologyEx(superRectMask, connectedRects, cv::MORPH_DILATE, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2)));
+		cv::Mat rasterMask = cv::Mat::zeros(imageSize, CV_8UC1);
+		std::vector<std::vector<cv::Point> > rasterObjects;
+		std::vector<cv::Rect> rasterRects;
+		floodFillNewRects(connectedRects, rasterMask, PARAMS.componentMinArea, PARAMS.componentMaxArea, PARAMS.componentElongationDown, PARAMS.componentElongationUp, PARAMS.componentRectangularity, rasterObjects, rasterRects);
+		boost::chrono::steady_clock::time_point middle = boost::chrono::steady_clock::now();
+
+		std::vector<cv::Rect> mergeRects;
+		std::vector<cv::Mat> mergeMasks;
+		mergeSuperBoxes(sets[s], imageSize, PARAMS.componentMinArea, PARAMS.componentMaxArea, PARAMS.componentElongationDown, PARAMS.componentElongationUp, PARAMS.componentRectangularity, mergeRects, mergeMasks);
+		boost::chrono::steady_clock::time_point end = boost::chrono::steady_clock::now();
+		rasterUs += boost::chrono::duration_cast<boost::chrono::microseconds>(middle - start).count();
+		mergeUs += boost::chrono::duration_cast<boost::chrono::microseconds>(end - middle).count();
+
+		cv::Mat mergeMask = cv::Mat::zeros(imageSize, CV_8UC1);
+		for (size_t c = 0; c < mergeMasks.size(); c++)
+		{
+			cv::Mat component(mergeMask, mergeRects[c]);
+			cv::bitwise_or(component, mergeMasks[c], component);
+		}
+		componentsCount += mergeRects.size();
+		cv::Mat difference;
+		cv::compare(rasterMask, mergeMask, difference, cv::CMP_NE);
+		if (rasterRects != mergeRects || cv::countNonZero(difference) != 0)
 		{
-			i++;
+			std::cout << "Merged components differ from raster path on frame " << s << std::endl;
+			status = -1;
 		}
 	}
+
+	std::cout << "raster path: " << setsCount << " frames in " << rasterUs / 1000 << " ms" << std::endl;
+	std::cout << "merge path: " << setsCount << " frames in " << mergeUs / 1000 << " ms" << std::endl;
+	std::cout << componentsCount << " components, paths " << (status == 0 ? "agree" : "differ") << std::endl;
+	return status;
 }
 
-// Erase impossible bounding boxes
-void protech::TextDetector::eraseImposible(std::vector<cv::Rect> & boundingBoxes)
+
+/**
+* \brief setParams - Method for setting thresholds of detection stages and OCR settings (see detection_params.h).
+*Layout verdict is set from params (setLayoutVerdict can change it afterwards). OCR engine mode applies to engines
+*loaded after this call, so params should be set before initialize. Running pool is stopped and started again on next submit.
+* \param [in] const DetectionParams & params - parameters, e.g. from presetParams.
+*/
+void protech::TextDetector::setParams(const DetectionParams & params)
 {
-	int i = 0;
-	while (i < boundingBoxes.size())
+	PARAMS = params;
+	LAYOUT_VERDICT = params.layoutVerdict;
+	std::lock_guard<std::mutex> lock(m_poolLock);
+	m_pool.reset();
+}
+
+
+/**
+* \brief setLayoutVerdict - Method for enabling decision on layout counts for clear regions.
+* \param [in] bool enabled - if true, full recognition runs only for borderline regions.
+*/
+void protech::TextDetector::setLayoutVerdict(bool enabled)
+{
+	LAYOUT_VERDICT = enabled;
+}
+
+
+/**
+* \brief setTextRequested - Method for requesting OCR text of every region (disables layout only verdict).
+* \param [in] bool requested - if true, full recognition runs for every region.
+*/
+void protech::TextDetector::setTextRequested(bool requested)
+{
+	TEXT_REQUESTED = requested;
+}
+
+
+/**
+* \brief setWriteImages - Method for enabling output images (_masked and _rects).
+* \param [in] bool write - if false, only detection result is returned.
+*/
+void protech::TextDetector::setWriteImages(bool write)
+{
+	WRITE_IMAGES = write;
+}
+
+
+/**
+* \brief setResultMask - Method for returning text mask (same mask as in _masked image) in detection result.
+* \param [in] bool enabled - if true, result.mask is set.
+*/
+void protech::TextDetector::setResultMask(bool enabled)
+{
+	RESULT_MASK = enabled;
+}
+
+
+/**
+* \brief setFrameOcr - Method for enabling frame level OCR.
+*Masked working image is given to Tesseract once per frame and every region is recognized with SetRectangle,
+*instead of copying every region into its own Tesseract image.
+* \param [in] bool enabled - if true, frame level OCR is used.
+*/
+void protech::TextDetector::setFrameOcr(bool enabled)
+{
+	FRAME_OCR = enabled;
+}
+
+
+/**
+* \brief setDeadline - Method for setting time budget of one image.
+*OCR calls are cancelled when budget runs out and remaining regions are skipped, so result is partial.
+* \param [in] int deadlineMs - budget in milliseconds, 0 means no budget.
+*/
+void protech::TextDetector::setDeadline(int deadlineMs)
+{
+	DEADLINE_MS = (deadlineMs > 0) ? deadlineMs : 0;
+}
+
+
+/**
+* \brief setTriageThreshold - Method for enabling whole-image triage (see triage.h).
+*Images scoring below threshold return an empty result without detection and OCR stages.
+* \param [in] double threshold - triage score threshold, 0 means no triage.
+*/
+void protech::TextDetector::setTriageThreshold(double threshold)
+{
+	TRIAGE_THRESHOLD = (threshold > 0) ? threshold : 0;
+}
+
+
+/**
+* \brief setStripes - Method for setting intra-image parallelism (see striped_stages.h).
+*Striped stages give the same output as the sequential ones, only latency of one image changes.
+* \param [in] int stripes - horizontal stripes, 0 means one per OpenCV thread, 1 means no striping.
+*/
+void protech::TextDetector::setStripes(int stripes)
+{
+	STRIPES = (stripes > 0) ? stripes : 0;
+}
+
+
+/**
+* \brief setConcurrency - Method for setting number of worker threads used by submit and detectBatch.
+*Every worker has its own Tesseract engine, so memory grows with the number of workers.
+*Running pool with different size is stopped (after its submitted images are finished) and started again on next submit.
+* \param [in] size_t workersCount - number of workers, at least one.
+*/
+void protech::TextDetector::setConcurrency(size_t workersCount)
+{
+	std::lock_guard<std::mutex> lock(m_poolLock);
+	m_concurrency = (workersCount > 0) ? workersCount : 1;
+	if (m_pool && m_pool->workersCount() != m_concurrency)
+	{
+		m_pool.reset();
+	}
+}
+
+
+/**
+* \brief setPriorityCap - Method for limiting number of workers which can run images and regions of one priority class.
+*E.g. capping PRIORITY_BULK below the number of workers keeps workers free for urgent images.
+*Running pool is stopped (after its submitted images are finished) and started again on next submit.
+* \param [in] int priority - DetectionOptions::PRIORITY_HIGH, PRIORITY_NORMAL or PRIORITY_BULK.
+* \param [in] size_t maxWorkers - maximum workers, 0 means all workers.
+*/
+void protech::TextDetector::setPriorityCap(int priority, size_t maxWorkers)
+{
+	if (priority < 0 || priority >= DetectionOptions::PRIORITIES_COUNT)
 	{
-		cv::Rect boundingBoxCurrent = boundingBoxes[i];
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_poolLock);
+	m_classCaps[priority] = maxWorkers;
+	m_pool.reset();
+}
+
+
+/**
+* \brief setRegionTasks - Method for choosing how worker pool spreads work.
+*With region tasks, OCR of every candidate region is a task which any worker can run (work stealing),
+*so one image with many regions does not keep other workers idle; frame OCR is not used then.
+*Running pool is stopped (after its submitted images are finished) and started again on next submit.
+* \param [in] bool enabled - true for region tasks (default), false for one worker per image.
+*/
+void protech::TextDetector::setRegionTasks(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(m_poolLock);
+	REGION_TASKS = enabled;
+	m_pool.reset();
+}
+
 
-		if (boundingBoxCurrent.height > boundingBoxCurrent.width || (double)boundingBoxCurrent.height / (double)boundingBoxCurrent.width > (double)0.65)
+/**
+* \brief submit - Method which queues image for asynchronous text detection on internal worker pool.
+*Workers use own detectors (initialized with output folder and language of this detector), never this one,
+*so submit can be called from any thread while this detector is used for blocking detection.
+* \param [in] const cv::Mat & image - image for text detection (not copied; must not be modified until result is ready).
+* \param [in] const DetectionOptions & options - per-image options.
+* \return std::future<TextDetectionResult> - detection result.
+*/
+std::future<protech::TextDetectionResult> protech::TextDetector::submit(const cv::Mat & image, const DetectionOptions & options)
+{
+	std::shared_ptr<DetectionPool> pool;
+	{
+		std::lock_guard<std::mutex> lock(m_poolLock);
+		if (!m_pool)
 		{
-			boundingBoxes.erase(boundingBoxes.begin() + i);
+			m_pool.reset(new DetectionPool(OUTPUT_FOLDER_PATH, m_languages, PARAMS, m_concurrency, m_classCaps, REGION_TASKS));
 		}
-		else
+		pool = m_pool;
+	}
+	return pool->submit(image, options);
+}
+
+
+/**
+* \brief detectBatch - Method for text detection on several images in parallel (blocks until all are finished).
+* \param [in] const std::vector<cv::Mat> & images - images for text detection.
+* \param [in] const DetectionOptions & options - options for all images; if name is set, image index is appended to it.
+* \return std::vector<TextDetectionResult> - results in the order of images.
+*/
+std::vector<protech::TextDetectionResult> protech::TextDetector::detectBatch(const std::vector<cv::Mat> & images, const DetectionOptions & options)
+{
+	std::vector<std::future<TextDetectionResult> > futures;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		DetectionOptions imageOptions = options;
+		if (!options.name.empty())
 		{
-			i++;
+			imageOptions.name = options.name + "_" + boost::lexical_cast<std::string>(i);
 		}
+		futures.push_back(submit(images[i], imageOptions));
+	}
+
+	std::vector<TextDetectionResult> results;
+	for (size_t i = 0; i < futures.size(); i++)
+	{
+		results.push_back(futures[i].get());
 	}
+	return results;
 }
 
-// Check whether a bounding box has a neighbour near above or below and if it has not, erese it unless it is low but long.
-void protech::TextDetector::checkAboveAndBelowAndWidth(std::vector<cv::Rect> & boundingBoxes, std::vector<cv::Rect> & superBoundingBoxes)
+
+/**
+* \brief layoutVerdict - method for deciding clear regions on Tesseract layout counts only.
+*Layout words and lines can differ from recognized ones (a line split or merged, a word dropped), so reject and
+*accept limits are kept away from isTextRegion limits: English rejects below 3 words (isTextRegion needs more than 3)
+*and accepts from 10 (it needs more than 6); other languages reject only regions without any text line (isTextRegion
+*needs more than 1) and accept from 3 lines and 4 words. Anything in between gets full recognition.
+* \param [in] int wordsCount - words count from layout analysis.
+* \param [in] int linesCount - text lines count from layout analysis.
+* \return int - VERDICT_REJECT, VERDICT_ACCEPT or VERDICT_BORDERLINE (full recognition is needed).
+*/
+int protech::TextDetector::layoutVerdict(int wordsCount, int linesCount)
 {
-	int i = 0;
-	while (i < boundingBoxes.size())
+	if (m_ocrLanguage == "eng")
 	{
-		cv::Rect boundingBoxCurrent = boundingBoxes[i];
-		int erase = 1;
+		if (wordsCount < 3)
+			return VERDICT_REJECT;
+		if (wordsCount >= 10)
+			return VERDICT_ACCEPT;
+	}
+	else if ((m_ocrLanguage == "chi_sim") || (m_ocrLanguage == "jpn") || (m_ocrLanguage == "tha") || (m_ocrLanguage == "kor") || (m_ocrLanguage == "hin") || (m_ocrLanguage == "ind"))
+	{
+		if (linesCount == 0)
+			return VERDICT_REJECT;
+		if ((linesCount >= 3) && (wordsCount >= 4))
+			return VERDICT_ACCEPT;
+	}
 
-		// Check below/above
-		int j = 0;
-		while (erase == 1 && j < boundingBoxes.size())
-		{
-			if (i != j)
-			{
-				cv::Rect boundingBoxNext = boundingBoxes[j];
+	return VERDICT_BORDERLINE;
+}
 
-				if (boundingBoxCurrent.y < boundingBoxNext.y)
-				{
-					// Check below
-					if ((double)boundingBoxCurrent.height - (double)0.2 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) <= (double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) &&
-						(double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) < (double)boundingBoxCurrent.height + (double)0.9 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)std::abs(min(boundingBoxCurrent.x, boundingBoxNext.x) - (double)max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width)) < (double)max(boundingBoxCurrent.width, boundingBoxNext.width) + (double)0.4 * (double)min(boundingBoxCurrent.width, boundingBoxNext.width) &&
-						(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > (double)0.5 &&
-						(double)min(boundingBoxCurrent.width, boundingBoxNext.width) / (double)max(boundingBoxCurrent.width, boundingBoxNext.width) > (double)0.1)
-					{
-						erase = 0;
-						cv::Rect superBoundingBox;
-						superBoundingBox.x = min(boundingBoxCurrent.x, boundingBoxNext.x);
-						superBoundingBox.y = min(boundingBoxCurrent.y, boundingBoxNext.y);
-						superBoundingBox.height = std::abs(superBoundingBox.y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
-						superBoundingBox.width = std::abs(superBoundingBox.x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
-						superBoundingBoxes.push_back(superBoundingBox);
-					}
-				}
-				else if (boundingBoxCurrent.y > boundingBoxNext.y)
-				{
-					// Check above
-					if ((double)boundingBoxNext.height - (double)0.2 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) <= (double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) &&
-						(double)std::abs(boundingBoxCurrent.y - boundingBoxNext.y) < (double)boundingBoxNext.height + (double)0.9 * (double)min(boundingBoxCurrent.height, boundingBoxNext.height) &&
-						(double)std::abs(min(boundingBoxCurrent.x, boundingBoxNext.x) - (double)max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width)) < (double)max(boundingBoxCurrent.width, boundingBoxNext.width) + (double)0.4 * (double)min(boundingBoxCurrent.width, boundingBoxNext.width) &&
-						(double)min(boundingBoxCurrent.height, boundingBoxNext.height) / (double)max(boundingBoxCurrent.height, boundingBoxNext.height) > (double)0.5 &&
-						(double)min(boundingBoxCurrent.width, boundingBoxNext.width) / (double)max(boundingBoxCurrent.width, boundingBoxNext.width) > (double)0.1)
-					{
-						erase = 0;
-						cv::Rect superBoundingBox;
-						superBoundingBox.x = min(boundingBoxCurrent.x, boundingBoxNext.x);
-						superBoundingBox.y = min(boundingBoxCurrent.y, boundingBoxNext.y);
-						superBoundingBox.height = std::abs(superBoundingBox.y - max(boundingBoxCurrent.y + boundingBoxCurrent.height, boundingBoxNext.y + boundingBoxNext.height));
-						superBoundingBox.width = std::abs(superBoundingBox.x - max(boundingBoxCurrent.x + boundingBoxCurrent.width, boundingBoxNext.x + boundingBoxNext.width));
-						superBoundingBoxes.push_back(superBoundingBox);
-					}
-				}
 
-				
-			}
-			j++;
-		}
+/**
+* \brief isTextRegion - method for accepting region on full recognition result.
+* \param [in] const std::string & text - detected text.
+* \param [in] int wordsCount - words count.
+* \param [in] int linesCount - text lines count.
+* \return bool - true if region contains text, otherwise false.
+*/
+bool protech::TextDetector::isTextRegion(const std::string & text, int wordsCount, int linesCount)
+{
+	if (m_ocrLanguage == "eng")
+	{
+		//std::string newRes = boost::erase_all_regex_copy(text, boost::regex("[^a-zA-Z0-9]+"));//ENGLISH LANG
+		return (wordsCount > 6) || (((wordsCount > 3) && (linesCount > 1)) && (wordsCount >= 2 * linesCount)) && (text.length() > 8);// (newRes.length() < 3)//ENGLISH LANG
+	}
+	else if ((m_ocrLanguage == "chi_sim") || (m_ocrLanguage == "jpn") || (m_ocrLanguage == "tha") || (m_ocrLanguage == "kor") || (m_ocrLanguage == "hin") || (m_ocrLanguage == "ind"))
+	{
+		return (linesCount > 1) && (wordsCount > 1) && (text.length() > 3);//CHINESE - JAPANESE LANG
+	}
 
-		// Check height/weight ratio (small letters, more than seven words)
-		if (erase == 1)
-		{
+	return false;
+}
 
-			if (boundingBoxCurrent.height < 35 && (double)boundingBoxCurrent.height / (double)boundingBoxCurrent.width < (double)0.06)
-			{
-				erase = 0;
-				superBoundingBoxes.push_back(boundingBoxCurrent);
-			}
-		}
 
-		if (erase == 1)
+/**
+* \brief verifyRegionTesseract - method for running Tesseract on given region.
+*Layout analysis is run first; full recognition runs only when layout counts are borderline or when text is requested.
+* \param [in] const cv::Mat & inputImg -  image for text detection.
+* \param [in] boost::chrono::steady_clock::time_point deadline - recognition is cancelled at this time.
+* \param [in] bool textRequested - always run full recognition, because region text is needed.
+* \param [out] OcrResponse & response - Tesseract output.
+* \return bool - false if Tesseract failed, otherwise true.
+*/
+bool protech::TextDetector::verifyRegionTesseract(const cv::Mat & inputImg, boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response)
+{
+	bool success = false;
+	if (m_engine == NULL)
+	{
+		return false;
+	}
+	try{
+		cv::Mat openCVImage2;
+		inputImg.copyTo(openCVImage2);
+
+		m_engine->setImage(openCVImage2);
+		runTesseract(deadline, textRequested, response);
+
+		if (!openCVImage2.empty())
+			openCVImage2.release();
+		success = true;
+	}
+	catch (std::exception & e)
+	{
+		;
+	}
+	catch (char * str)
+	{
+		;
+	}
+	catch (...)
+	{
+		;
+	}
+
+	return success;
+}
+
+
+/**
+* \brief verifyFrameRegionTesseract - method for running Tesseract on a region of the frame image which is already set to Tesseract.
+* \param [in] const cv::Rect & rect - region at working resolution.
+* \param [in] boost::chrono::steady_clock::time_point deadline - recognition is cancelled at this time.
+* \param [in] bool textRequested - always run full recognition, because region text is needed.
+* \param [out] OcrResponse & response - Tesseract output.
+* \return bool - false if Tesseract failed, otherwise true.
+*/
+bool protech::TextDetector::verifyFrameRegionTesseract(const cv::Rect & rect, boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response)
+{
+	bool success = false;
+	if (m_engine == NULL)
+	{
+		return false;
+	}
+	try{
+		m_engine->setRectangle(rect);
+		runTesseract(deadline, textRequested, response);
+		success = true;
+	}
+	catch (std::exception & e)
+	{
+		;
+	}
+	catch (char * str)
+	{
+		;
+	}
+	catch (...)
+	{
+		;
+	}
+
+	return success;
+}
+
+
+/**
+* \brief runTesseract - method for running layout analysis and (if needed) recognition on image set to Tesseract.
+* \param [in] boost::chrono::steady_clock::time_point deadline - recognition is cancelled at this time.
+* \param [in] bool textRequested - always run full recognition, because region text is needed.
+* \param [out] OcrResponse & response - Tesseract output.
+*/
+void protech::TextDetector::runTesseract(boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response)
+{
+	int verdict = VERDICT_BORDERLINE;
+	if (LAYOUT_VERDICT && !textRequested)
+	{
+		m_engine->getLayoutCounts(response.layoutWords, response.layoutLines);
+		metrics().add(Metrics::COUNT_LAYOUT_CALLS, 1);
+		verdict = layoutVerdict(response.layoutWords, response.layoutLines);
+	}
+
+	if (verdict == VERDICT_BORDERLINE)
+	{
+		metrics().add(Metrics::COUNT_RECOGNIZE_CALLS, 1);
+		if (m_engine->recognize(deadline, response.text))
 		{
-			boundingBoxes.erase(boundingBoxes.begin() + i);
+			m_engine->getWordsCount(response.words, response.lines);
+			response.recognized = true;
 		}
 		else
 		{
-			i++;
+			response.cancelled = true;
 		}
 	}
 }
 
+
+/**
+* \brief regionVerdict - method for deciding whether region contains text from Tesseract output.
+*Clear layout counts decide the region, otherwise recognized text is checked by language rules.
+* \param [in] const OcrResponse & response - Tesseract output (live or replayed).
+* \return bool - true if region contains text, otherwise false.
+*/
+bool protech::TextDetector::regionVerdict(const OcrResponse & response)
+{
+	if (response.layoutWords >= 0)
+	{
+		int verdict = layoutVerdict(response.layoutWords, response.layoutLines);
+		if (verdict != VERDICT_BORDERLINE)
+		{
+			return (verdict == VERDICT_ACCEPT);
+		}
+	}
+	if (response.recognized)
+	{
+		return isTextRegion(response.text, response.words, response.lines);
+	}
+	return false;
+}
+
+
 // Apply rules in order to reject wrong bounding boxes
 void protech::TextDetector::applyRules(std::vector<cv::Rect> & boundingBoxes, std::vector<cv::Rect> & superBoundingBoxes)
 {
-	// Erase low and high bounding boxes
-	//eraseLowAndHigh(boundingBoxes);
-
 	// Check whether a bounding box has a neighbour near from left or right side and if it has, connect them.
-	connectLeftAndRight(boundingBoxes);
-
-	// Erase impossible bounding boxes
-	eraseImposible(boundingBoxes);
-
+	// Erase impossible bounding boxes.
 	// Check whether a bounding box has a neighbour near above or below and if it has not, erese it unless it is low but long.
-	checkAboveAndBelowAndWidth(boundingBoxes, superBoundingBoxes);
+	// (structure-of-arrays boxes, SSE2 kernels where available, see box_store.h)
+	applyBoxRules<BoxKernels>(PARAMS, boundingBoxes, superBoundingBoxes);
 
 	// Check whether a bounding box has a neighbour near near above or below and if it has, connect them.
 	//connectAboveAndBelow(boundingBoxes);
@@ -410,34 +918,119 @@ void protech::TextDetector::applyRules(std::vector<cv::Rect> & boundingBoxes, st
 */
 void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::string img_name)
 {
+	TextDetectionResult result;
+	textDetectionFunction(currentframe, img_name, result);
+}
+
+
+/**
+* \brief textDetectionFunction - function for text detection on a given image.
+*Detection is based on contours of edges and Tesseract.
+*If output images are enabled, result is also saved as two images with same name as original image + sufix in output folder.
+* \param [in] cv::Mat& currentframe - image for text detection (BGR, or grayscale when output images are not written).
+* \param [in] std::string img_name - image name.
+* \param [out] TextDetectionResult & result - verified regions at working resolution.
+*/
+void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::string img_name, TextDetectionResult & result)
+{
+	RegionBatch batch;
+	detectRegions(currentframe, img_name, batch);
+	for (size_t rc = 0; rc < batch.rects.size(); rc++)
+	{
+		verifyRegion(batch, rc);
+	}
+	finishRegions(batch);
+	result = batch.result;
+}
+
+
+/**
+* \brief detectRegions - function for detection stages (up to candidate components) of a given image.
+*Regions are verified by verifyRegion (in any order, by any detector) and image is finished by finishRegions.
+* \param [in] cv::Mat& currentframe - image for text detection (BGR, or grayscale when output images are not written).
+* \param [in] std::string img_name - image name.
+* \param [out] RegionBatch & batch - candidate regions, working image and output images of the image.
+*/
+void protech::TextDetector::detectRegions(cv::Mat & currentframe, std::string img_name, RegionBatch & batch)
+{
+	StageClock & clock = batch.clock;
+	TextDetectionResult & result = batch.result;
+	if (m_trace != NULL)
+		m_trace->clear();
+
+	// image budget; without it every recognition is still limited to 10 s, as before
+	batch.deadlineMs = DEADLINE_MS;
+	batch.deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(DEADLINE_MS);
+
+	// whole-image triage on a thumbnail; text-free images get output images and an empty result only
+	bool triaged = false;
+	if (TRIAGE_THRESHOLD > 0)
+	{
+		TriageFeatures features;
+		computeTriage(currentframe, features);
+		result.triageScore = features.score;
+		triaged = (features.score < TRIAGE_THRESHOLD);
+		clock.lap(Metrics::STAGE_TRIAGE);
+	}
+
 	cv::Mat large;
-	cv::resize(currentframe, large, cv::Size(1400, (int)(currentframe.rows / (currentframe.cols / 1400.0))), 0, 0, CV_INTER_NN); // CV_INTER_LANCZOS4
+	cv::resize(currentframe, large, cv::Size(PARAMS.workingWidth, (int)(currentframe.rows / (currentframe.cols / (double)PARAMS.workingWidth))), 0, 0, CV_INTER_NN); // CV_INTER_LANCZOS4
+
+	result.size = large.size();
 
 	cv::Mat smallImg, currentframeBkp, currentframeBkp1, currentframeBkp2;
-	cv::cvtColor(large, smallImg, CV_BGR2GRAY);
-	large.copyTo(currentframeBkp);
-	large.copyTo(currentframeBkp1);
-	large.copyTo(currentframeBkp2);
+	if (large.channels() == 1)
+	{
+		// image is decoded without colour when output images are not written
+		smallImg = large;
+		if (WRITE_IMAGES)
+			cv::cvtColor(smallImg, large, CV_GRAY2BGR);
+	}
+	else
+	{
+		stripedGray(large, smallImg, STRIPES);
+	}
+	if (WRITE_IMAGES)
+	{
+		large.copyTo(currentframeBkp);
+		large.copyTo(currentframeBkp1);
+		large.copyTo(currentframeBkp2);
+	}
+
+	if (triaged)
+	{
+		result.triaged = true;
+		metrics().add(Metrics::COUNT_TRIAGE_SKIPPED, 1);
+		batch.name = img_name;
+		batch.smallImg = smallImg;
+		batch.outputRects = currentframeBkp;
+		batch.outputMasked = currentframeBkp1;
+		batch.writeImages = WRITE_IMAGES;
+		batch.resultMask = RESULT_MASK;
+		batch.textRequested = TEXT_REQUESTED;
+		clock.lap(Metrics::STAGE_PREPROCESS);
+		return;
+	}
 
 	// ---> CONTOURS <---
 	// morphological gradient
 	cv::Mat grad;
 	cv::Mat morphKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
-	cv::morphologyEx(smallImg, grad, cv::MORPH_GRADIENT, morphKernel);
+	stripedMorphology(smallImg, grad, cv::MORPH_GRADIENT, morphKernel, STRIPES);
 
 	// binarize
 	cv::Mat bw;
-	cv::threshold(grad, bw, 0.0, 255.0, cv::THRESH_BINARY | cv::THRESH_OTSU);
+	stripedOtsu(grad, bw, STRIPES);
 
 	cv::Mat connected;
-	morphKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(7, 1));//7.2
-	cv::morphologyEx(bw, connected, cv::MORPH_CLOSE, morphKernel);
+	morphKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(PARAMS.closeKernelWidth, 1));//7.2
+	stripedMorphology(bw, connected, cv::MORPH_CLOSE, morphKernel, STRIPES);
+	clock.lap(Metrics::STAGE_PREPROCESS);
 
 	// find contours
 	cv::Mat mask = cv::Mat::zeros(bw.size(), CV_8UC1);
 	cv::Mat rectMask = cv::Mat::zeros(bw.size(), CV_8UC1);
 	cv::Mat rectMaskD = cv::Mat::zeros(bw.size(), CV_8UC1);
-	cv::Mat superRectMask = cv::Mat::zeros(bw.size(), CV_8UC1);
 
 	cv::Mat maskAllContours = cv::Mat::zeros(bw.size(), CV_8UC1);
 
@@ -473,16 +1066,17 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		double rarav = (double)(min(rect.width, rect.height)) / max(rect.width, rect.height) * (rect.width + rect.height) / 2;//relative aspect ratio * average side value (h+w / 2)
 
 		//filtering
-		if ((r > 0.3) &&
-			(rect.height > 10 && rect.width > 10) && //width and hight are higher than 10 px
-			(rect.width * rect.height < 300000) && //area must be less than 200.000 px <==
-			(rect.width * rect.height > 200)) 
+		if ((r > PARAMS.contourFillRatio) &&
+			(rect.height > PARAMS.contourMinSide && rect.width > PARAMS.contourMinSide) && //width and hight are higher than 10 px
+			(rect.width * rect.height < PARAMS.contourMaxArea) && //area must be less than 200.000 px <==
+			(rect.width * rect.height > PARAMS.contourMinArea)) 
 			//&& //area must be larger than 100 px <==
 			//(rara < 10000) &&
 			//(rarav < 100) /*&& (rect.height < 75)*/)
 
 		{
-			cv::rectangle(large, rect, cv::Scalar(0, 255, 0), 2);
+			if (WRITE_IMAGES)
+				cv::rectangle(large, rect, cv::Scalar(0, 255, 0), 2);
 			cv::rectangle(rectMaskD, rect, cv::Scalar(255), -1);
 			cv::drawContours(finalMask, contours, idx, cv::Scalar(255, 255, 255), CV_FILLED, 8, hierarchy);
 			boundingBoxes.push_back(rect);
@@ -497,13 +1091,18 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 	}
 
 	//finalMask = finalMask & bw;
+	metrics().add(Metrics::COUNT_CONTOURS, contours.size());
+	metrics().add(Metrics::COUNT_CONTOURS_KEPT, boundingBoxes.size());
+	if (m_trace != NULL)
+		m_trace->boxes[DetectionTrace::STAGE_CONTOURS_KEPT] = boundingBoxes;
+	clock.lap(Metrics::STAGE_CONTOURS);
 
 	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_allContoursRect.jpg"), large);
 	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_allMask.jpg"), mask);
 
-	std::vector<int> rectsToRemove;
-	std::vector<cv::Rect> rectsToAdd;
-	for (int rd = 0; rd < boundingBoxes.size(); rd++)
+	// boxes are split in parallel, each one writes only its own lines
+	std::vector<std::vector<cv::Rect> > splitLines(boundingBoxes.size());
+	parallelFor((int)boundingBoxes.size(), [&](int rd)
 	{
 		cv::Mat vertical;
 		cv::Mat vertical_8U;
@@ -523,12 +1122,12 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		int minIndex = 0;
 		int maxIndex = 0;
 		cv::minMaxIdx(vertical_8U, &minV, &maxV, &minIndex, &maxIndex);
-		if ((minV * 5 < maxV) && (boundingBoxes[rd].width > 100))
+		if ((minV * PARAMS.splitPeakRatio < maxV) && (boundingBoxes[rd].width > PARAMS.splitMinWidth))
 		{
 			int startRect = -1;
 			int v = -1;
 						
-			cv::threshold(vertical_8U, vertical_8U, maxV/5 , 255, CV_THRESH_BINARY);
+			cv::threshold(vertical_8U, vertical_8U, maxV / PARAMS.splitPeakRatio, 255, CV_THRESH_BINARY);
 
 			int countW = 0; //count white pixels
 			int countR = 0; //count rects
@@ -545,7 +1144,7 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 				}
 				else
 				{
-					if (countW > 8)
+					if (countW > PARAMS.splitMinLineHeight)
 					{
 						if (countR > 0)
 						{
@@ -559,7 +1158,7 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 				}
 			}
 			//last rect, if not over
-			if (countW > 8)
+			if (countW > PARAMS.splitMinLineHeight)
 			{
 				if (countR > 0)
 				{
@@ -573,11 +1172,9 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 			for (int wts = 0; wts < whereToSeparate.size() - 1; wts++)
 			{
 				cv::Rect newRect = cv::Rect(boundingBoxes[rd].x, boundingBoxes[rd].y + whereToSeparate[wts], boundingBoxes[rd].width, whereToSeparate[wts + 1] - whereToSeparate[wts] + 1);
-				rectsToAdd.push_back(newRect);
+				splitLines[rd].push_back(newRect);
 			}
 
-			rectsToRemove.push_back(rd);
-
 			if (!whereToSeparate.empty())
 				whereToSeparate.clear();
 		}
@@ -589,8 +1186,18 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 			vertical.release();
 		if (vertical_8U.data != NULL)
 			vertical_8U.release();
-	}
+	});
 
+	std::vector<int> rectsToRemove;
+	std::vector<cv::Rect> rectsToAdd;
+	for (int rd = 0; rd < boundingBoxes.size(); rd++)
+	{
+		if (!splitLines[rd].empty())
+		{
+			rectsToAdd.insert(rectsToAdd.end(), splitLines[rd].begin(), splitLines[rd].end());
+			rectsToRemove.push_back(rd);
+		}
+	}
 	for (int rem = rectsToRemove.size() - 1; rem >= 0; rem--)
 	{
 		boundingBoxes.erase(boundingBoxes.begin() + rectsToRemove[rem]);
@@ -600,14 +1207,19 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		boundingBoxes.push_back(rectsToAdd[rem]);
 	}
 
-	for (int rd = 0; rd < boundingBoxes.size(); rd++)
+	for (int rd = 0; rd < boundingBoxes.size() && WRITE_IMAGES; rd++)
 	{
 		cv::rectangle(currentframeBkp2, boundingBoxes[rd], cv::Scalar(255, 255, 0), 2);
 	}
 	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_newRects.jpg"), currentframeBkp2);
-
-	//validate Rects!
-	for (int idx = boundingBoxes.size()-1; idx >= 0; idx--)
+	metrics().add(Metrics::COUNT_BOXES_SPLIT, boundingBoxes.size());
+	if (m_trace != NULL)
+		m_trace->boxes[DetectionTrace::STAGE_SPLIT] = boundingBoxes;
+	clock.lap(Metrics::STAGE_SPLIT);
+
+	//validate Rects! (in parallel, boxes are erased and drawn afterwards)
+	std::vector<uchar> validBoxes(boundingBoxes.size(), 0);
+	parallelFor((int)boundingBoxes.size(), [&](int idx)
 	{
 		cv::Rect rect = boundingBoxes[idx];
 
@@ -618,16 +1230,23 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		double rarav = (double)(min(rect.width, rect.height)) / max(rect.width, rect.height) * (rect.width + rect.height) / 2;//relative aspect ratio * average side value (h+w / 2)
 
 		//filtering
-		if ((r > 0.3) &&
-			(rect.height > 10 && rect.width > 10) && //width and hight are higher than 10 px
-			(rect.width * rect.height < 100000) && //area must be less than 200.000 px <==
-			(rect.width * rect.height > 200)&& //area must be larger than 100 px <==
-			(rara < 5000) &&
-			(rarav < 50) && 
-			(rect.height < 70))
-
+		if ((r > PARAMS.validFillRatio) &&
+			(rect.height > PARAMS.contourMinSide && rect.width > PARAMS.contourMinSide) && //width and hight are higher than 10 px
+			(rect.width * rect.height < PARAMS.validMaxArea) && //area must be less than 200.000 px <==
+			(rect.width * rect.height > PARAMS.contourMinArea)&& //area must be larger than 100 px <==
+			(rara < PARAMS.validMaxAspectArea) &&
+			(rarav < PARAMS.validMaxAspectSide) && 
+			(rect.height < PARAMS.validMaxHeight))
 		{
-			cv::rectangle(large, rect, cv::Scalar(0, 0, 255), 2);
+			validBoxes[idx] = 1;
+		}
+	});
+	for (int idx = boundingBoxes.size()-1; idx >= 0; idx--)
+	{
+		if (validBoxes[idx])
+		{
+			if (WRITE_IMAGES)
+				cv::rectangle(large, boundingBoxes[idx], cv::Scalar(0, 0, 255), 2);
 		}
 		else
 		{
@@ -636,100 +1255,79 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 	}
 
 
+	metrics().add(Metrics::COUNT_BOXES_VALID, boundingBoxes.size());
+	if (m_trace != NULL)
+		m_trace->boxes[DetectionTrace::STAGE_VALID] = boundingBoxes;
+	clock.lap(Metrics::STAGE_VALIDATE);
+
 	//Labeling 
 	std::vector<cv::Rect> superBoundingBoxes;
 	applyRules(boundingBoxes, superBoundingBoxes);
+	metrics().add(Metrics::COUNT_RULES_BOXES, boundingBoxes.size());
+	metrics().add(Metrics::COUNT_SUPER_BOXES, superBoundingBoxes.size());
+	if (m_trace != NULL)
+	{
+		m_trace->boxes[DetectionTrace::STAGE_RULES] = boundingBoxes;
+		m_trace->boxes[DetectionTrace::STAGE_SUPER] = superBoundingBoxes;
+	}
 
 	for (int rd = 0; rd < boundingBoxes.size(); rd++)
 	{
-		cv::rectangle(large, boundingBoxes[rd], cv::Scalar(255, 0, 0), 2);
+		if (WRITE_IMAGES)
+			cv::rectangle(large, boundingBoxes[rd], cv::Scalar(255, 0, 0), 2);
 		cv::rectangle(rectMask, boundingBoxes[rd], cv::Scalar(255), -1);
 	}
-	for (int rd = 0; rd < superBoundingBoxes.size(); rd++)
+	for (int rd = 0; rd < superBoundingBoxes.size() && WRITE_IMAGES; rd++)
 	{
 		cv::rectangle(large, superBoundingBoxes[rd], cv::Scalar(255, 255, 0), 2);
-		cv::rectangle(superRectMask, superBoundingBoxes[rd], cv::Scalar(255), -1);
 	}
+	clock.lap(Metrics::STAGE_RULES);
 
-	cv::Mat connectedRects;
-	cv::Mat morphKernel_1 = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2));
-	cv::morphologyEx(superRectMask, connectedRects, cv::MORPH_DILATE, morphKernel_1);
-
-	cv::Mat connectedRectsFF = cv::Mat::zeros(connectedRects.size(), CV_8UC1);
-	cv::Mat connectedRectsRectMask = cv::Mat::zeros(connectedRects.size(), CV_8UC1);
-
-	std::vector<std::vector<cv::Point>> v_new_component02;
+	std::vector<cv::Mat> v_new_component_masks02;
 	std::vector<cv::Rect> v_new_component_rects02;
 
-	floodFillNewRects(connectedRects, connectedRectsFF, 2000, 1000000, 0.01, 100, 0.3, v_new_component02, v_new_component_rects02);//ff for big rects // connectedRects
+	mergeSuperBoxes(superBoundingBoxes, smallImg.size(), PARAMS.componentMinArea, PARAMS.componentMaxArea, PARAMS.componentElongationDown, PARAMS.componentElongationUp, PARAMS.componentRectangularity, v_new_component_rects02, v_new_component_masks02);//components of big rects
+	metrics().add(Metrics::COUNT_COMPONENTS, v_new_component_rects02.size());
+	if (m_trace != NULL)
+		m_trace->boxes[DetectionTrace::STAGE_COMPONENTS] = v_new_component_rects02;
+	clock.lap(Metrics::STAGE_COMPONENTS);
 
-	for (int rc = 0; rc < v_new_component_rects02.size(); rc++)
+	// detection above is shared by all image languages, only OCR is repeated; first language which accepts a region decides it
+	std::vector<std::string> & ocrLanguages = batch.languages;
+	ocrLanguages.clear();
+	for (size_t il = 0; il < m_imageLanguages.size(); il++)
 	{
-		cv::Mat tmpImage(smallImg, v_new_component_rects02[rc]);
-		cv::Mat tmpMask(connectedRectsFF, v_new_component_rects02[rc]);
-		bitwise_and(tmpImage, tmpMask, tmpImage);
-		std::string tmoStringRes = "";
-		int wordsCount = 0;
-		int linesCount = 0;
-		//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_tmpImage_" + boost::lexical_cast<std::string>(rc) + ".jpg"), tmpImage);
-		getTextInfoTesseract(tmpImage, tmoStringRes, linesCount, wordsCount);
-
-		//std::cout << "wordsCount: " << wordsCount << std::endl;
-		//std::cout << "linesCount: " << linesCount << std::endl;
-
-		if (LANGUAGE == "eng" )
+		if (std::find(ocrLanguages.begin(), ocrLanguages.end(), m_imageLanguages[il]) != ocrLanguages.end())
 		{
-			std::string newRes = boost::erase_all_regex_copy(tmoStringRes, boost::regex("[^a-zA-Z0-9]+"));//ENGLISH LANG
-			if ((wordsCount > 6) || (((wordsCount > 3) && (linesCount > 1)) && (wordsCount >= 2 * linesCount)) && (tmoStringRes.length() > 8))// (newRes.length() < 3)//ENGLISH LANG
-			{
-				cv::rectangle(currentframeBkp, v_new_component_rects02[rc], cv::Scalar(0, 255, 0), 2);
-				cv::rectangle(connectedRectsRectMask, v_new_component_rects02[rc], cv::Scalar(255), -1);
-			}
-			else
-			{
-				cv::rectangle(connectedRectsFF, v_new_component_rects02[rc], cv::Scalar(0), -1);
-				cv::rectangle(currentframeBkp, v_new_component_rects02[rc], cv::Scalar(0, 0, 255), 2);
-			}
+			continue;
 		}
-		else if ((LANGUAGE == "chi_sim") || (LANGUAGE == "jpn") || (LANGUAGE == "tha") || (LANGUAGE == "kor") || (LANGUAGE == "hin") || (LANGUAGE == "ind"))
+		if (m_ocrReplay == NULL && !addLanguage(m_imageLanguages[il]))
 		{
-			if ((linesCount > 1) && (wordsCount > 1) && (tmoStringRes.length() > 3))//CHINESE - JAPANESE LANG
-			{
-				cv::rectangle(currentframeBkp, v_new_component_rects02[rc], cv::Scalar(0, 255, 0), 2);
-				cv::rectangle(connectedRectsRectMask, v_new_component_rects02[rc], cv::Scalar(255), -1);
-			}
-			else
-			{
-				cv::rectangle(connectedRectsFF, v_new_component_rects02[rc], cv::Scalar(0), -1);
-				cv::rectangle(currentframeBkp, v_new_component_rects02[rc], cv::Scalar(0, 0, 255), 2);
-			}
+			std::cout << "Language " << m_imageLanguages[il] << " can not be loaded, " << img_name << " is verified without it..." << std::endl;
+			continue;
 		}
-
-
-		if (tmpImage.data != NULL)
-			tmpImage.release();
-		if (tmpMask.data != NULL)
-			tmpMask.release();
+		ocrLanguages.push_back(m_imageLanguages[il]);
 	}
-
-	//mask results
-	cv::Mat morphKernel_2 = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(23, 23));
-	cv::dilate(connectedRectsFF, connectedRectsFF, morphKernel_2);
-
-	connectedRectsFF = connectedRectsFF & connectedRectsRectMask;
-
-	cv::Mat connectedRectsFF_3C;
-	connectedRectsFF_3C.create(connectedRectsFF.size(), CV_8UC3);
-	cv::cvtColor(connectedRectsFF, connectedRectsFF_3C, CV_GRAY2BGR);
-
-	currentframeBkp1 = currentframeBkp1 + connectedRectsFF_3C;
-
-	//write imgs
-	cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_masked.jpg"), currentframeBkp1);
-	cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_rects.jpg"), currentframeBkp);
-	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_superRectMask.jpg"), superRectMask);
-	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_newRects.jpg"), currentframeBkp2);
-	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_allRects.jpg"), large);
+	if (ocrLanguages.empty())
+		ocrLanguages.push_back(LANGUAGE);
+	// recorded trace holds one response per region
+	if (m_ocrReplay != NULL)
+		ocrLanguages.resize(1);
+	result.languages = ocrLanguages;
+
+	batch.name = img_name;
+	batch.smallImg = smallImg;
+	batch.outputRects = currentframeBkp;
+	batch.outputMasked = currentframeBkp1;
+	batch.rects = v_new_component_rects02;
+	batch.masks = v_new_component_masks02;
+	batch.writeImages = WRITE_IMAGES;
+	batch.resultMask = RESULT_MASK;
+	batch.textRequested = TEXT_REQUESTED;
+	// frame level OCR: smallImg is not modified, regions are cut from one masked frame by SetRectangle
+	batch.frameOcr = FRAME_OCR && m_ocrReplay == NULL;
+	batch.frameSet.assign(ocrLanguages.size(), false);
+	result.regions.resize(v_new_component_rects02.size());
 
 	//clear data
 	if (large.data != NULL)
@@ -752,35 +1350,15 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		mask.release();
 	if (rectMask.data != NULL)
 		rectMask.release();
-	if (superRectMask.data != NULL)
-		superRectMask.release();
 	if (rectMaskD.data != NULL)
 		rectMaskD.release();
 	if (finalMask.data != NULL)
 		finalMask.release();
 
-	if (connectedRects.data != NULL)
-		connectedRects.release();
-	if (morphKernel_1.data != NULL)
-		morphKernel_1.release();
-	if (connectedRectsFF.data != NULL)
-		connectedRectsFF.release();
-	if (connectedRectsRectMask.data != NULL)
-		connectedRectsRectMask.release();
-
-	if (morphKernel_2.data != NULL)
-		morphKernel_2.release();
-	if (connectedRectsFF_3C.data != NULL)
-		connectedRectsFF_3C.release();
-
 	if (!contours.empty())
 		contours.clear();
 	if (!hierarchy.empty())
 		hierarchy.clear();
-	if (!v_new_component02.empty())
-		v_new_component02.clear();
-	if (!v_new_component_rects02.empty())
-		v_new_component_rects02.clear();
 	if (!boundingBoxes.empty())
 		boundingBoxes.clear();
 	if (!superBoundingBoxes.empty())
@@ -789,4 +1367,253 @@ void protech::TextDetector::textDetectionFunction(cv::Mat & currentframe, std::s
 		rectsToAdd.clear();
 	if (!rectsToRemove.empty())
 		rectsToRemove.clear();
+}
+
+
+/**
+* \brief verifyRegion - function for OCR verification of one candidate region.
+*Only slot rc of the batch result is written, so regions of one image can be verified by several detectors at once
+*(when batch regions are not masked in place and frame OCR is off); OCR input is the same in both masking modes.
+* \param [in,out] RegionBatch & batch - candidate regions of the image.
+* \param [in] size_t rc - region index.
+*/
+void protech::TextDetector::verifyRegion(RegionBatch & batch, size_t rc)
+{
+	const cv::Rect & rect = batch.rects[rc];
+	const cv::Mat & tmpMask = batch.masks[rc];
+	cv::Mat tmpImage;
+	if (!batch.frameOcr)
+	{
+		if (batch.inPlace)
+		{
+			tmpImage = cv::Mat(batch.smallImg, rect);
+			bitwise_and(tmpImage, tmpMask, tmpImage);
+		}
+		else
+		{
+			// the same input as in place masking in index order: earlier regions have cleared their overlap outside their masks
+			bitwise_and(cv::Mat(batch.smallImg, rect), tmpMask, tmpImage);
+			for (size_t ec = 0; ec < rc; ec++)
+			{
+				cv::Rect overlap = batch.rects[ec] & rect;
+				if (overlap.area() == 0)
+					continue;
+				cv::Mat overlapImage(tmpImage, overlap - rect.tl());
+				bitwise_and(overlapImage, cv::Mat(batch.masks[ec], overlap - batch.rects[ec].tl()), overlapImage);
+			}
+		}
+	}
+	//cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(img_name + "_tmpImage_" + boost::lexical_cast<std::string>(rc) + ".jpg"), tmpImage);
+	const std::vector<std::string> & ocrLanguages = batch.languages;
+	OcrResponse response;
+	int status = TextRegionResult::REGION_VERIFIED;
+	bool accepted = false;
+	size_t decidingLanguage = 0;
+	for (size_t ol = 0; ol < ocrLanguages.size() && !accepted; ol++)
+	{
+		selectLanguage(ocrLanguages[ol]);
+		OcrResponse languageResponse;
+		int languageStatus = TextRegionResult::REGION_VERIFIED;
+		boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+		boost::chrono::steady_clock::time_point regionDeadline = now + boost::chrono::milliseconds(PARAMS.ocrTimeoutMs);
+		if (batch.deadlineMs > 0 && batch.deadline < regionDeadline)
+			regionDeadline = batch.deadline;
+
+		if (m_ocrReplay != NULL)
+		{
+			const OcrResponse* recorded = m_ocrReplay->findResponse(rect);
+			if (recorded != NULL)
+				languageResponse = *recorded;
+			else if (m_trace != NULL)
+				m_trace->missingReplays++;
+		}
+		else if (batch.deadlineMs > 0 && now >= batch.deadline)
+		{
+			languageStatus = TextRegionResult::REGION_SKIPPED;
+		}
+		else if (batch.frameOcr)
+		{
+			if (batch.ocrFrame.data == NULL)
+			{
+				// masks of all components, so every rectangle sees the same image regardless of order
+				batch.ocrFrame = cv::Mat::zeros(batch.smallImg.size(), CV_8UC1);
+				for (size_t fc = 0; fc < batch.rects.size(); fc++)
+				{
+					cv::Mat frameROI(batch.ocrFrame, batch.rects[fc]);
+					cv::Mat imageROI(batch.smallImg, batch.rects[fc]);
+					imageROI.copyTo(frameROI, batch.masks[fc]);
+				}
+			}
+			if (!batch.frameSet[ol] && m_engine != NULL)
+			{
+				m_engine->setImage(batch.ocrFrame);
+				batch.frameSet[ol] = true;
+			}
+			verifyFrameRegionTesseract(rect, regionDeadline, batch.textRequested, languageResponse);
+			if (languageResponse.cancelled)
+				languageStatus = TextRegionResult::REGION_UNVERIFIED;
+		}
+		else
+		{
+			verifyRegionTesseract(tmpImage, regionDeadline, batch.textRequested, languageResponse);
+			if (languageResponse.cancelled)
+				languageStatus = TextRegionResult::REGION_UNVERIFIED;
+		}
+
+		bool languageAccepted = regionVerdict(languageResponse);
+		if (languageAccepted || ol == 0)
+		{
+			response = languageResponse;
+			accepted = languageAccepted;
+			decidingLanguage = ol;
+		}
+		if (languageStatus != TextRegionResult::REGION_VERIFIED && status == TextRegionResult::REGION_VERIFIED)
+			status = languageStatus;
+	}
+	if (accepted)
+		status = TextRegionResult::REGION_VERIFIED;
+
+	int wordsCount = response.recognized ? response.words : (response.layoutWords > 0 ? response.layoutWords : 0);
+	int linesCount = response.recognized ? response.lines : (response.layoutLines > 0 ? response.layoutLines : 0);
+	if (m_trace != NULL)
+	{
+		TracedRegion traced;
+		traced.rect = rect;
+		traced.response = response;
+		traced.accepted = accepted;
+		m_trace->regions.push_back(traced);
+	}
+
+	TextRegionResult & regionResult = batch.result.regions[rc];
+	regionResult.rect = rect;
+	regionResult.text = response.text;
+	regionResult.wordsCount = wordsCount;
+	regionResult.linesCount = linesCount;
+	regionResult.accepted = accepted;
+	regionResult.status = status;
+	regionResult.language = ocrLanguages[decidingLanguage];
+
+	//std::cout << "wordsCount: " << wordsCount << std::endl;
+	//std::cout << "linesCount: " << linesCount << std::endl;
+
+	if (tmpImage.data != NULL)
+		tmpImage.release();
+}
+
+
+/**
+* \brief finishRegions - function for output stage of an image whose regions are all verified.
+*Rects and text mask of accepted regions are drawn; output images are written if they are enabled.
+* \param [in,out] RegionBatch & batch - verified regions of the image; batch.result is complete afterwards.
+*/
+void protech::TextDetector::finishRegions(RegionBatch & batch)
+{
+	StageClock & clock = batch.clock;
+	TextDetectionResult & result = batch.result;
+	cv::Mat & currentframeBkp = batch.outputRects;
+	cv::Mat & currentframeBkp1 = batch.outputMasked;
+
+	// full frame masks are needed only for output mask
+	bool outputMask = batch.writeImages || batch.resultMask;
+	cv::Mat connectedRectsFF;
+	cv::Mat connectedRectsRectMask;
+	if (outputMask)
+	{
+		// pixels of all components, rects of rejected ones are cleared (also where they overlap accepted components)
+		connectedRectsFF = cv::Mat::zeros(batch.smallImg.size(), CV_8UC1);
+		connectedRectsRectMask = cv::Mat::zeros(batch.smallImg.size(), CV_8UC1);
+		for (size_t rc = 0; rc < batch.masks.size(); rc++)
+		{
+			cv::Mat componentFF(connectedRectsFF, batch.rects[rc]);
+			cv::bitwise_or(componentFF, batch.masks[rc], componentFF);
+		}
+		for (size_t rc = 0; rc < result.regions.size(); rc++)
+		{
+			if (!result.regions[rc].accepted)
+				cv::rectangle(connectedRectsFF, result.regions[rc].rect, cv::Scalar(0), -1);
+		}
+	}
+
+	for (size_t rc = 0; rc < result.regions.size(); rc++)
+	{
+		const TextRegionResult & region = result.regions[rc];
+		if (region.status != TextRegionResult::REGION_VERIFIED)
+		{
+			result.partial = true;
+			metrics().add(Metrics::COUNT_OCR_SKIPPED, 1);
+		}
+
+		if (region.accepted)
+		{
+			metrics().add(Metrics::COUNT_ACCEPTED, 1);
+			if (batch.writeImages)
+				cv::rectangle(currentframeBkp, region.rect, cv::Scalar(0, 255, 0), 2);
+			if (outputMask)
+				cv::rectangle(connectedRectsRectMask, region.rect, cv::Scalar(255), -1);
+		}
+		else
+		{
+			if (batch.writeImages)
+				cv::rectangle(currentframeBkp, region.rect, (region.status == TextRegionResult::REGION_VERIFIED) ? cv::Scalar(0, 0, 255) : cv::Scalar(0, 255, 255), 2);
+		}
+	}
+
+	if (batch.ocrFrame.data != NULL)
+		batch.ocrFrame.release();
+	clock.lap(Metrics::STAGE_OCR);
+
+	cv::Mat morphKernel_2;
+	cv::Mat connectedRectsFF_3C;
+	if (outputMask)
+	{
+		//mask results
+		morphKernel_2 = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(PARAMS.finalDilation, PARAMS.finalDilation));
+		cv::dilate(connectedRectsFF, connectedRectsFF, morphKernel_2);
+
+		connectedRectsFF = connectedRectsFF & connectedRectsRectMask;
+		if (batch.resultMask)
+			result.mask = connectedRectsFF;
+	}
+	if (batch.writeImages)
+	{
+		connectedRectsFF_3C.create(connectedRectsFF.size(), CV_8UC3);
+		cv::cvtColor(connectedRectsFF, connectedRectsFF_3C, CV_GRAY2BGR);
+
+		currentframeBkp1 = currentframeBkp1 + connectedRectsFF_3C;
+
+		//write imgs
+		cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(batch.name + "_masked.jpg"), currentframeBkp1);
+		cv::imwrite(OUTPUT_FOLDER_PATH + "//" + std::string(batch.name + "_rects.jpg"), currentframeBkp);
+	}
+	clock.lap(Metrics::STAGE_OUTPUT);
+	result.stageUs[Metrics::STAGE_TOTAL] = clock.totalUs();
+	metrics().recordImage(batch.name, result.stageUs[Metrics::STAGE_TOTAL]);
+	result.allocations = clock.allocations();
+	result.peakBytes = clock.peakBytes();
+	metrics().recordImageAllocations(result.allocations);
+	if (result.partial)
+		metrics().add(Metrics::COUNT_PARTIAL_IMAGES, 1);
+
+	//clear data
+	if (batch.smallImg.data != NULL)
+		batch.smallImg.release();
+	if (currentframeBkp.data != NULL)
+		currentframeBkp.release();
+	if (currentframeBkp1.data != NULL)
+		currentframeBkp1.release();
+
+	if (connectedRectsFF.data != NULL)
+		connectedRectsFF.release();
+	if (connectedRectsRectMask.data != NULL)
+		connectedRectsRectMask.release();
+
+	if (morphKernel_2.data != NULL)
+		morphKernel_2.release();
+	if (connectedRectsFF_3C.data != NULL)
+		connectedRectsFF_3C.release();
+
+	if (!batch.masks.empty())
+		batch.masks.clear();
+	if (!batch.rects.empty())
+		batch.rects.clear();
 }
\ No newline at end of file
@@ -21,6 +21,10 @@
 #include <set>
 #include <fstream>
 #include <stdio.h>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/algorithm/string/erase.hpp>
@@ -28,35 +32,219 @@
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "detection_params.h"
+#include "metrics.h"
 #include "tesseract_engine.h"
 
 
 namespace protech
 {
+	/**
+	* \brief TextRegionResult - OCR verification result of one candidate region.
+	*/
+	struct TextRegionResult
+	{
+		enum Status
+		{
+			REGION_VERIFIED = 0,//!< Region is decided by OCR.
+			REGION_UNVERIFIED = 1,//!< Recognition was cancelled at image deadline; region is not accepted.
+			REGION_SKIPPED = 2//!< Image deadline passed before OCR; region is not accepted.
+		};
+
+		cv::Rect rect;//!< Region rect at working resolution.
+		std::string text;//!< OCR text (empty when region is decided on layout only).
+		int wordsCount;//!< Words count.
+		int linesCount;//!< Text lines count.
+		bool accepted;//!< True if region contains text.
+		int status;//!< REGION_VERIFIED, REGION_UNVERIFIED or REGION_SKIPPED.
+		std::string language;//!< Language whose OCR decided the region (first image language if none accepted it).
+	};
+
+	/**
+	* \brief TextDetectionResult - Result of text detection on one image.
+	*/
+	struct TextDetectionResult
+	{
+		std::vector<TextRegionResult> regions;//!< All verified candidate regions.
+		long detectMs;//!< Detection time in milliseconds (set by worker pool).
+		bool partial;//!< Image deadline ran out, some regions are skipped or unverified.
+		cv::Size size;//!< Working resolution of the image.
+		cv::Mat mask;//!< Text mask at working resolution (only when result mask is requested).
+		std::vector<unsigned long long> stageUs;//!< Stage times in microseconds, indexed by Metrics::Stage.
+		std::vector<std::string> languages;//!< OCR languages of the image, in the order they were tried.
+		unsigned long long allocations;//!< Heap allocations during detection.
+		long long peakBytes;//!< Highest heap bytes above start of detection.
+		bool triaged;//!< Image scored below triage threshold, detection stages were skipped.
+		double triageScore;//!< Triage score of the image (-1 when triage is off).
+
+		TextDetectionResult() : detectMs(0), partial(false), allocations(0), peakBytes(0), triaged(false), triageScore(-1){};
+	};
+
+	/**
+	* \brief DetectionOptions - Per-image options for asynchronous detection.
+	*/
+	struct DetectionOptions
+	{
+		enum Priority
+		{
+			PRIORITY_HIGH = 0,//!< Interactive / urgent images, taken by the next free worker.
+			PRIORITY_NORMAL = 1,
+			PRIORITY_BULK = 2,//!< Backfill, runs when no other class is waiting.
+			PRIORITIES_COUNT = 3
+		};
+
+		std::string name;//!< Image name used for output images.
+		bool writeImages;//!< Write _masked and _rects images to output folder.
+		bool textRequested;//!< Return OCR text of accepted regions.
+		int deadlineMs;//!< Time budget for the image in milliseconds (0 means no budget).
+		int priority;//!< Scheduling class (PRIORITY_HIGH, PRIORITY_NORMAL or PRIORITY_BULK).
+		bool resultMask;//!< Return text mask in result.
+		bool frameOcr;//!< One Tesseract image per frame, regions recognized with SetRectangle.
+		std::vector<std::string> languages;//!< OCR languages of the image (empty means detector default language).
+		double triageThreshold;//!< Images scoring below it are skipped as text-free (0 means no triage).
+		int stripes;//!< Horizontal stripes of image stages (0 means one per OpenCV thread, 1 means no striping).
+
+		DetectionOptions() : writeImages(false), textRequested(false), deadlineMs(0), priority(PRIORITY_NORMAL), resultMask(false), frameOcr(false), triageThreshold(0), stripes(0){};
+	};
+
+	/**
+	* \brief OcrResponse - Tesseract output for one region, recorded by golden harness and replayed without Tesseract.
+	*/
+	struct OcrResponse
+	{
+		int layoutWords;//!< Words count from layout analysis (-1 when layout analysis did not run).
+		int layoutLines;//!< Text lines count from layout analysis.
+		bool recognized;//!< Full recognition ran.
+		std::string text;//!< Recognized text.
+		int words;//!< Words count after recognition.
+		int lines;//!< Text lines count after recognition.
+		bool cancelled;//!< Recognition was stopped at deadline.
+
+		OcrResponse() : layoutWords(-1), layoutLines(-1), recognized(false), words(0), lines(0), cancelled(false){};
+	};
+
+	/**
+	* \brief RegionBatch - Candidate regions of one image between detection (detectRegions) and output stage (finishRegions).
+	*Every region is verified on its own (verifyRegion) and written to its own result slot, so regions of one image
+	*can be verified by several detectors at once when inPlace and frameOcr are off (OCR input is the same as with inPlace).
+	*/
+	struct RegionBatch
+	{
+		std::string name;//!< Image name used for output images.
+		cv::Mat smallImg;//!< Grayscale working image.
+		cv::Mat outputRects;//!< Colour image for _rects output (only when output images are written).
+		cv::Mat outputMasked;//!< Colour image for _masked output.
+		std::vector<cv::Rect> rects;//!< Region rects at working resolution.
+		std::vector<cv::Mat> masks;//!< Region masks (of rect size).
+		std::vector<std::string> languages;//!< OCR languages, in the order they are tried.
+		boost::chrono::steady_clock::time_point deadline;//!< Image deadline (used when deadlineMs > 0).
+		int deadlineMs;//!< Time budget for the image (0 means no budget).
+		bool writeImages;//!< Write _masked and _rects images.
+		bool resultMask;//!< Return text mask in result.
+		bool textRequested;//!< Always run full recognition, because region text is needed.
+		bool inPlace;//!< Regions are masked in smallImg itself (one detector verifies regions in order).
+		bool frameOcr;//!< One Tesseract image per frame (one detector verifies all regions).
+		cv::Mat ocrFrame;//!< Masked frame set to Tesseract when frameOcr is on.
+		std::vector<bool> frameSet;//!< Frame is set to engine of language i.
+		TextDetectionResult result;//!< Result; one region slot per rect.
+		StageClock clock;//!< Stage times of the image.
+
+		RegionBatch() : deadlineMs(0), writeImages(false), resultMask(false), textRequested(false), inPlace(true), frameOcr(false), clock(&result.stageUs){};
+	};
+
+	class DetectionPool;
+	struct DetectionTrace;
+
+	std::string languageCode(const std::string & language);
+
 	class TextDetector
 	{
 	private:
-		TesseractEngine tessEngine;//!< Tesseract engine object.
+		std::map<std::string, std::shared_ptr<TesseractEngine> > m_engines;//!< Warm Tesseract engine per language code.
+		TesseractEngine* m_engine;//!< Engine of the language being verified.
 		std::string OUTPUT_FOLDER_PATH;//!< output folder path.
-		std::string LANGUAGE;//!< Detection language.
+		std::string LANGUAGE;//!< Default detection language.
+		std::vector<std::string> m_languages;//!< Loaded languages, default first.
+		std::vector<std::string> m_imageLanguages;//!< OCR languages of following images (empty means LANGUAGE).
+		std::string m_ocrLanguage;//!< Language being verified, selects verdict rules.
+		bool m_loadEngines;//!< False when Tesseract is not loaded (OCR responses are replayed).
+		DetectionParams PARAMS;//!< Thresholds of detection stages and OCR settings (preset).
+		bool LAYOUT_VERDICT;//!< Decide clear regions on layout counts, without character recognition.
+		DetectionTrace* m_trace;//!< If set, intermediate stage outputs are stored here.
+		const DetectionTrace* m_ocrReplay;//!< If set, OCR responses are taken from this trace instead of Tesseract.
+		bool TEXT_REQUESTED;//!< Always run full recognition, because region text is needed.
+		bool WRITE_IMAGES;//!< Write _masked and _rects images to output folder.
+		bool RESULT_MASK;//!< Return text mask in result (for results file).
+		bool FRAME_OCR;//!< Set masked frame to Tesseract once and recognize regions with SetRectangle.
+		int DEADLINE_MS;//!< Time budget per image in milliseconds (0 means no budget).
+		double TRIAGE_THRESHOLD;//!< Images with lower triage score are not detected (0 means no triage).
+		int STRIPES;//!< Horizontal stripes of image stages (0 means one per OpenCV thread, 1 means no striping).
+		size_t m_concurrency;//!< Worker threads used by submit and detectBatch.
+		bool REGION_TASKS;//!< Worker pool verifies regions as separate tasks shared by all workers.
+		size_t m_classCaps[DetectionOptions::PRIORITIES_COUNT];//!< Maximum workers per priority class (0 means all workers).
+		std::shared_ptr<DetectionPool> m_pool;//!< Worker pool, created on first submit.
+		std::mutex m_poolLock;
 
 		std::string ModulePathA();
-		void getTextInfoTesseract(const cv::Mat & inputImg, std::string & result, int & lineCount, int & wordCount);
+		bool selectLanguage(const std::string & language);
+		bool verifyRegionTesseract(const cv::Mat & inputImg, boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response);
+		bool verifyFrameRegionTesseract(const cv::Rect & rect, boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response);
+		void runTesseract(boost::chrono::steady_clock::time_point deadline, bool textRequested, OcrResponse & response);
+		bool regionVerdict(const OcrResponse & response);
+		int layoutVerdict(int wordsCount, int linesCount);
+		bool isTextRegion(const std::string & text, int wordsCount, int linesCount);
 		void floodFillNewRects(cv::Mat & foreground, cv::Mat & out_mask, int AREA_DOWN, int AREA_UP, double elongationDown, double elongationUp, double rectangularityDown, std::vector<std::vector<cv::Point>> & allObjects, std::vector<cv::Rect> & allRects);
+		void mergeSuperBoxes(const std::vector<cv::Rect> & superBoxes, cv::Size imageSize, int AREA_DOWN, int AREA_UP, double elongationDown, double elongationUp, double rectangularityDown, std::vector<cv::Rect> & allRects, std::vector<cv::Mat> & allMasks);
 
-		void eraseLowAndHigh(std::vector<cv::Rect> & boundingBoxes);
-		void connectLeftAndRight(std::vector<cv::Rect> & boundingBoxes);
-		void eraseImposible(std::vector<cv::Rect> & boundingBoxes);
-		void checkAboveAndBelowAndWidth(std::vector<cv::Rect> & boundingBoxes, std::vector<cv::Rect> & superBoundingBoxes);
 		void applyRules(std::vector<cv::Rect> & boundingBoxes, std::vector<cv::Rect> & superBoundingBoxes);
 
 	public:
-		TextDetector(){};
+		enum RegionVerdict
+		{
+			VERDICT_REJECT = 0,
+			VERDICT_ACCEPT = 1,
+			VERDICT_BORDERLINE = 2
+		};
+
+		static const int WORKING_WIDTH = 1400;//!< Working width of balanced preset (default); see DetectionParams::workingWidth.
+
+		TextDetector() : m_engine(NULL), m_loadEngines(true), LAYOUT_VERDICT(true), m_trace(NULL), m_ocrReplay(NULL), TEXT_REQUESTED(false), WRITE_IMAGES(true), RESULT_MASK(false), FRAME_OCR(false), DEADLINE_MS(0), TRIAGE_THRESHOLD(0), STRIPES(0), m_concurrency(1), REGION_TASKS(true)
+		{
+			for (int i = 0; i < DetectionOptions::PRIORITIES_COUNT; i++)
+				m_classCaps[i] = 0;
+		};
 		~TextDetector();		
 		
-		void initialize(std::string _OUTPUT_FOLDER_PATH, std::string _LANGUAGE);
+		void initialize(std::string _OUTPUT_FOLDER_PATH, std::string _LANGUAGE, bool initializeEngine = true);
+		bool addLanguage(const std::string & language);
+		const std::vector<std::string> & languages() const { return m_languages; };
+		void setImageLanguages(const std::vector<std::string> & languages);
+		void setTrace(DetectionTrace * trace);
+		void setOcrReplay(const DetectionTrace * replay);
+		void setParams(const DetectionParams & params);
+		const DetectionParams & params() const { return PARAMS; };
+		void setLayoutVerdict(bool enabled);
+		void setTextRequested(bool requested);
+		void setWriteImages(bool write);
+		void setResultMask(bool enabled);
+		void setFrameOcr(bool enabled);
+		void setDeadline(int deadlineMs);
+		void setTriageThreshold(double threshold);
+		void setStripes(int stripes);
 		void clear();
 		void textDetectionFunction(cv::Mat & currentframe, std::string img_name);
+		void textDetectionFunction(cv::Mat & currentframe, std::string img_name, TextDetectionResult & result);
+		void detectRegions(cv::Mat & currentframe, std::string img_name, RegionBatch & batch);
+		void verifyRegion(RegionBatch & batch, size_t rc);
+		void finishRegions(RegionBatch & batch);
+
+		void setConcurrency(size_t workersCount);
+		void setPriorityCap(int priority, size_t maxWorkers);
+		void setRegionTasks(bool enabled);
+		std::future<TextDetectionResult> submit(const cv::Mat & image, const DetectionOptions & options = DetectionOptions());
+		std::vector<TextDetectionResult> detectBatch(const std::vector<cv::Mat> & images, const DetectionOptions & options = DetectionOptions());
+
+		int benchmarkSuperBoxMerge(size_t setsCount);
 	};
 }
 #endif
@@ -0,0 +1,286 @@
+#include "thread_budget.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+
+#include "striped_stages.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace
+{
+	protech::ThreadBudget g_budget;//!< Applied budget (no pinning until applyThreadBudget).
+
+	/**
+	* \brief setEnvironment - Method which sets environment variable of the process.
+	* \param [in] const char * name - variable name.
+	* \param [in] int value - value.
+	*/
+	void setEnvironment(const char * name, int value)
+	{
+		char text[16];
+		sprintf(text, "%d", value);
+#ifdef _WIN32
+		_putenv_s(name, text);
+#else
+		setenv(name, text, 1);
+#endif
+	}
+
+	/**
+	* \brief parseCpuList - Method which parses Linux cpu list ("0-3,8,10-11").
+	* \param [in] const std::string & list - cpu list.
+	* \return std::vector<int> - cpu numbers.
+	*/
+	std::vector<int> parseCpuList(const std::string & list)
+	{
+		std::vector<int> cpus;
+		std::istringstream stream(list);
+		std::string range;
+		while (std::getline(stream, range, ','))
+		{
+			int first = 0;
+			int last = 0;
+			int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+			if (count < 1)
+				continue;
+			if (count == 1)
+				last = first;
+			for (int cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+
+	/**
+	* \brief detectNodes - Method which returns cores of every NUMA node.
+	* \param [in] int cores - available cores (used when nodes are not detected).
+	* \return std::vector<std::vector<int> > - cores per node.
+	*/
+	std::vector<std::vector<int> > detectNodes(int cores)
+	{
+		std::vector<std::vector<int> > nodes;
+#ifdef _WIN32
+		ULONG highestNode = 0;
+		if (GetNumaHighestNodeNumber(&highestNode))
+		{
+			for (ULONG node = 0; node <= highestNode; node++)
+			{
+				ULONGLONG mask = 0;
+				if (!GetNumaNodeProcessorMask((UCHAR)node, &mask) || mask == 0)
+					continue;
+				std::vector<int> cpus;
+				for (int cpu = 0; cpu < 64; cpu++)
+				{
+					if (mask & (1ULL << cpu))
+						cpus.push_back(cpu);
+				}
+				nodes.push_back(cpus);
+			}
+		}
+#else
+		for (int node = 0;; node++)
+		{
+			char path[64];
+			sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+			FILE* file = fopen(path, "r");
+			if (file == NULL)
+			{
+				break;
+			}
+			char line[1024] = { 0 };
+			if (fgets(line, sizeof(line), file) != NULL)
+			{
+				std::vector<int> cpus = parseCpuList(line);
+				if (!cpus.empty())
+					nodes.push_back(cpus);
+			}
+			fclose(file);
+		}
+#endif
+		if (nodes.empty())
+		{
+			std::vector<int> cpus;
+			for (int cpu = 0; cpu < cores; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+			nodes.push_back(cpus);
+		}
+		return nodes;
+	}
+
+	/**
+	* \brief pinThread - Method which restricts calling thread to given cores.
+	* \param [in] const std::vector<int> & cpus - cores.
+	* \return bool - false if affinity can not be set.
+	*/
+	bool pinThread(const std::vector<int> & cpus)
+	{
+		if (cpus.empty())
+		{
+			return false;
+		}
+#ifdef _WIN32
+		DWORD_PTR mask = 0;
+		for (size_t i = 0; i < cpus.size(); i++)
+		{
+			if (cpus[i] < (int)(sizeof(DWORD_PTR) * 8))
+				mask |= ((DWORD_PTR)1) << cpus[i];
+		}
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (size_t i = 0; i < cpus.size(); i++)
+		{
+			if (cpus[i] < CPU_SETSIZE)
+				CPU_SET(cpus[i], &set);
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+	}
+}
+
+
+/**
+* \brief ThreadBudget::describe - Method which returns budget as one log line.
+* \return std::string - "cores=N workers=W library_threads=L pin=none|cores|numa nodes=K".
+*/
+std::string protech::ThreadBudget::describe() const
+{
+	std::ostringstream text;
+	text << "cores=" << cores << " workers=" << workers << " library_threads=" << libraryThreads
+		<< " pin=" << (pinMode == PIN_CORES ? "cores" : (pinMode == PIN_NUMA ? "numa" : "none"))
+		<< " nodes=" << nodes.size();
+	return text.str();
+}
+
+
+/**
+* \brief availableCores - Method which returns number of hardware threads.
+* \return int - hardware threads (at least 1).
+*/
+int protech::availableCores()
+{
+	int cores = (int)std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+
+/**
+* \brief parsePinMode - Method which parses pinning option.
+* \param [in] const std::string & name - none, cores or numa.
+* \param [out] int & pinMode - ThreadBudget::PinMode.
+* \return bool - false if name is unknown.
+*/
+bool protech::parsePinMode(const std::string & name, int & pinMode)
+{
+	if (name.empty() || name == "none")
+		pinMode = ThreadBudget::PIN_NONE;
+	else if (name == "cores")
+		pinMode = ThreadBudget::PIN_CORES;
+	else if (name == "numa")
+		pinMode = ThreadBudget::PIN_NUMA;
+	else
+		return false;
+	return true;
+}
+
+
+/**
+* \brief planThreadBudget - Method which splits cores between workers and their OpenMP threads.
+*Every worker gets cores / workers OpenMP threads (at least 1), so one worker uses the whole budget for
+*intra-image parallelism and many workers run OpenMP code on their own thread. OpenCV's shared pool gets all cores.
+* \param [in] int cores - threads of the budget (0 means all hardware threads).
+* \param [in] int workers - outer detection workers.
+* \param [in] int pinMode - ThreadBudget::PinMode.
+* \return ThreadBudget - planned budget.
+*/
+protech::ThreadBudget protech::planThreadBudget(int cores, int workers, int pinMode)
+{
+	ThreadBudget budget;
+	budget.cores = cores > 0 ? cores : availableCores();
+	budget.workers = workers > 0 ? workers : 1;
+	budget.libraryThreads = budget.cores / budget.workers;
+	if (budget.libraryThreads < 1)
+		budget.libraryThreads = 1;
+	budget.pinMode = pinMode;
+	budget.nodes = detectNodes(availableCores());
+	return budget;
+}
+
+
+/**
+* \brief applyThreadBudget - Method which sets library threading of the process to the budget.
+*Call it from the main thread before Tesseract engines are initialized and before workers are started.
+* \param [in] const ThreadBudget & budget - budget (see planThreadBudget).
+*/
+void protech::applyThreadBudget(const ThreadBudget & budget)
+{
+	g_budget = budget;
+
+	// one OpenCV pool serves all workers of the process, so it gets the whole budget (OpenCV counts the calling
+	// thread); it is started here, on the unpinned thread, so pool threads do not inherit pinning of a worker
+	cv::setNumThreads(budget.cores);
+	parallelFor(budget.cores, [](int) {});
+
+	// read by OpenMP runtimes of Tesseract/Leptonica when they start
+	setEnvironment("OMP_NUM_THREADS", budget.libraryThreads);
+	setEnvironment("OMP_THREAD_LIMIT", budget.libraryThreads);
+#ifdef _OPENMP
+	omp_set_num_threads(budget.libraryThreads);
+#endif
+}
+
+
+/**
+* \brief threadBudget - Method which returns budget applied to the process.
+* \return const ThreadBudget & - budget (one worker without pinning if none was applied).
+*/
+const protech::ThreadBudget & protech::threadBudget()
+{
+	return g_budget;
+}
+
+
+/**
+* \brief pinWorkerThread - Method which pins calling worker thread as the applied budget says.
+* \param [in] size_t index - worker index.
+* \return bool - true if thread was pinned, false if pinning is off or failed.
+*/
+bool protech::pinWorkerThread(size_t index)
+{
+	const ThreadBudget & budget = g_budget;
+	if (budget.pinMode == ThreadBudget::PIN_CORES)
+	{
+		int cores = availableCores();
+		std::vector<int> cpus;
+		for (int i = 0; i < budget.libraryThreads; i++)
+		{
+			cpus.push_back((int)((index * budget.libraryThreads + i) % cores));
+		}
+		return pinThread(cpus);
+	}
+	if (budget.pinMode == ThreadBudget::PIN_NUMA && !budget.nodes.empty())
+	{
+		return pinThread(budget.nodes[index % budget.nodes.size()]);
+	}
+	return false;
+}
@@ -0,0 +1,55 @@
+/*!\file thread_budget.h
+*
+*	Process thread budget used in TextDetection project.
+*	Cores of the budget (--threads, all cores by default) are used by outer detection workers (threads
+*	of DetectionPool) and library threading. OpenCV's parallel_for_ pool (striped stages, cv::resize) is one
+*	pool per process, shared by all workers, so it gets the whole budget: a worker whose loop finds the pool
+*	busy runs it on its own thread. OpenMP teams of Tesseract/Leptonica are per calling thread, so every
+*	worker gets cores / workers OpenMP threads. OpenMP is limited through OMP_NUM_THREADS / OMP_THREAD_LIMIT,
+*	which must be set before libraries start their OpenMP runtime, so the budget is applied before engines
+*	are initialized.
+*	Workers may be pinned to their share of cores or to NUMA nodes (round robin). Pinning applies to worker
+*	threads and OpenMP threads they start; OpenCV's pool is started unpinned and may run on any core.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef THREAD_BUDGET_H
+#define THREAD_BUDGET_H
+
+#include <string>
+#include <vector>
+
+
+namespace protech
+{
+	/**
+	* \brief ThreadBudget - Effective split of cores between workers and library threads.
+	*/
+	struct ThreadBudget
+	{
+		enum PinMode
+		{
+			PIN_NONE = 0,
+			PIN_CORES = 1,//!< Worker i (and its OpenMP threads) runs on cores i*libraryThreads .. (i+1)*libraryThreads-1.
+			PIN_NUMA = 2//!< Worker i runs on cores of NUMA node i % nodes.
+		};
+
+		int cores;//!< Threads of the whole budget.
+		int workers;//!< Outer detection workers (DetectionPool threads).
+		int libraryThreads;//!< OpenMP threads per worker (1 means OpenMP code runs on calling thread).
+		int pinMode;//!< PinMode of workers.
+		std::vector<std::vector<int> > nodes;//!< Cores of every NUMA node (one node if not detected).
+
+		ThreadBudget() : cores(1), workers(1), libraryThreads(1), pinMode(PIN_NONE){};
+
+		std::string describe() const;
+	};
+
+	int availableCores();
+	bool parsePinMode(const std::string & name, int & pinMode);
+	ThreadBudget planThreadBudget(int cores, int workers, int pinMode);
+	void applyThreadBudget(const ThreadBudget & budget);
+	const ThreadBudget & threadBudget();
+	bool pinWorkerThread(size_t index);
+}
+#endif
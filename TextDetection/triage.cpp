@@ -0,0 +1,121 @@
+#include "triage.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <vector>
+
+
+/**
+* \brief computeTriage - Method which scores how likely an image contains text, at thumbnail scale.
+*Score is the fraction of stroke rows, weighted by Otsu separability (0.5 .. 1) and by gradient energy
+*(saturating at a mean gradient of about 5 grey levels), so blank pages and smooth photos score 0.
+* \param [in] const cv::Mat & image - image (BGR or grayscale, any size).
+* \param [out] TriageFeatures & features - thumbnail statistics and score.
+*/
+void protech::computeTriage(const cv::Mat & image, TriageFeatures & features)
+{
+	features.gradientEnergy = 0;
+	features.separability = 0;
+	features.strokeRows = 0;
+	features.score = 0;
+	if (image.empty())
+	{
+		return;
+	}
+
+	int height = (int)(image.rows * (TRIAGE_WIDTH / (double)image.cols));
+	if (height < 1)
+		height = 1;
+	cv::Mat thumb;
+	cv::resize(image, thumb, cv::Size(TRIAGE_WIDTH, height), 0, 0, CV_INTER_AREA);
+	cv::Mat gray;
+	if (thumb.channels() == 3)
+		cv::cvtColor(thumb, gray, CV_BGR2GRAY);
+	else
+		gray = thumb;
+
+	// gradient energy
+	cv::Mat grad;
+	cv::morphologyEx(gray, grad, cv::MORPH_GRADIENT, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3)));
+	features.gradientEnergy = cv::mean(grad)[0] / 255.0;
+
+	// Otsu separability of grey levels
+	double histogram[256] = { 0 };
+	for (int i = 0; i < gray.rows; i++)
+	{
+		const uchar* row = gray.ptr<uchar>(i);
+		for (int j = 0; j < gray.cols; j++)
+		{
+			histogram[row[j]]++;
+		}
+	}
+	double total = (double)gray.rows * gray.cols;
+	double sum = 0;
+	double sumSquares = 0;
+	for (int t = 0; t < 256; t++)
+	{
+		sum += t * histogram[t];
+		sumSquares += (double)t * t * histogram[t];
+	}
+	double mean = sum / total;
+	double totalVariance = sumSquares / total - mean * mean;
+	double bestBetween = 0;
+	double weight0 = 0;
+	double sum0 = 0;
+	for (int t = 0; t < 255; t++)
+	{
+		weight0 += histogram[t];
+		sum0 += t * histogram[t];
+		if (weight0 == 0 || weight0 == total)
+		{
+			continue;
+		}
+		double mean0 = sum0 / weight0;
+		double mean1 = (sum - sum0) / (total - weight0);
+		double between = weight0 * (total - weight0) * (mean0 - mean1) * (mean0 - mean1) / (total * total);
+		if (between > bestBetween)
+			bestBetween = between;
+	}
+	features.separability = (totalVariance > 0) ? bestBetween / totalVariance : 0;
+
+	// horizontal strokes: rows with at least one edge start per 25 px, in bands of text line height
+	cv::Mat bw;
+	cv::threshold(grad, bw, 0.0, 255.0, cv::THRESH_BINARY | cv::THRESH_OTSU);
+	const double MIN_TRANSITIONS = 0.04;
+	const int MIN_BAND = 2;
+	const int MAX_BAND = TRIAGE_WIDTH / 12;
+	int bandRows = 0;
+	int run = 0;
+	for (int i = 0; i <= bw.rows; i++)
+	{
+		bool strokeRow = false;
+		if (i < bw.rows)
+		{
+			const uchar* row = bw.ptr<uchar>(i);
+			int transitions = 0;
+			for (int j = 1; j < bw.cols; j++)
+			{
+				if (row[j] != 0 && row[j - 1] == 0)
+					transitions++;
+			}
+			strokeRow = (transitions >= MIN_TRANSITIONS * bw.cols);
+		}
+
+		if (strokeRow)
+		{
+			run++;
+		}
+		else
+		{
+			if (run >= MIN_BAND && run <= MAX_BAND)
+				bandRows += run;
+			run = 0;
+		}
+	}
+	features.strokeRows = bandRows / (double)bw.rows;
+
+	double energyFactor = features.gradientEnergy / 0.02;
+	if (energyFactor > 1.0)
+		energyFactor = 1.0;
+	features.score = features.strokeRows * (0.5 + 0.5 * features.separability) * energyFactor;
+}
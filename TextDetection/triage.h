@@ -0,0 +1,37 @@
+/*!\file triage.h
+*
+*	Whole-image triage used in TextDetection project.
+*	Before the detection stages, an image is scored at thumbnail scale (TRIAGE_WIDTH) from
+*	  - gradient energy (mean morphological gradient; blank pages have almost none),
+*	  - Otsu separability (between-class / total variance of grey levels; print is bimodal),
+*	  - horizontal stroke statistics (rows with dense edge transitions grouped in bands of text line height;
+*	    photo texture gives no edges or bands much taller than a line).
+*	Images scoring below the triage threshold are treated as text-free and return an empty result.
+*	\date Created: 19th October 2026.
+*/
+
+#ifndef TRIAGE_H
+#define TRIAGE_H
+
+#include <opencv2/core/core.hpp>
+
+
+namespace protech
+{
+	static const int TRIAGE_WIDTH = 480;//!< Thumbnail width; text lines of the working image are still 3 or more rows tall.
+	static const double TRIAGE_DEFAULT_THRESHOLD = 0.01;//!< Conservative threshold: about one text line per page keeps the image.
+
+	/**
+	* \brief TriageFeatures - Thumbnail statistics of one image.
+	*/
+	struct TriageFeatures
+	{
+		double gradientEnergy;//!< Mean gradient of thumbnail, 0..1.
+		double separability;//!< Otsu between-class variance divided by total variance, 0..1.
+		double strokeRows;//!< Fraction of rows in bands of text line height with dense edge transitions, 0..1.
+		double score;//!< Combined text likelihood, 0..1.
+	};
+
+	void computeTriage(const cv::Mat & image, TriageFeatures & features);
+}
+#endif